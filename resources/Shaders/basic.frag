@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 
 in vec3 color; // input from vertex stage of graphics pipeline, automatically interpolated
 out vec4 FragColor; // output color of current fragment: MUST be written
@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 in vec3 aPos;
 in vec3 aNormal;
 in vec2 aTex;
@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 in vec3 aPos;
 
 uniform mat4 uP_m = mat4(1.0f);
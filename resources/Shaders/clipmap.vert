@@ -0,0 +1,93 @@
+#version 450 core
+// streamed terrain (ClipmapTerrain.cpp): one instance per clipmap level, all of them the same grid of
+// ClipmapTerrain::GRID vertices around the camera with the spacing of the level. Heights come from the
+// level's layer of a toroidal texture array. The part covered by the next finer level is clipped away;
+// near its outer border a level blends into the next coarser one, so levels meet without steps.
+in vec2 aGrid;  // 0..GRID - 1
+
+// per-frame camera and lights, FrameData in UniformBlocks.hpp
+layout(std140, binding = 0) uniform FrameData {
+    mat4 uV_m;
+    mat4 uP_m;
+    vec3 camPos;
+    bool spotlight_on;
+    vec3 spotlight_direction;
+    float cut_off;
+    vec3 light_position;
+    float specular_shinines;
+    vec3 ambient_intensity;
+    vec3 diffuse_intensity;
+    vec3 specular_intensity;
+};
+
+// ClipmapTerrain::LevelData
+struct Level {
+    ivec2 origin;   // sample of the level under grid vertex (0, 0)
+    float spacing;  // world units per sample
+    int layer;      // of heights, = level
+    vec4 hole;      // world xz min, max of the finer level; min > max: none
+};
+layout(std430, binding = 0) readonly buffer Levels {
+    Level levels[];
+};
+
+uniform sampler2DArray heights;  // R16, TEXTURE_SIZE^2 per level, repeat: sample s is at texel s mod TEXTURE_SIZE
+uniform int top_layer;           // coarsest level, blends into nothing
+uniform float height_scale;      // world height of value 1.0
+uniform float texture_tile;      // world units per repeat of an atlas tile
+
+const int GRID = 253;            // ClipmapTerrain::GRID
+const int HALF = (GRID - 1) / 2;
+const float MORPH = 24.0f;       // samples over which a level blends into the coarser one
+
+out VS_OUT {
+    vec2 texcoord;   // in atlas tiles, tile selected in terrain.frag
+    vec3 N;
+    vec3 L;
+    vec3 V;
+    vec4 color;
+    float height;    // 0..1, selects the atlas tile
+} vs_out;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+    float gl_ClipDistance[1];
+};
+
+float own(Level l, ivec2 s) {
+    return texelFetch(heights, ivec3(s & (textureSize(heights, 0).xy - 1), l.layer), 0).r;
+}
+
+void main() {
+    Level l = levels[gl_InstanceID];
+    ivec2 grid = ivec2(aGrid);
+    ivec2 s = l.origin + grid;
+    vec2 xz = vec2(s) * l.spacing;
+
+    float h = own(l, s);
+    if (l.layer < top_layer) {
+        // coarser level at the same point: bilinear between its samples, exactly its triangle edges on grid lines
+        ivec2 d = abs(grid - HALF);
+        float morph = clamp((float(max(d.x, d.y)) - (HALF - MORPH)) / MORPH, 0.0f, 1.0f);
+        vec2 coarse = xz / (2.0f * l.spacing);
+        float hc = texture(heights, vec3((coarse + 0.5f) / vec2(textureSize(heights, 0).xy), l.layer + 1)).r;
+        h = mix(h, hc, morph);
+    }
+    vec3 W = vec3(xz.x, h * height_scale, xz.y);
+
+    // central differences over one sample of this level
+    float hl = own(l, s - ivec2(1, 0)), hr = own(l, s + ivec2(1, 0));
+    float hd = own(l, s - ivec2(0, 1)), hu = own(l, s + ivec2(0, 1));
+    vs_out.N = normalize(vec3((hl - hr) * height_scale, 2.0f * l.spacing, (hd - hu) * height_scale));
+    vs_out.L = light_position - W;
+    vs_out.V = camPos - W;
+
+    vs_out.texcoord = xz / texture_tile;
+    vs_out.color = vec4(1.0f);
+    vs_out.height = h;
+
+    // >= 0 outside the hole: triangles inside it are dropped, the hole lies on grid lines of this level
+    // and every triangle inside has a vertex off its border (diagonals in ClipmapTerrain::init)
+    gl_ClipDistance[0] = max(max(l.hole.x - xz.x, xz.x - l.hole.z), max(l.hole.y - xz.y, xz.y - l.hole.w));
+    gl_Position = uP_m * uV_m * vec4(W, 1.0f);
+}
@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 
 // Outputs colors in RGBA
 out vec4 FragColor;
@@ -0,0 +1,79 @@
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+// CDLOD terrain (Terrain.cpp): the same grid patch is placed over every selected quadtree node,
+// heights come from the height map. Odd grid vertices slide onto the next coarser grid near the end
+// of the level's range, so neighbouring levels meet without cracks.
+in vec2 aGrid;  // vertex of the patch grid, 0..Terrain::PATCH_QUADS
+
+// per-frame camera and lights, FrameData in UniformBlocks.hpp
+layout(std140, binding = 0) uniform FrameData {
+    mat4 uV_m;
+    mat4 uP_m;
+    vec3 camPos;
+    bool spotlight_on;
+    vec3 spotlight_direction;
+    float cut_off;
+    vec3 light_position;
+    float specular_shinines;
+    vec3 ambient_intensity;
+    vec3 diffuse_intensity;
+    vec3 specular_intensity;
+};
+
+// one per draw command (baseInstance), Terrain::Patch
+struct Patch {
+    vec2 origin;        // world xz of grid vertex (0, 0)
+    float grid_step;    // world units per quad
+    float morph_start;  // camera distance where morphing to the coarser grid starts
+    float morph_end;    // ... and is complete
+    float pad0;
+    float pad1;
+    float pad2;
+};
+layout(std430, binding = 0) readonly buffer Patches {
+    Patch patches[];
+};
+
+uniform sampler2D heights;  // R8, linear: 1 texel = 1 world unit
+uniform float height_scale; // world height of texel value 1.0
+uniform float texture_tile; // world units per repeat of an atlas tile
+
+out VS_OUT {
+    vec2 texcoord;   // in atlas tiles, tile selected in terrain.frag
+    vec3 N;
+    vec3 L;
+    vec3 V;
+    vec4 color;
+    float height;    // height map value 0..1, selects the atlas tile
+} vs_out;
+
+float height_at(vec2 xz) {
+    return texture(heights, (xz + 0.5f) / vec2(textureSize(heights, 0))).r;
+}
+
+void main() {
+    Patch p = patches[gl_BaseInstanceARB + gl_InstanceID];
+    vec2 extent = vec2(textureSize(heights, 0) - 1);
+
+    vec2 xz = p.origin + aGrid * p.grid_step;
+    float d = distance(camPos, vec3(xz.x, height_at(xz) * height_scale, xz.y));
+    float morph = clamp((d - p.morph_start) / (p.morph_end - p.morph_start), 0.0f, 1.0f);
+    xz -= fract(aGrid * 0.5f) * 2.0f * p.grid_step * morph;
+    xz = clamp(xz, vec2(0.0f), extent);
+
+    float h = height_at(xz);
+    vec3 W = vec3(xz.x, h * height_scale, xz.y);
+
+    // central differences, one texel apart at every level so lighting does not change with LOD
+    float hl = height_at(xz - vec2(1.0f, 0.0f)), hr = height_at(xz + vec2(1.0f, 0.0f));
+    float hd = height_at(xz - vec2(0.0f, 1.0f)), hu = height_at(xz + vec2(0.0f, 1.0f));
+    vs_out.N = normalize(vec3((hl - hr) * height_scale, 2.0f, (hd - hu) * height_scale));
+    vs_out.L = light_position - W;
+    vs_out.V = camPos - W;
+
+    vs_out.texcoord = xz / texture_tile;
+    vs_out.color = vec4(1.0f);
+    vs_out.height = h;
+
+    gl_Position = uP_m * uV_m * vec4(W, 1.0f);
+}
@@ -0,0 +1,11 @@
+#version 450 core
+// tessellated terrain (Terrain::draw_tessellated): corners of the coarse patch grid, passed through
+in vec4 aPatch;  // world x, z of the corner; lowest and highest terrain height of its patch
+
+out TC_IN {
+    vec4 corner;
+} vs_out;
+
+void main() {
+    vs_out.corner = aPatch;
+}
@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 
 // (interpolated) input from previous pipeline stage
 in VS_OUT {
@@ -6,20 +6,27 @@ in VS_OUT {
     vec3 N;
     vec3 L;
     vec3 V;
+    vec4 color; // object color for ambient and diffuse light
 } fs_in;
 
 // uniform variables
 uniform sampler2D tex0; // texture unit from C++
-uniform vec4 u_diffuse_color = vec4(1.0f); // object color for ambient and diffuse light
 vec4 specular_material = vec4(1.0f);
-// lights
-uniform vec3 ambient_intensity, diffuse_intensity = vec3(0.0f), specular_intensity = vec3(1.0f); 
-uniform float specular_shinines = 10;
-// spotlight
-uniform float cut_off;
-uniform vec3 spotlight_direction;
-uniform bool spotlight_on = true;
 
+// per-frame camera and lights, FrameData in UniformBlocks.hpp
+layout(std140, binding = 0) uniform FrameData {
+    mat4 uV_m;
+    mat4 uP_m;
+    vec3 camPos;
+    bool spotlight_on;
+    vec3 spotlight_direction;
+    float cut_off;
+    vec3 light_position;
+    float specular_shinines;
+    vec3 ambient_intensity;
+    vec3 diffuse_intensity;
+    vec3 specular_intensity;
+};
 
 
 // mandatory: final output color
@@ -49,9 +56,11 @@ void main() {
     // Calculate R by reflecting -L around the plane defined by N
     vec3 R = reflect(-L, N);
 
+    vec4 diffuse_color = fs_in.color;
+
     // calculate lights
-    vec4 ambient = vec4(ambient_intensity, 1.0f) * u_diffuse_color;
-    vec4 diffuse = max(dot(N, L), 0.0) * u_diffuse_color * vec4(diffuse_intensity, 1.0f);
+    vec4 ambient = vec4(ambient_intensity, 1.0f) * diffuse_color;
+    vec4 diffuse = max(dot(N, L), 0.0) * diffuse_color * vec4(diffuse_intensity, 1.0f);
     vec4 specular = pow(max(dot(R, V), 0.0), specular_shinines) * specular_material * vec4(specular_intensity, 1.0f);
 
     // calculate spotlight
@@ -61,7 +70,7 @@ void main() {
         vec4 spotlight_color = vec4(1.0, 0.9, 0.7, 1.0);
 
         if (theta > cut_off) {
-            vec4 spotlight_diffuse = max(dot(N, V), 0.0) * u_diffuse_color * spotlight_color;
+            vec4 spotlight_diffuse = max(dot(N, V), 0.0) * diffuse_color * spotlight_color;
             vec3 R_V = reflect(-V, N);
             vec4 spotlight_specular = pow(max(dot(R_V, V), 0.0), specular_shinines) * specular_material * vec4(specular_intensity, 1.0f);
             float d = length(fs_in.V) ; // vector to light source
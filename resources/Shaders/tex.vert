@@ -1,46 +1,75 @@
-#version 460 core
+#version 450 core
 in vec3 aPos;
 in vec3 aNorm;
 in vec2 aTex;
 
-uniform mat4 uP_m = mat4(1.0f);
-uniform mat4 uM_m = mat4(1.0f);
-uniform mat4 uV_m = mat4(1.0f);
-uniform vec3 camPos;
+// per-frame camera and lights, FrameData in UniformBlocks.hpp
+layout(std140, binding = 0) uniform FrameData {
+    mat4 uV_m;
+    mat4 uP_m;
+    vec3 camPos;
+    bool spotlight_on;
+    vec3 spotlight_direction;
+    float cut_off;
+    vec3 light_position;
+    float specular_shinines;
+    vec3 ambient_intensity;
+    vec3 diffuse_intensity;
+    vec3 specular_intensity;
+};
 
-// Light properties
-uniform vec3 light_position = vec3(10000.0f, 10000.0f, 0.0f);
+// per-draw object data, ObjectData in UniformBlocks.hpp
+// dequantization of packed meshes (PackedVertex): position = aPos * scale + offset, normal is octahedral in aNorm.xy
+layout(std140, binding = 1) uniform ObjectData {
+    mat4 uM_m;
+    vec4 u_diffuse_color; // object color for ambient and diffuse light
+    vec3 u_pos_scale;
+    bool u_quantized;
+    vec3 u_pos_offset;
+};
 
 out VS_OUT {
     vec2 texcoord;
     vec3 N;
     vec3 L;
     vec3 V;
+    vec4 color;
 } vs_out;
 
+vec3 oct_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+        n.xy = (1.0f - abs(n.yx)) * vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+    return normalize(n);
+}
+
 void main() {
+    vec3 pos = aPos * u_pos_scale + u_pos_offset;
+    vec3 norm = u_quantized ? oct_decode(aNorm.xy) : aNorm;
+
     // Create Model-View matrix
     mat4 mv_m = uV_m * uM_m;
 
     // Calculate view-space coordinate - in P point 
     // we are computing the color
-    vec4 P = mv_m * vec4(aPos, 1.0f);
+    vec4 P = mv_m * vec4(pos, 1.0f);
 
     // Calculate normal in view space
     //vs_out.N = mat3(mv_m) * aNorm;
-    vs_out.N = mat3(uM_m) * aNorm;
+    vs_out.N = mat3(uM_m) * norm;
 
      // Calculate view-space light vector
     // vs_out.L = light_position - P.xyz;
-    vs_out.L = (vec4(light_position, 0.0f) - ( uM_m * vec4(aPos, 1.0f))).xyz;
+    vs_out.L = (vec4(light_position, 0.0f) - ( uM_m * vec4(pos, 1.0f))).xyz;
 
     // Calculate view vector (negative of the view-space position)
     // vs_out.V = -P.xyz;
 
-    vs_out.V = (vec4(camPos, 1.0f) - (uM_m * vec4(aPos, 1.0f))).xyz;
+    vs_out.V = (vec4(camPos, 1.0f) - (uM_m * vec4(pos, 1.0f))).xyz;
 
 
     vs_out.texcoord = aTex;
+    vs_out.color = u_diffuse_color;
 
     // Outputs the positions/coordinates of all vertices
     gl_Position = uP_m * P;
@@ -0,0 +1,77 @@
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+in vec3 aPos;
+in vec3 aNorm;
+in vec2 aTex;
+
+// per-frame camera and lights, FrameData in UniformBlocks.hpp
+layout(std140, binding = 0) uniform FrameData {
+    mat4 uV_m;
+    mat4 uP_m;
+    vec3 camPos;
+    bool spotlight_on;
+    vec3 spotlight_direction;
+    float cut_off;
+    vec3 light_position;
+    float specular_shinines;
+    vec3 ambient_intensity;
+    vec3 diffuse_intensity;
+    vec3 specular_intensity;
+};
+
+// per-object data (IndirectRenderer): one record per mesh or instance,
+// each draw command starts at its own record (baseInstance), instances follow
+struct DrawRecord {
+    mat4 model;
+    vec4 diffuse_color;
+    vec3 pos_scale;     // dequantization of packed meshes (PackedVertex): position = aPos * scale + offset
+    int texture_index;  // into textures[] in tex_indirect.frag
+    vec3 pos_offset;
+    int quantized;      // normal is octahedral in aNorm.xy
+};
+layout(std430, binding = 0) readonly buffer DrawRecords {
+    DrawRecord records[];
+};
+
+// GPU culling (cull_objects.comp): commands hold only the visible objects, their record indices are here
+layout(std430, binding = 1) readonly buffer VisibleRecords {
+    uint visible_records[];
+};
+uniform int gpu_culled;
+
+out VS_OUT {
+    vec2 texcoord;
+    vec3 N;
+    vec3 L;
+    vec3 V;
+    vec4 color;
+    flat int texture_index;
+} vs_out;
+
+vec3 oct_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+        n.xy = (1.0f - abs(n.yx)) * vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+    return normalize(n);
+}
+
+void main() {
+    int index = gl_BaseInstanceARB + gl_InstanceID;
+    DrawRecord r = records[gpu_culled != 0 ? visible_records[index] : index];
+
+    vec3 pos = aPos * r.pos_scale + r.pos_offset;
+    vec3 norm = r.quantized != 0 ? oct_decode(aNorm.xy) : aNorm;
+
+    // world-space position, same lighting setup as tex.vert
+    vec4 W = r.model * vec4(pos, 1.0f);
+
+    vs_out.N = mat3(r.model) * norm;
+    vs_out.L = (vec4(light_position, 0.0f) - W).xyz;
+    vs_out.V = (vec4(camPos, 1.0f) - W).xyz;
+
+    vs_out.texcoord = aTex;
+    vs_out.color = r.diffuse_color;
+    vs_out.texture_index = r.texture_index;
+
+    gl_Position = uP_m * uV_m * W;
+}
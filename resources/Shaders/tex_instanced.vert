@@ -0,0 +1,72 @@
+#version 450 core
+in vec3 aPos;
+in vec3 aNorm;
+in vec2 aTex;
+
+// per-frame camera and lights, FrameData in UniformBlocks.hpp
+layout(std140, binding = 0) uniform FrameData {
+    mat4 uV_m;
+    mat4 uP_m;
+    vec3 camPos;
+    bool spotlight_on;
+    vec3 spotlight_direction;
+    float cut_off;
+    vec3 light_position;
+    float specular_shinines;
+    vec3 ambient_intensity;
+    vec3 diffuse_intensity;
+    vec3 specular_intensity;
+};
+
+// per-instance data (InstancedMesh), indexed by gl_InstanceID
+struct Instance {
+    mat4 model;
+    vec4 diffuse_color;
+};
+layout(std430, binding = 0) readonly buffer InstanceBuffer {
+    Instance instances[];
+};
+
+// per-draw data of the group, ObjectData in UniformBlocks.hpp (uM_m and u_diffuse_color unused, see instances[])
+// dequantization of packed meshes (PackedVertex): position = aPos * scale + offset, normal is octahedral in aNorm.xy
+layout(std140, binding = 1) uniform ObjectData {
+    mat4 uM_m;
+    vec4 u_diffuse_color;
+    vec3 u_pos_scale;
+    bool u_quantized;
+    vec3 u_pos_offset;
+};
+
+out VS_OUT {
+    vec2 texcoord;
+    vec3 N;
+    vec3 L;
+    vec3 V;
+    vec4 color;
+} vs_out;
+
+vec3 oct_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+        n.xy = (1.0f - abs(n.yx)) * vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+    return normalize(n);
+}
+
+void main() {
+    vec3 pos = aPos * u_pos_scale + u_pos_offset;
+    vec3 norm = u_quantized ? oct_decode(aNorm.xy) : aNorm;
+
+    mat4 model = instances[gl_InstanceID].model;
+
+    // world-space position, same lighting setup as tex.vert
+    vec4 W = model * vec4(pos, 1.0f);
+
+    vs_out.N = mat3(model) * norm;
+    vs_out.L = (vec4(light_position, 0.0f) - W).xyz;
+    vs_out.V = (vec4(camPos, 1.0f) - W).xyz;
+
+    vs_out.texcoord = aTex;
+    vs_out.color = instances[gl_InstanceID].diffuse_color;
+
+    gl_Position = uP_m * uV_m * W;
+}
@@ -9,6 +9,8 @@
 #include <thread>
 #include <mutex>
 #include <vector>
+#include <array>
+#include <algorithm>
 #include < windows.h >
 
 #include <opencv2/opencv.hpp>
@@ -52,11 +54,32 @@ bool App::init()
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glDepthFunc(GL_LEQUAL);
 
+        // start decoding/parsing all assets on worker threads, GL upload waits for each as needed
+        request_assets();
+
+        // meshes keep references to shaders, all of them must be created before any mesh
         shaders.push_back(ShaderProgram("resources/Shaders/tex.vert", "resources/Shaders/tex.frag"));
+        shaders.push_back(ShaderProgram("resources/Shaders/tex_instanced.vert", "resources/Shaders/tex.frag"));
+        shaders.push_back(ShaderProgram("resources/Shaders/tex_indirect.vert", "resources/Shaders/tex_indirect.frag"));
+        shaders.push_back(ShaderProgram("resources/Shaders/hiz_copy.comp"));
+        shaders.push_back(ShaderProgram("resources/Shaders/hiz_downsample.comp"));
+        shaders.push_back(ShaderProgram("resources/Shaders/cull_objects.comp"));
+        shaders.push_back(ShaderProgram("resources/Shaders/compact_draws.comp"));
+        shaders.push_back(ShaderProgram("resources/Shaders/cull_meshlets.comp"));
+        shaders.push_back(ShaderProgram("resources/Shaders/terrain.vert", "resources/Shaders/terrain.frag"));
+        shaders.push_back(ShaderProgram("resources/Shaders/terrain_tess.vert", "resources/Shaders/terrain_tess.tesc", "resources/Shaders/terrain_tess.tese", "resources/Shaders/terrain.frag"));
+        shaders.push_back(ShaderProgram("resources/Shaders/clipmap.vert", "resources/Shaders/terrain.frag"));
         init_hm();
         init_assets();
+        init_indirect();
+        init_uniform_blocks();
+        init_bvh();
         init_sound();
 
+        assets.report(std::cout);
+        assets.clear();
+        resources.report(std::cout);
+
     }
     catch (std::exception const& e) {
         std::cerr << "Init failed : " << e.what() << std::endl;
@@ -123,16 +146,14 @@ int App::run(void)
         // Clear color saved to OpenGL state machine: no need to set repeatedly in game loop
         glClearColor(0, 0, 0, 0);
 
-        // set light 
-        for (auto& shader : shaders) {
-            shader.activate();
-            shader.setUniform("ambient_intensity", ambientLight);
-            shader.setUniform("diffuse_intensity", glm::vec3(0.5f));
-            shader.setUniform("specular_intensity", glm::vec3(0.2f));
-            shader.setUniform("specular_shinines", 10.0f);
-            shader.setUniform("cut_off", glm::cos(glm::radians(25.0f)));
-        }
-
+        // set light - FrameData block shared by all shaders, uploaded every frame with the camera
+        FrameData frame_data{};
+        frame_data.light_position = glm::vec3(10000.0f, 10000.0f, 0.0f);
+        frame_data.ambient_intensity = ambientLight;
+        frame_data.diffuse_intensity = glm::vec3(0.5f);
+        frame_data.specular_intensity = glm::vec3(0.2f);
+        frame_data.specular_shinines = 10.0f;
+        frame_data.cut_off = glm::cos(glm::radians(25.0f));
 
         while (!glfwWindowShouldClose(window))
         {
@@ -154,6 +175,29 @@ int App::run(void)
             last = now;
             camera.ProcessInput(window, delta_t); // process keys etc.
 
+            // animate, then start occlusion culling on the worker before any GL call that may wait for the GPU
+            float dog_speed = delta_t * 14;
+            for (auto& m : scene) {
+                if (!m.second.transparent) {
+                    if (m.first == "dog" and stopApp == false) {
+                        move_dog(m.second, dog_speed, player_pos);
+                    }
+                    if (m.first == "zombie_dog") {
+                        move_zombie_dog(m.second, 2.25 * dog_speed);
+                    }
+                    if (m.first == "teapot") {
+                        m.second.orientation += glm::vec3(0.0f, 0.5f, 0.0f);
+                    }
+                }
+                m.second.update_bounds();
+            }
+            update_sound_occlusion(player_pos, static_cast<float>(delta_t));
+
+            frame_data.view = camera.GetViewMatrix();
+            glm::mat4 view_projection = projection_matrix * frame_data.view;
+            if (occlusion_culling)
+                start_occlusion_culling(view_projection);
+
             //
             // RENDER: GL drawCalls
             // 
@@ -171,82 +215,148 @@ int App::run(void)
             }
             
 
-            std::vector<Mesh*> transparent;    // temporary, vector of pointers to transparent objects
-            transparent.reserve(scene.size());  // reserve size for all objects to avoid reallocation
-
-            for (auto& shader : shaders) {
-                shader.activate();
-                // set projection matrices
-                shader.setUniform("uV_m", camera.GetViewMatrix());
-                shader.setUniform("uP_m", projection_matrix);
-                shader.setUniform("camPos", camera.Position);
+            // set projection matrices and spotlight: one buffer update for all shaders
+            frame_data.projection = projection_matrix;
+            frame_data.camera_position = camera.Position;
+            frame_data.spotlight_direction = camera.Front;
+            frame_data.spotlight_on = spotlight_on ? 1 : 0;
+            glNamedBufferSubData(frame_ubo, 0, sizeof(FrameData), &frame_data);
+
+            object_ring.begin_frame();
+            GLState::get().begin_frame();
+
+            // frustum culling of world bounds, all objects at once
+            culler.set_frustum(view_projection);
+            culler.clear();
+            for (auto& m : scene)
+                culler.add(m.second.world_bounds);
+            for (auto& group : instanced)
+                culler.add(group.second.world_bounds());
+            culler.run();
+            size_t cull_index = 0;
+            for (auto& m : scene)
+                m.second.visible = culler.visible(cull_index++);
+            for (auto& group : instanced)
+                group.second.visible = culler.visible(cull_index++);
+
+            // moving objects keep their tree, only boxes are updated; then pick along the view direction
+            for (size_t i = 0; i < dynamic_meshes.size(); i++)
+                dynamic_bounds[i] = dynamic_meshes[i]->world_bounds;
+            dynamic_bvh.refit(dynamic_bounds);
+            Bvh::Hit static_hit = static_bvh.raycast(camera.Position, camera.Front, far_plane);
+            Bvh::Hit dynamic_hit = dynamic_bvh.raycast(camera.Position, camera.Front, far_plane);
+            HeightPyramid::Hit ground_hit = terrain_rays.raycast(camera.Position, camera.Front, far_plane);
+            if (dynamic_hit.item != Bvh::NO_HIT && dynamic_hit.t <= static_hit.t && dynamic_hit.t <= ground_hit.t)
+                picked = dynamic_names[dynamic_hit.item];
+            else if (static_hit.item != Bvh::NO_HIT && static_hit.t <= ground_hit.t)
+                picked = static_names[static_hit.item];
+            else if (ground_hit.hit)
+                picked = "terrain at " + std::to_string(static_cast<int>(ground_hit.position.x)) + ", " + std::to_string(static_cast<int>(ground_hit.position.z));
+            else
+                picked.clear();
+
+            if (occlusion_culling)
+                finish_occlusion_culling();
+
+            render_queue.begin(camera.Position, far_plane);
 
-                // set spotlight
-                shader.setUniform("spotlight_direction", camera.Front);
-                shader.setUniform("spotlight_on", spotlight_on);
+            for (auto& m : scene) {
+                if (m.second.transparent || !indirect_draw)
+                    render_queue.add(m.second);
+            }
+            for (auto& group : instanced) {
+                if (group.second.transparent || !indirect_draw)
+                    render_queue.add(group.second);
             }
+            render_queue.sort();
 
-            
-            // FIRST PART - draw all non-transparent in any order
-            float dog_speed = delta_t * 14;
-            for (auto& m : scene) {
-                if (!m.second.transparent) {
-                    if (m.first == "dog" and stopApp == false) {
-                        move_dog(m.second, dog_speed, player_pos);
-                    }
-                    if (m.first == "zombie_dog") {
-                        move_zombie_dog(m.second, 2.25 * dog_speed);
-                    }
-                    if (m.first == "teapot") {
-                        m.second.orientation += glm::vec3(0.0f, 0.5f, 0.0f);
-                    }
-        
-                    m.second.draw();
-                }
-                else
-                    transparent.emplace_back(&m.second); // save pointer for painters algorithm
+            // terrain first, it hides the most
+            if (clipmap.ready()) {
+                clipmap.update(camera.Position);
+                clipmap.draw();
+            }
+            else if (terrain_tessellation)
+                terrain_renderer.draw_tessellated(view_projection, static_cast<float>(height));
+            else {
+                terrain_renderer.select(camera.Position, Frustum::from_matrix(view_projection));
+                terrain_renderer.draw();
             }
 
-            // SECOND PART - draw only transparent - painter's algorithm (sort by distance from camera, from far to near)
-            std::sort(transparent.begin(), transparent.end(), [&](Mesh const* a, Mesh const* b) {
-                return glm::distance(camera.Position, a->origin) > glm::distance(camera.Position, b->origin); // sort by distance from camera
-                });
+            // all opaque meshes + opaque instanced groups
+            if (indirect_draw && gpu_culling)
+                indirect.draw_gpu_culled(camera.Position, projection_matrix, view_projection, static_cast<float>(height), hiz);
+            else if (indirect_draw)
+                indirect.draw(camera.Position, projection_matrix, static_cast<float>(height));
+            if (indirect_draw)
+                meshlet_renderer.draw(camera.Position, projection_matrix, view_projection, static_cast<float>(height), meshlet_culling);
 
-            // set GL for transparent objects
-            glEnable(GL_BLEND);
-            glDepthMask(GL_FALSE);
-            glDisable(GL_CULL_FACE);
+            // opaque state sorted and front to back, then transparent back to front (painter's algorithm)
+            render_queue.draw(object_ring, projection_matrix, static_cast<float>(height));
 
-            // draw sorted transparent
-            for (auto mesh : transparent) {
-                mesh->draw();
-            }
+            // depth of this frame for GPU occlusion tests in the next one
+            if (indirect_draw && gpu_culling)
+                hiz.build(width, height, view_projection);
+            else
+                hiz.invalidate();
 
-            // restore GL properties
-            glDisable(GL_BLEND);
-            glDepthMask(GL_TRUE);
-            glEnable(GL_CULL_FACE);
+            object_ring.end_frame();
 
             if (show_imgui) {
                 ImGui_ImplOpenGL3_NewFrame();
                 ImGui_ImplGlfw_NewFrame();
                 ImGui::NewFrame();
                 ImGui::SetNextWindowPos(ImVec2(10, 10));
-                ImGui::SetNextWindowSize(ImVec2(250, 150));
+                ImGui::SetNextWindowSize(ImVec2(270, 440));
                 ImGui::Begin("Info", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
                 ImGui::Text("V-Sync: %s", vsync ? "ON" : "OFF");
                 ImGui::Text("FPS: %.1f", FPS);
+                ImGui::Text("GPU mem: %.1f MB (shared: -%.1f MB)", resources.live_bytes() / 1048576.0, resources.stats().bytes_saved / 1048576.0);
+                if (indirect_draw)
+                    ImGui::Text("Multi-draw: %zu draws, %zu objects", indirect.draw_count(), indirect.object_count());
+                else
+                    ImGui::Text("Multi-draw: OFF");
+                if (indirect_draw && gpu_culling)
+                    ImGui::Text("GPU culling: %s", indirect.indirect_count_available() ? "ON, draw count on GPU" : "ON, no indirect count");
+                else
+                    ImGui::Text("GPU culling: OFF");
+                if (indirect_draw && meshlet_renderer.mesh_count() > 0) {
+                    MeshletRenderer::Stats const& meshlet_stats = meshlet_renderer.stats();
+                    ImGui::Text("Meshlets: %.1f%% of %zu triangles culled", meshlet_stats.culled_percent(), meshlet_stats.triangles);
+                }
+                else
+                    ImGui::Text("Meshlets: OFF");
+                if (clipmap.ready())
+                    ImGui::Text("Terrain: streamed, %d/%d levels, %zu tiles", clipmap.levels_drawn(), clipmap.levels(), height_streamer->resident_tiles());
+                else if (terrain_tessellation)
+                    ImGui::Text("Terrain: tessellated, %zu patches", terrain_renderer.tessellation_patch_count());
+                else
+                    ImGui::Text("Terrain: %zu patches, %zu triangles", terrain_renderer.patch_count(), terrain_renderer.triangle_count());
+                ImGui::Text("Culling (%s): %zu visible, %zu culled", FrustumCuller::simd_path(), culler.visible_count(), culler.culled_count());
+                if (occlusion_culling)
+                    ImGui::Text("Occlusion: %zu hidden by terrain", occluded_count);
+                else
+                    ImGui::Text("Occlusion: OFF");
+                ImGui::Text("Queue: %zu draws", render_queue.size());
+                ImGui::Text("Teapot heard: %.0f%%", 100.0f * music_audibility);
+                ImGui::Text("Looking at: %s", picked.empty() ? "-" : picked.c_str());
+                ImGui::Text("GL state: %zu calls, %zu skipped", GLState::get().last_frame().issued, GLState::get().last_frame().skipped);
                 ImGui::Text("H to show/hide info");
                 ImGui::Text("C to show/hide cursor");
                 ImGui::Text("M to mute sound");
                 ImGui::Text("L to toggle spotlight");
                 ImGui::Text("F to toggle fullscreen");
+                ImGui::Text("I to toggle multi-draw");
+                ImGui::Text("O to toggle occlusion culling");
+                ImGui::Text("T to toggle tessellated terrain");
+                ImGui::Text("G to toggle GPU culling");
+                ImGui::Text("K to toggle meshlet culling");
                 ImGui::End();
             }
 
             if (show_imgui) {
                 ImGui::Render();
                 ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+                GLState::get().invalidate(); // ImGui changes GL state directly
             }
 
 
@@ -286,6 +396,17 @@ int App::run(void)
 //============================ DESTRUCTOR =================================
 App::~App()
 {
+    // GPU resources are released with the last mesh using them, while the GL context still exists
+    indirect.clear();
+    meshlet_renderer.clear();
+    hiz.clear();
+    terrain_renderer.clear();
+    clipmap.clear();
+    height_streamer.reset();
+    object_ring.clear();
+    glDeleteBuffers(1, &frame_ubo);
+    scene.clear();
+    instanced.clear();
 
     // clean up ImGUI
     ImGui_ImplOpenGL3_Shutdown();
@@ -317,10 +438,49 @@ void App::update_projection_matrix(void)
         glm::radians(fov),   // The vertical Field of View, in radians: the amount of "zoom". Think "camera lens". Usually between 90 (extra wide) and 30 (quite zoomed in)
         ratio,               // Aspect Ratio. Depends on the size of your window.
         0.1f,                // Near clipping plane. Keep as big as possible, or you'll get precision issues.
-        20000.0f             // Far clipping plane. Keep as little as possible.
+        far_plane            // Far clipping plane. Keep as little as possible.
     );
 }
 
+// occludees: every object (the terrain is not one), results are written to their visible flags by finish_occlusion_culling()
+void App::start_occlusion_culling(glm::mat4 const& view_projection)
+{
+    occludee_bounds.clear();
+    occludee_flags.clear();
+    for (auto& m : scene) {
+        occludee_bounds.push_back(m.second.world_bounds);
+        occludee_flags.push_back(&m.second.visible);
+    }
+    for (auto& g : instanced) {
+        occludee_bounds.push_back(g.second.world_bounds());
+        occludee_flags.push_back(&g.second.visible);
+    }
+    occludee_visible.resize(occludee_bounds.size());
+
+    // nothing above may be touched until finish_occlusion_culling()
+    occlusion_job = occlusion_worker.submit([this, view_projection] {
+        occlusion.render(view_projection);
+        for (size_t i = 0; i < occludee_bounds.size(); i++)
+            occludee_visible[i] = occlusion.visible(occludee_bounds[i]);
+    });
+}
+
+// after frustum culling: hides what is in the frustum but behind the terrain
+void App::finish_occlusion_culling(void)
+{
+    if (!occlusion_job.valid())
+        return;
+    occlusion_job.get();
+
+    occluded_count = 0;
+    for (size_t i = 0; i < occludee_flags.size(); i++) {
+        if (*occludee_flags[i] && !occludee_visible[i]) {
+            *occludee_flags[i] = false;
+            occluded_count++;
+        }
+    }
+}
+
 void App::move_dog(Mesh& m, float dog_speed, glm::vec3 player_pos) {
     //std::cout << "Dog_pos: " << m.origin.x << " " << m.origin.y << " " << m.origin.z << "\n";
     if (glm::round(player_pos.x - m.origin.x) >= 25) {
@@ -375,4 +535,23 @@ void App::move_zombie_dog(Mesh& m, float dog_speed) {
     m.origin.y += 3;
 }
 
+void App::update_sound_occlusion(glm::vec3 const& listener, float delta_t) {
+    if (!music || terrain_rays.empty())
+        return;
+
+    // rays to the center and 4 points around the teapot: the share not blocked by terrain sets the volume
+    BoundingSphere const& source = scene.at("teapot").world_sphere;
+    const glm::vec3 offsets[] = { glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+    std::array<HeightPyramid::Ray, 5> rays;
+    std::array<HeightPyramid::Hit, 5> hits;
+    for (size_t i = 0; i < rays.size(); i++)
+        rays[i] = { listener, source.center + offsets[i] * source.radius - listener, 1.0f };
+    terrain_rays.raycast(rays.data(), hits.data(), rays.size());
+
+    float clear = static_cast<float>(std::count_if(hits.begin(), hits.end(), [](HeightPyramid::Hit const& h) { return !h.hit; })) / hits.size();
+    // no jumps when the listener walks behind a ridge
+    music_audibility = glm::mix(music_audibility, 0.25f + 0.75f * clear, std::min(1.0f, 4.0f * delta_t));
+    music->setVolume(music_audibility);
+}
+
 
@@ -20,6 +20,23 @@
 
 #include "camera.hpp"
 #include "Mesh.h"
+#include "InstancedMesh.h"
+#include "IndirectRenderer.hpp"
+#include "HiZPyramid.hpp"
+#include "MeshletRenderer.hpp"
+#include "Terrain.hpp"
+#include "ClipmapTerrain.hpp"
+#include "Heightfield.hpp"
+#include "HeightPyramid.hpp"
+#include "RenderQueue.hpp"
+#include "FrustumCuller.hpp"
+#include "Bvh.hpp"
+#include "OcclusionCuller.hpp"
+#include "ThreadPool.hpp"
+#include "UniformBlocks.hpp"
+#include "UniformRing.hpp"
+#include "AssetLoader.hpp"
+#include "ResourceRegistry.hpp"
 
 #include "irrKlang/irrKlang.h"
 
@@ -28,17 +45,24 @@ public:
     App();
 
     bool init(void);
+    // call before init(): draw this tiled height field (HeightTiles.hpp) instead of the height map
+    void use_streamed_terrain(const std::filesystem::path& file) { streamed_terrain_file = file; }
     int run(void);
 
+    void request_assets(void);
     void init_assets(void);
+    void init_indirect(void);
+    void init_uniform_blocks(void);
+    void init_bvh(void);
+    void init_occluder(void);
     void init_glew();
     void init_glfw();
     void init_imgui();
     void init_capture();
     void init_hm(void);
     void init_sound();
-    Mesh GenHeightMap(const cv::Mat& hmap, const unsigned int mesh_step_size);
     glm::vec3 getPositionOnTerrain(glm::vec3 position);
+    void placeOnTerrain(std::vector<glm::vec3>& positions);
     static void error_callback(int error, const char* description);
     static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -56,7 +80,8 @@ public:
 
     void update_projection_matrix(void);
     GLuint gen_tex(cv::Mat& image);
-    GLuint textureInit(const std::filesystem::path& file_name);
+    std::shared_ptr<Texture> textureInit(const std::filesystem::path& file_name);
+    std::shared_ptr<MeshGeometry> meshInit(const std::filesystem::path& file_name, ShaderProgram& shader);
 
     void captureAndFindFace(cv::Mat& frame, cv::Point2f& faceCenter);
     void findFace(cv::Mat& frame, cv::Point2f outCenter);
@@ -66,6 +91,9 @@ public:
 
     void move_dog(Mesh& m, float dog_speed, glm::vec3 player_pos);
     void move_zombie_dog(Mesh& m, float dog_speed);
+    // music of the teapot quieter while the terrain is between it and the listener
+    void update_sound_occlusion(glm::vec3 const& listener, float delta_t);
+    float music_audibility{ 1.0f };
     bool go_back = false;
 
     ~App();
@@ -83,15 +111,77 @@ private:
     bool show_imgui = true;
 
     cv::Mat terrain;
+    // one height scale for drawing, height queries and the occluder
+    Terrain::Settings terrain_settings;
+    // float copy of the height map for height queries
+    Heightfield heightfield;
+    // min/max pyramid over it for ray casts: picking, line of sight, sound occlusion
+    HeightPyramid terrain_rays;
+
+    // parallel decoding/parsing of textures and models during init
+    AssetLoader assets;
+
+    // GPU textures and geometry shared by all meshes using the same asset
+    ResourceRegistry resources;
 
     GLuint shader_prog_ID{ 0 };
     GLuint VBO_ID{ 0 };
     GLuint VAO_ID{ 0 };
 
     std::unordered_map<std::string, Mesh> scene;
+    // repeated objects, one draw call per group
+    std::unordered_map<std::string, InstancedMesh> instanced;
+
+    // all opaque geometry in one glMultiDrawElementsIndirect (toggle with I)
+    IndirectRenderer indirect;
+    bool indirect_draw = true;
+    // ... culled on the GPU against the depth of the last frame (toggle with G)
+    HiZPyramid hiz;
+    bool gpu_culling = true;
+    // ... except big meshes, drawn by clusters culled on the GPU (K toggles the culling)
+    MeshletRenderer meshlet_renderer;
+    bool meshlet_culling = true;
+    // height map drawn as a quadtree of grid patches, LOD by distance
+    Terrain terrain_renderer;
+    // ... or as coarse patches tessellated on the GPU (toggle with T)
+    bool terrain_tessellation = false;
+    // ... or streamed from disk around the camera, with --terrain; the height map is not loaded then
+    std::filesystem::path streamed_terrain_file;
+    std::shared_ptr<HeightStreamer> height_streamer;
+    ClipmapTerrain clipmap;
+
+    // per-frame draw order for everything not in the multi-draw
+    RenderQueue render_queue;
+    FrustumCuller culler;
+
+    // scene objects for spatial queries: SAH tree over static ones, refitted every frame for moving ones
+    Bvh static_bvh, dynamic_bvh;
+    std::vector<std::string> static_names, dynamic_names;
+    std::vector<Mesh*> dynamic_meshes;
+    std::vector<BoundingBox> dynamic_bounds;
+    std::string picked;  // object in the middle of the screen
+
+    // terrain as occluder, rasterized on a worker while the main thread submits GL work of the frame
+    OcclusionCuller occlusion;
+    ThreadPool occlusion_worker{ 1 };
+    std::future<void> occlusion_job;
+    std::vector<BoundingBox> occludee_bounds;
+    std::vector<bool*> occludee_flags;
+    std::vector<uint8_t> occludee_visible;
+    bool occlusion_culling = true;
+    size_t occluded_count{ 0 };
+    void start_occlusion_culling(glm::mat4 const& view_projection);
+    void finish_occlusion_culling(void);
+
+    // uniform blocks: camera + lights once per frame, object data per draw
+    GLuint frame_ubo{ 0 };
+    UniformRing object_ring;
 
     std::vector<ShaderProgram> shaders;
 
+    // static meshes use 16 B PackedVertex instead of 32 B Vertex
+    bool compact_vertices = true;
+
     // Lights
     glm::vec3 ambientLight = glm::vec3(0.2);
     bool spotlight_on = true;
@@ -100,6 +190,7 @@ private:
 protected: 
     int width{ 800 }, height{ 600 };
     float fov = 60.0f;
+    float far_plane = 20000.0f;
     glm::mat4 projection_matrix = glm::identity<glm::mat4>();
 
     // camera related 
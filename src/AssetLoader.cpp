@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "AssetLoader.hpp"
+
+AssetLoader::AssetLoader(void) :
+	t0(Clock::now())
+{
+}
+
+double AssetLoader::now_ms(void) const
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+void AssetLoader::record(const std::string& name, const std::string& kind, double start_ms, double end_ms)
+{
+	std::scoped_lock lk(timing_mutex);
+	timings.push_back({ name, kind, start_ms, end_ms - start_ms });
+}
+
+void AssetLoader::request_image(const std::filesystem::path& path, int flags)
+{
+	auto key = std::make_pair(path.string(), flags);
+	if (images.count(key))
+		return;
+
+	images[key] = pool.submit([this, name = path.string(), flags] {
+		double start = now_ms();
+		cv::Mat image = cv::imread(name, flags);
+		record(name, "decode", start, now_ms());
+		if (image.empty())
+			throw std::runtime_error("No texture in file: " + name);
+		return image;
+	}).share();
+}
+
+void AssetLoader::request_mesh(const std::filesystem::path& path)
+{
+	std::string name = path.string();
+	if (meshes.count(name))
+		return;
+
+	meshes[name] = pool.submit([this, name] {
+		double start = now_ms();
+		MeshData data;
+		bool ok = loadMesh(name, data);
+		record(name, "mesh", start, now_ms());
+		if (!ok)
+			throw std::runtime_error("Can not load model: " + name);
+		return data;
+	}).share();
+}
+
+cv::Mat AssetLoader::image(const std::filesystem::path& path, int flags)
+{
+	request_image(path, flags);
+	return images.at(std::make_pair(path.string(), flags)).get();
+}
+
+MeshData const& AssetLoader::mesh(const std::filesystem::path& path)
+{
+	request_mesh(path);
+	return meshes.at(path.string()).get();
+}
+
+void AssetLoader::record_upload(const std::string& name, double milliseconds)
+{
+	double end = now_ms();
+	record(name, "upload", end - milliseconds, end);
+}
+
+void AssetLoader::report(std::ostream& out) const
+{
+	std::scoped_lock lk(timing_mutex);
+
+	std::vector<Timing> sorted = timings;
+	std::sort(sorted.begin(), sorted.end(), [](Timing const& a, Timing const& b) { return a.start_ms < b.start_ms; });
+
+	double slowest = 0.0, total = 0.0, end = 0.0;
+	out << "Asset loading (" << pool.size() << " workers):\n";
+	for (Timing const& t : sorted) {
+		out << "  " << std::setw(7) << t.kind << std::fixed << std::setprecision(1)
+			<< std::setw(9) << t.duration_ms << " ms  (at " << std::setw(7) << t.start_ms << " ms)  " << t.name << '\n';
+		if (t.kind != "upload")
+			slowest = std::max(slowest, t.duration_ms);
+		total += t.duration_ms;
+		end = std::max(end, t.start_ms + t.duration_ms);
+	}
+	out << std::fixed << std::setprecision(1) << "  sum of all assets " << total << " ms, slowest single asset "
+		<< slowest << " ms, all done after " << end << " ms" << std::defaultfloat << std::endl;
+}
+
+void AssetLoader::clear(void)
+{
+	images.clear();
+	meshes.clear();
+	std::scoped_lock lk(timing_mutex);
+	timings.clear();
+	t0 = Clock::now();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "MeshCache.hpp"
+#include "ThreadPool.hpp"
+
+// Decodes images and loads OBJ meshes on a worker pool.
+// request_*() starts the work and returns immediately, image()/mesh() wait for the result
+// (starting it now, if nobody requested it before). Results are kept until clear(),
+// so that an asset requested many times is decoded once. GL upload stays on the caller's thread.
+// Not thread safe itself: request and wait from one (the GL context) thread.
+class AssetLoader {
+public:
+	AssetLoader(void);
+
+	void request_image(const std::filesystem::path& path, int flags = cv::IMREAD_UNCHANGED);
+	void request_mesh(const std::filesystem::path& path);
+
+	// throws std::runtime_error when the asset can not be loaded
+	cv::Mat image(const std::filesystem::path& path, int flags = cv::IMREAD_UNCHANGED);
+	MeshData const& mesh(const std::filesystem::path& path);
+
+	// time spent in GL upload etc. on the main thread, shown in the report
+	void record_upload(const std::string& name, double milliseconds);
+
+	// per-asset timings, since construction or last clear()
+	void report(std::ostream& out) const;
+
+	// drop decoded data (uploaded already) and timings
+	void clear(void);
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Timing {
+		std::string name;
+		std::string kind;
+		double start_ms;
+		double duration_ms;
+	};
+
+	Clock::time_point t0;
+
+	std::map<std::pair<std::string, int>, std::shared_future<cv::Mat>> images;
+	std::map<std::string, std::shared_future<MeshData>> meshes;
+
+	mutable std::mutex timing_mutex;
+	std::vector<Timing> timings;
+
+	// last member: workers are joined before anything they use is destroyed
+	ThreadPool pool;
+
+	double now_ms(void) const;
+	void record(const std::string& name, const std::string& kind, double start_ms, double end_ms);
+};
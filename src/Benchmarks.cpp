@@ -0,0 +1,627 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "Benchmarks.hpp"
+#include "Bounds.hpp"
+#include "Bvh.hpp"
+#include "FrustumCuller.hpp"
+#include "OcclusionCuller.hpp"
+#include "Meshlets.hpp"
+#include "HeightTiles.hpp"
+#include "HeightStreamer.hpp"
+#include "Heightfield.hpp"
+#include "HeightPyramid.hpp"
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double microseconds(Clock::duration d)
+	{
+		return std::chrono::duration<double, std::micro>(d).count();
+	}
+
+	// average time of one call of f, in microseconds
+	template <typename F>
+	double timePerCall(unsigned calls, F&& f)
+	{
+		auto start = Clock::now();
+		for (unsigned i = 0; i < calls; i++)
+			f(i);
+		return microseconds(Clock::now() - start) / calls;
+	}
+
+	// size^2 samples of the synthetic generator, 8-bit like the height map
+	void syntheticHeightfield(Heightfield& field, int size, float height_scale)
+	{
+		std::vector<std::uint8_t> samples(size_t(size) * size);
+		for (int z = 0; z < size; z++)
+			for (int x = 0; x < size; x++)
+				samples[size_t(z) * size + x] = static_cast<std::uint8_t>(syntheticHeight(x, z, 3) * 255.0f + 0.5f);
+		field.build(samples.data(), size, size, size, height_scale);
+	}
+
+	// reference ray cast: every cell along the ray (2D DDA), first crossing of the bilinear surface, in double
+	double marchTerrain(Heightfield const& field, glm::dvec3 o, glm::dvec3 d, double t_max)
+	{
+		const int cells_x = field.width() - 1, cells_z = field.depth() - 1;
+		// clip to the map
+		double t0 = 0.0, t1 = t_max;
+		for (int axis : { 0, 2 }) {
+			double extent = axis == 0 ? cells_x : cells_z;
+			if (d[axis] == 0.0) {
+				if (o[axis] < 0.0 || o[axis] > extent)
+					return -1.0;
+				continue;
+			}
+			double a = (0.0 - o[axis]) / d[axis], b = (extent - o[axis]) / d[axis];
+			t0 = std::max(t0, std::min(a, b));
+			t1 = std::min(t1, std::max(a, b));
+		}
+		if (t0 > t1)
+			return -1.0;
+
+		glm::dvec3 p = o + t0 * d;
+		int x = std::clamp(static_cast<int>(std::floor(p.x)), 0, cells_x - 1);
+		int z = std::clamp(static_cast<int>(std::floor(p.z)), 0, cells_z - 1);
+		int step_x = d.x > 0 ? 1 : -1, step_z = d.z > 0 ? 1 : -1;
+		double t = t0;
+		while (x >= 0 && z >= 0 && x < cells_x && z < cells_z) {
+			double next_x = d.x != 0.0 ? ((x + (step_x > 0)) - o.x) / d.x : std::numeric_limits<double>::max();
+			double next_z = d.z != 0.0 ? ((z + (step_z > 0)) - o.z) / d.z : std::numeric_limits<double>::max();
+			double t_exit = std::min(std::min(next_x, next_z), t1);
+
+			// f(s) = ray height - surface height, quadratic along the ray: from f at both ends and the middle
+			auto f = [&](double s) {
+				glm::dvec3 q = o + s * d;
+				double u = q.x - x, v = q.z - z;
+				double h = field.sample(x, z) * (1 - u) * (1 - v) + field.sample(x + 1, z) * u * (1 - v)
+					+ field.sample(x, z + 1) * (1 - u) * v + field.sample(x + 1, z + 1) * u * v;
+				return q.y - h;
+			};
+			double fa = f(t), fm = f(0.5 * (t + t_exit)), fb = f(t_exit);
+			if (fa <= 0.0)
+				return t;
+			double h = t_exit - t;
+			double qa = 2.0 * (fa - 2.0 * fm + fb) / (h * h), qb = (4.0 * fm - 3.0 * fa - fb) / h;  // f(t + s) = qa s^2 + qb s + fa
+			double s_vertex = qa != 0.0 ? -qb / (2.0 * qa) : -1.0;
+			double lowest = (s_vertex > 0.0 && s_vertex < h) ? std::min(fb, f(t + s_vertex)) : fb;
+			if (lowest <= 0.0) {
+				// first sign change: bisection on [t, first point at or below]
+				double lo = t, hi = (fb <= 0.0 && !(s_vertex > 0.0 && s_vertex < h && f(t + s_vertex) <= 0.0)) ? t_exit : t + s_vertex;
+				for (int i = 0; i < 60; i++) {
+					double mid = 0.5 * (lo + hi);
+					(f(mid) <= 0.0 ? hi : lo) = mid;
+				}
+				return hi;
+			}
+			if (t_exit >= t1)
+				break;
+			if (next_x < next_z)
+				x += step_x;
+			else
+				z += step_z;
+			t = t_exit;
+		}
+		return -1.0;
+	}
+}
+
+int runBenchmarks(std::ostream& out)
+{
+	bool ok = true;
+	ok &= benchBvh(out);
+	ok &= benchOcclusion(out);
+	ok &= benchMeshlets(out);
+	ok &= benchHeightStreaming(out);
+	ok &= benchHeightfield(out);
+	ok &= benchTerrainRays(out);
+	out << (ok ? "all results match\n" : "MISMATCH against reference results\n");
+	return ok ? 0 : 1;
+}
+
+bool benchBvh(std::ostream& out)
+{
+	// objects scattered over a terrain sized area, like the scene
+	constexpr float WORLD = 1024.0f;
+	constexpr unsigned QUERIES = 256;
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<float> position(0.0f, WORLD);
+	std::uniform_real_distribution<float> height(0.0f, 128.0f);
+	std::uniform_real_distribution<float> half_size(0.5f, 10.0f);
+	std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+
+	// cameras and rays a bit above the ground, looking around
+	std::vector<glm::vec3> eyes(QUERIES), directions(QUERIES);
+	for (unsigned q = 0; q < QUERIES; q++) {
+		eyes[q] = glm::vec3(position(rng), 20.0f + height(rng) * 0.25f, position(rng));
+		float a = angle(rng);
+		directions[q] = glm::normalize(glm::vec3(std::cos(a), -0.1f, std::sin(a)));
+	}
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 20000.0f);
+
+	bool ok = true;
+	out << "BVH vs linear scan, time per query [us]\n"
+		<< std::setw(7) << "objects" << std::setw(9) << "build" << std::setw(9) << "refit"
+		<< std::setw(10) << "frustum" << std::setw(9) << "linear" << std::setw(9) << "SIMD"
+		<< std::setw(9) << "radius" << std::setw(9) << "linear"
+		<< std::setw(9) << "ray" << std::setw(9) << "linear" << "\n";
+	out << std::fixed << std::setprecision(2);
+
+	for (size_t count : { 64u, 256u, 1024u, 4096u, 16384u, 65536u }) {
+		std::vector<BoundingBox> boxes(count);
+		for (BoundingBox& box : boxes) {
+			glm::vec3 c(position(rng), height(rng), position(rng));
+			glm::vec3 e(half_size(rng), half_size(rng), half_size(rng));
+			box = { c - e, c + e };
+		}
+
+		Bvh bvh;
+		double build = microseconds([&] { auto s = Clock::now(); bvh.build(boxes); return Clock::now() - s; }());
+		double refit = microseconds([&] { auto s = Clock::now(); bvh.refit(boxes); return Clock::now() - s; }());
+
+		std::vector<Frustum> frustums(QUERIES);
+		for (unsigned q = 0; q < QUERIES; q++)
+			frustums[q] = Frustum::from_matrix(projection * glm::lookAt(eyes[q], eyes[q] + directions[q], glm::vec3(0.0f, 1.0f, 0.0f)));
+
+		// frustum: same number of visible objects from all three
+		std::vector<uint32_t> result;
+		size_t bvh_visible = 0, linear_visible = 0, simd_visible = 0;
+		double t_frustum = timePerCall(QUERIES, [&](unsigned q) {
+			result.clear();
+			bvh.query_frustum(frustums[q], result);
+			bvh_visible += result.size();
+		});
+		double t_frustum_linear = timePerCall(QUERIES, [&](unsigned q) {
+			for (BoundingBox const& box : boxes)
+				linear_visible += frustums[q].test(box) != Frustum::Test::OUTSIDE;
+		});
+		FrustumCuller culler;
+		double t_frustum_simd = timePerCall(QUERIES, [&](unsigned q) {
+			culler.clear();
+			culler.set_frustum(frustums[q]);
+			for (BoundingBox const& box : boxes)
+				culler.add(box);
+			culler.run();
+			simd_visible += culler.visible_count();
+		});
+
+		// radius: objects near a point, like "what is near the dog"
+		size_t bvh_near = 0, linear_near = 0;
+		double t_radius = timePerCall(QUERIES, [&](unsigned q) {
+			result.clear();
+			bvh.query_radius(eyes[q], 50.0f, result);
+			bvh_near += result.size();
+		});
+		double t_radius_linear = timePerCall(QUERIES, [&](unsigned q) {
+			for (BoundingBox const& box : boxes)
+				linear_near += overlapsSphere(box, eyes[q], 50.0f);
+		});
+
+		// ray: nearest hit distance must be the same
+		std::vector<float> bvh_t(QUERIES), linear_t(QUERIES);
+		double t_ray = timePerCall(QUERIES, [&](unsigned q) {
+			bvh_t[q] = bvh.raycast(eyes[q], directions[q]).t;
+		});
+		double t_ray_linear = timePerCall(QUERIES, [&](unsigned q) {
+			glm::vec3 inv_dir = 1.0f / directions[q];
+			float nearest = std::numeric_limits<float>::max(), t;
+			for (BoundingBox const& box : boxes)
+				if (intersectRay(box, eyes[q], inv_dir, nearest, t))
+					nearest = std::min(nearest, t);
+			linear_t[q] = nearest;
+		});
+
+		out << std::setw(7) << count << std::setw(9) << build << std::setw(9) << refit
+			<< std::setw(10) << t_frustum << std::setw(9) << t_frustum_linear << std::setw(9) << t_frustum_simd
+			<< std::setw(9) << t_radius << std::setw(9) << t_radius_linear
+			<< std::setw(9) << t_ray << std::setw(9) << t_ray_linear << "\n";
+
+		if (bvh_visible != linear_visible || simd_visible != linear_visible || bvh_near != linear_near || bvh_t != linear_t) {
+			out << "  mismatch: visible " << bvh_visible << "/" << linear_visible << "/" << simd_visible
+				<< ", near " << bvh_near << "/" << linear_near << "\n";
+			ok = false;
+		}
+	}
+	out << "(SIMD: flat FrustumCuller, " << FrustumCuller::simd_path() << ", including filling its arrays)\n";
+	return ok;
+}
+
+bool benchOcclusion(std::ostream& out)
+{
+	// 1024 x 1024 terrain, 64 x 64 cells, flat except a 100 units high ridge across z = 500
+	constexpr int CELLS = 64;
+	constexpr float CELL = 1024.0f / CELLS;
+	std::vector<glm::vec3> vertices;
+	std::vector<uint32_t> indices;
+	for (int z = 0; z <= CELLS; z++)
+		for (int x = 0; x <= CELLS; x++) {
+			float dz = std::abs(z * CELL - 500.0f);
+			vertices.emplace_back(x * CELL, std::max(0.0f, 100.0f - dz), z * CELL);
+		}
+	for (int z = 0; z < CELLS; z++)
+		for (int x = 0; x < CELLS; x++) {
+			uint32_t i0 = z * (CELLS + 1) + x;
+			indices.insert(indices.end(), { i0, i0 + CELLS + 1, i0 + 1, i0 + 1, i0 + CELLS + 1, i0 + CELLS + 2 });
+		}
+
+	OcclusionCuller culler;
+	culler.set_occluder(vertices, indices);
+	glm::vec3 eye(512.0f, 20.0f, 100.0f);
+	glm::mat4 view_projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 20000.0f)
+		* glm::lookAt(eye, glm::vec3(512.0f, 20.0f, 1000.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	constexpr unsigned FRAMES = 100;
+	double t_render = timePerCall(FRAMES, [&](unsigned) { culler.render(view_projection); });
+
+	struct Case {
+		const char* name;
+		BoundingBox box;
+		bool expected;
+	};
+	std::vector<Case> cases = {
+		{ "in front of the ridge", { glm::vec3(500.0f, 0.0f, 300.0f), glm::vec3(520.0f, 10.0f, 320.0f) }, true },
+		{ "behind the ridge", { glm::vec3(500.0f, 0.0f, 700.0f), glm::vec3(520.0f, 10.0f, 720.0f) }, false },
+		{ "far behind the ridge", { glm::vec3(300.0f, 0.0f, 900.0f), glm::vec3(700.0f, 40.0f, 950.0f) }, false },
+		{ "behind, above the ridge top", { glm::vec3(500.0f, 0.0f, 700.0f), glm::vec3(520.0f, 400.0f, 720.0f) }, true },
+		{ "around the camera", { eye - glm::vec3(5.0f), eye + glm::vec3(5.0f) }, true },
+	};
+
+	bool ok = true;
+	size_t tests = 0;
+	double t_test = timePerCall(FRAMES, [&](unsigned) {
+		for (Case const& c : cases)
+			tests += culler.visible(c.box);
+	});
+	out << "Occlusion culling, " << OcclusionCuller::WIDTH << "x" << OcclusionCuller::HEIGHT << " depth, "
+		<< indices.size() / 3 << " occluder triangles (" << culler.triangles_rasterized() << " rasterized)\n"
+		<< "  render " << t_render << " us, " << t_test / cases.size() << " us per box\n";
+	for (Case const& c : cases) {
+		bool visible = culler.visible(c.box);
+		if (visible != c.expected) {
+			out << "  mismatch: box " << c.name << " is " << (visible ? "visible" : "occluded") << "\n";
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+bool benchMeshlets(std::ostream& out)
+{
+	// UV sphere of radius 10, about 40k triangles like the dog
+	constexpr int RINGS = 100, SEGMENTS = 200;
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	for (int r = 0; r <= RINGS; r++)
+		for (int s = 0; s <= SEGMENTS; s++) {
+			float theta = glm::pi<float>() * r / RINGS, phi = glm::two_pi<float>() * s / SEGMENTS;
+			glm::vec3 n(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			vertices.push_back(Vertex{ n * 10.0f, n, glm::vec2(static_cast<float>(s) / SEGMENTS, static_cast<float>(r) / RINGS) });
+		}
+	for (int r = 0; r < RINGS; r++)
+		for (int s = 0; s < SEGMENTS; s++) {
+			GLuint i0 = r * (SEGMENTS + 1) + s, i1 = i0 + SEGMENTS + 1;  // counter-clockwise seen from outside
+			if (r > 0)
+				indices.insert(indices.end(), { i0, i0 + 1, i1 });
+			if (r < RINGS - 1)
+				indices.insert(indices.end(), { i0 + 1, i1 + 1, i1 });
+		}
+	size_t triangle_count = indices.size() / 3;
+
+	std::vector<Meshlet> meshlets;
+	std::vector<GLuint> meshlet_indices;
+	double t_build = microseconds([&] { auto s = Clock::now(); buildMeshlets(vertices.data(), vertices.size(), indices.data(), indices.size(), meshlets, meshlet_indices); return Clock::now() - s; }());
+
+	bool ok = true;
+	// every triangle exactly once, as a sorted triple
+	auto sorted_triangles = [](std::vector<GLuint> const& list) {
+		std::vector<std::array<GLuint, 3>> triangles;
+		for (size_t i = 0; i + 2 < list.size(); i += 3) {
+			std::array<GLuint, 3> t{ list[i], list[i + 1], list[i + 2] };
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());  // keeps the winding
+			triangles.push_back(t);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	};
+	if (sorted_triangles(indices) != sorted_triangles(meshlet_indices)) {
+		out << "  mismatch: meshlets do not hold every triangle exactly once\n";
+		ok = false;
+	}
+
+	size_t vertex_sum = 0;
+	for (Meshlet const& m : meshlets) {
+		vertex_sum += m.vertex_count;
+		if (m.vertex_count > MESHLET_MAX_VERTICES || m.triangle_count > MESHLET_MAX_TRIANGLES) {
+			out << "  mismatch: meshlet with " << m.vertex_count << " vertices, " << m.triangle_count << " triangles\n";
+			ok = false;
+		}
+	}
+
+	// cameras around the sphere: a cone may only cull clusters whose triangles all face away
+	constexpr unsigned CAMERAS = 64;
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> coordinate(-40.0f, 40.0f);
+	size_t culled_triangles = 0, wrong = 0;
+	for (unsigned c = 0; c < CAMERAS; c++) {
+		glm::vec3 camera(coordinate(rng), coordinate(rng), coordinate(rng));
+		if (glm::length(camera) < 11.0f)
+			continue;
+		for (Meshlet const& m : meshlets) {
+			glm::vec3 to_apex = m.cone_apex - camera;
+			if (m.cone_cutoff >= 1.0f || glm::dot(to_apex, m.cone_axis) < m.cone_cutoff * glm::length(to_apex))
+				continue;
+			culled_triangles += m.triangle_count;
+			for (GLuint i = m.first_index; i < m.first_index + m.triangle_count * 3; i += 3) {
+				glm::vec3 const& a = vertices[meshlet_indices[i]].Position;
+				glm::vec3 n = glm::cross(vertices[meshlet_indices[i + 1]].Position - a, vertices[meshlet_indices[i + 2]].Position - a);
+				wrong += glm::dot(n, camera - a) > 1e-4f * glm::length(n);
+			}
+		}
+	}
+	if (wrong > 0) {
+		out << "  mismatch: " << wrong << " front-facing triangles in back-facing meshlets\n";
+		ok = false;
+	}
+
+	out << "Meshlets, sphere of " << triangle_count << " triangles: " << meshlets.size() << " meshlets, "
+		<< static_cast<double>(vertex_sum) / meshlets.size() << " vertices and " << static_cast<double>(triangle_count) / meshlets.size()
+		<< " triangles each, built in " << t_build / 1000.0 << " ms\n"
+		<< "  cone culling from outside: " << 100.0 * culled_triangles / (static_cast<double>(triangle_count) * CAMERAS) << " % of triangles\n";
+	return ok;
+}
+
+bool benchHeightStreaming(std::ostream& out)
+{
+	constexpr std::uint32_t SIZE = 2048, SEED = 7;
+	constexpr size_t BUDGET = 16;  // tiles
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "icp_bench.htiles";
+
+	auto start = Clock::now();
+	if (!generateHeightTiles(path, SIZE, SEED)) {
+		out << "  mismatch: can not write " << path.string() << "\n";
+		return false;
+	}
+	double t_write = microseconds(Clock::now() - start) / 1000.0;
+
+	bool ok = true;
+	auto reference = [](int x, int z) {
+		x = std::clamp(x, 0, static_cast<int>(SIZE) - 1);
+		z = std::clamp(z, 0, static_cast<int>(SIZE) - 1);
+		return static_cast<int>(syntheticHeight(x, z, SEED) * 65535.0f + 0.5f);
+	};
+	{
+		// level 0 is the generator, level 1 its 1-2-1 tent around even samples
+		HeightTileFile file(path);
+		const int T = file.tile_size();
+		std::vector<HeightTileFile::Sample> tile(size_t(T) * T);
+		std::mt19937 rng(99);
+		for (int i = 0; i < 64 && ok; i++) {
+			int level = i % 2;
+			int x = std::uniform_int_distribution<int>(0, file.level_width(level) - 1)(rng);
+			int z = std::uniform_int_distribution<int>(0, file.level_height(level) - 1)(rng);
+			file.read_tile(level, x / T, z / T, tile.data());
+			int expected = reference(x, z);
+			if (level == 1) {
+				int sum = 0;
+				for (int dz = -1; dz <= 1; dz++)
+					for (int dx = -1; dx <= 1; dx++)
+						sum += reference(2 * x + dx, 2 * z + dz) * (2 - std::abs(dx)) * (2 - std::abs(dz));
+				expected = (sum + 8) / 16;
+			}
+			if (tile[size_t(z % T) * T + x % T] != expected) {
+				out << "  mismatch: level " << level << " sample " << x << ", " << z << "\n";
+				ok = false;
+			}
+		}
+		if (file.levels() < 2 || file.level_width(file.levels() - 1) > T) {
+			out << "  mismatch: top level does not fit one tile\n";
+			ok = false;
+		}
+	}
+
+	// fly diagonally over the map, every frame asking for the 3 x 3 level 0 tiles around the camera
+	size_t frames = 0, max_resident = 0, waits = 0;
+	start = Clock::now();
+	{
+		HeightStreamer streamer(path, BUDGET);
+		const int T = streamer.tile_size(), tiles = (streamer.level_width(0) + T - 1) / T;
+		for (float p = 0.0f; p < SIZE; p += 16.0f, frames++) {
+			for (;;) {
+				streamer.begin_frame();
+				bool all = true;
+				int cx = static_cast<int>(p) / T;
+				for (int tz = std::max(cx - 1, 0); tz <= std::min(cx + 1, tiles - 1); tz++)
+					for (int tx = std::max(cx - 1, 0); tx <= std::min(cx + 1, tiles - 1); tx++)
+						all &= streamer.tile(0, tx, tz) != nullptr;
+				max_resident = std::max(max_resident, streamer.resident_tiles());
+				if (all)
+					break;
+				waits++;
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		}
+		double t_stream = microseconds(Clock::now() - start) / 1000.0;
+
+		// heights bilinear between samples, also where tiles are read on demand
+		std::mt19937 rng(5);
+		std::uniform_real_distribution<float> position(0.0f, SIZE - 1.0f);
+		for (int i = 0; i < 256; i++) {
+			glm::vec2 xz(position(rng), position(rng));
+			int x = static_cast<int>(xz.x), z = static_cast<int>(xz.y);
+			float fx = xz.x - x, fz = xz.y - z;
+			float scale = streamer.header().height_scale / 65535.0f;
+			float expected = glm::mix(glm::mix(reference(x, z), reference(x + 1, z), fx), glm::mix(reference(x, z + 1), reference(x + 1, z + 1), fx), fz) * scale;
+			if (std::abs(streamer.height(xz) - expected) > 1e-3f * streamer.header().height_scale) {
+				out << "  mismatch: height at " << xz.x << ", " << xz.y << "\n";
+				ok = false;
+				break;
+			}
+		}
+		if (max_resident > BUDGET) {
+			out << "  mismatch: " << max_resident << " tiles resident, budget " << BUDGET << "\n";
+			ok = false;
+		}
+		size_t tile_bytes = size_t(T) * T * sizeof(HeightTileFile::Sample);
+		out << "Height streaming, " << SIZE << "^2 synthetic, " << streamer.levels() << " levels, written in " << t_write << " ms\n"
+			<< "  " << frames << " frames streamed in " << t_stream << " ms (" << waits << " waits), " << streamer.tiles_read() << " tiles read, "
+			<< streamer.tiles_read() * tile_bytes / (t_stream * 1000.0) << " MB/s, at most " << max_resident << " resident\n";
+	}
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+	return ok;
+}
+
+bool benchHeightfield(std::ostream& out)
+{
+	constexpr int SIZE = 1024;
+	constexpr size_t QUERIES = 1 << 20;
+	constexpr float SCALE = 127.5f;  // Terrain::Settings default
+	std::vector<std::uint8_t> samples(size_t(SIZE) * SIZE);
+	for (int z = 0; z < SIZE; z++)
+		for (int x = 0; x < SIZE; x++)
+			samples[size_t(z) * SIZE + x] = static_cast<std::uint8_t>(syntheticHeight(x, z, 3) * 255.0f + 0.5f);
+
+	Heightfield field;
+	auto start = Clock::now();
+	field.build(samples.data(), SIZE, SIZE, SIZE, SCALE);
+	double t_build = microseconds(Clock::now() - start) / 1000.0;
+
+	// a few percent of the queries off the map, as for agents walking into the border
+	std::mt19937 rng(21);
+	std::uniform_real_distribution<float> position(-16.0f, SIZE + 16.0f);
+	std::vector<float> xs(QUERIES), zs(QUERIES), scalar(QUERIES), batch(QUERIES);
+	for (size_t i = 0; i < QUERIES; i++) {
+		xs[i] = position(rng);
+		zs[i] = position(rng);
+	}
+
+	start = Clock::now();
+	for (size_t i = 0; i < QUERIES; i++)
+		scalar[i] = field.height(xs[i], zs[i]);
+	double t_scalar = microseconds(Clock::now() - start);
+	start = Clock::now();
+	field.heights(xs.data(), zs.data(), batch.data(), QUERIES);
+	double t_batch = microseconds(Clock::now() - start);
+
+	auto reference = [&](float x, float z) {
+		double px = std::clamp<double>(x, 0.0, SIZE - 1), pz = std::clamp<double>(z, 0.0, SIZE - 1);
+		int x0 = std::min(static_cast<int>(px), SIZE - 2), z0 = std::min(static_cast<int>(pz), SIZE - 2);
+		double fx = px - x0, fz = pz - z0;
+		auto h = [&](int x, int z) { return samples[size_t(z) * SIZE + x] * (SCALE / 255.0); };
+		double bottom = h(x0, z0) + (h(x0 + 1, z0) - h(x0, z0)) * fx;
+		double top = h(x0, z0 + 1) + (h(x0 + 1, z0 + 1) - h(x0, z0 + 1)) * fx;
+		return bottom + (top - bottom) * fz;
+	};
+	bool ok = true;
+	for (size_t i = 0; i < QUERIES && ok; i++) {
+		double expected = reference(xs[i], zs[i]);
+		if (std::abs(scalar[i] - expected) > 1e-3 * SCALE || std::abs(batch[i] - expected) > 1e-3 * SCALE) {
+			out << "  mismatch: height at " << xs[i] << ", " << zs[i] << ": " << scalar[i] << " / " << batch[i] << ", expected " << expected << "\n";
+			ok = false;
+		}
+	}
+
+	// snap() in place, an odd count for the scalar tail
+	std::vector<glm::vec3> agents(1001);
+	for (glm::vec3& a : agents)
+		a = glm::vec3(position(rng), 0.0f, position(rng));
+	std::vector<glm::vec3> snapped = agents;
+	field.snap(snapped.data(), snapped.size());
+	for (size_t i = 0; i < agents.size() && ok; i++) {
+		glm::vec3 expected = field.snap(agents[i]);
+		if (glm::any(glm::greaterThan(glm::abs(snapped[i] - expected), glm::vec3(1e-3f * SCALE)))) {
+			out << "  mismatch: snapped agent " << i << "\n";
+			ok = false;
+		}
+	}
+
+	out << "Height field " << SIZE << "^2, built in " << t_build << " ms, " << QUERIES << " queries\n"
+		<< "  scalar " << 1000.0 * t_scalar / QUERIES << " ns, batch (" << Heightfield::simd_path() << ") " << 1000.0 * t_batch / QUERIES
+		<< " ns per query, " << t_scalar / t_batch << "x\n";
+	return ok;
+}
+
+bool benchTerrainRays(std::ostream& out)
+{
+	constexpr int SIZE = 1024;
+	constexpr size_t RAYS = 1 << 14;
+	Heightfield field;
+	syntheticHeightfield(field, SIZE, 127.5f);
+	HeightPyramid pyramid;
+	auto start = Clock::now();
+	pyramid.build(field);
+	double t_build = microseconds(Clock::now() - start) / 1000.0;
+
+	// half picking rays from above, looking down into the map; half line of sight between points near the ground
+	std::mt19937 rng(77);
+	std::uniform_real_distribution<float> position(0.0f, SIZE - 1.0f), unit(-1.0f, 1.0f), above(2.0f, 60.0f);
+	std::vector<HeightPyramid::Ray> rays(RAYS);
+	for (size_t i = 0; i < RAYS; i++) {
+		glm::vec3 from(position(rng), 0.0f, position(rng));
+		from.y = field.height(from.x, from.z) + above(rng);
+		if (i % 2 == 0)
+			rays[i] = { from, glm::normalize(glm::vec3(unit(rng), -0.05f - 0.5f * std::abs(unit(rng)), unit(rng))), 4.0f * SIZE };
+		else {
+			glm::vec3 to(position(rng), 0.0f, position(rng));
+			to.y = field.height(to.x, to.z) + above(rng);
+			rays[i] = { from, to - from, 1.0f };
+		}
+	}
+
+	std::vector<HeightPyramid::Hit> single(RAYS), batch(RAYS);
+	std::vector<double> reference(RAYS);
+	double t_single = timePerCall(RAYS, [&](unsigned i) { single[i] = pyramid.raycast(rays[i].origin, rays[i].direction, rays[i].t_max); });
+	start = Clock::now();
+	pyramid.raycast(rays.data(), batch.data(), RAYS);
+	double t_batch = microseconds(Clock::now() - start) / RAYS;
+	double t_march = timePerCall(RAYS, [&](unsigned i) { reference[i] = marchTerrain(field, rays[i].origin, rays[i].direction, rays[i].t_max); });
+
+	// hit or not must agree except for rays grazing the surface; hit positions must agree
+	bool ok = true;
+	size_t hits = 0, grazing = 0;
+	for (size_t i = 0; i < RAYS && ok; i++) {
+		HeightPyramid::Ray const& r = rays[i];
+		bool expected = reference[i] >= 0.0;
+		hits += expected;
+		if (single[i].hit != batch[i].hit || single[i].t != batch[i].t) {
+			out << "  mismatch: batch ray " << i << "\n";
+			ok = false;
+		}
+		else if (single[i].hit != expected) {
+			// near miss: the other result touches the surface within a fraction of a unit
+			float t = single[i].hit ? single[i].t : static_cast<float>(reference[i]);
+			glm::vec3 p = r.origin + t * r.direction;
+			if (std::abs(p.y - field.height(p.x, p.z)) < 1e-2f)
+				grazing++;
+			else {
+				out << "  mismatch: ray " << i << (expected ? " missed" : " hit") << "\n";
+				ok = false;
+			}
+		}
+		else if (expected && glm::length(single[i].position - glm::vec3(glm::dvec3(r.origin) + reference[i] * glm::dvec3(r.direction))) > 1e-2f) {
+			out << "  mismatch: ray " << i << " hit at t " << single[i].t << ", expected " << reference[i] << "\n";
+			ok = false;
+		}
+	}
+	if (grazing > RAYS / 1000) {
+		out << "  mismatch: " << grazing << " grazing rays\n";
+		ok = false;
+	}
+
+	out << "Terrain rays, " << SIZE << "^2 height field, " << pyramid.level_count() << " pyramid levels built in " << t_build << " ms, "
+		<< 100.0 * hits / RAYS << " % of " << RAYS << " rays hit\n"
+		<< "  pyramid " << 1.0 / t_single << " M rays/s, batch " << 1.0 / t_batch << " M rays/s (" << std::thread::hardware_concurrency()
+		<< " threads), marching every cell " << 1.0 / t_march << " M rays/s\n";
+	return ok;
+}
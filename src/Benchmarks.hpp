@@ -0,0 +1,27 @@
+#pragma once
+
+#include <ostream>
+
+// Headless micro-benchmarks (no window, no GL context), run with: ICP.exe --bench
+// Returns process exit code: 0 if all results matched their reference (brute force) implementation.
+int runBenchmarks(std::ostream& out);
+
+// BVH queries against linear scans over the same boxes, for growing object counts
+bool benchBvh(std::ostream& out);
+
+// software occlusion: rasterize a synthetic ridge terrain, test boxes before, behind and above it
+bool benchOcclusion(std::ostream& out);
+
+// meshlet builder on a dense sphere: limits, every triangle once, cone culling never drops a front-facing triangle
+bool benchMeshlets(std::ostream& out);
+
+// tiled height field: a synthetic file written and read back (level 0 and mips against the generator),
+// then streamed along a path with a small tile budget
+bool benchHeightStreaming(std::ostream& out);
+
+// batch height queries (SIMD) against the scalar lookup and a double precision reference,
+// including positions outside the map
+bool benchHeightfield(std::ostream& out);
+
+// terrain ray casts through the min/max pyramid against marching every cell along the ray, single and batched
+bool benchTerrainRays(std::ostream& out);
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+
+struct BoundingBox {
+	glm::vec3 min{ 0.0f };
+	glm::vec3 max{ 0.0f };
+
+	glm::vec3 center(void) const { return (min + max) * 0.5f; }
+	glm::vec3 extent(void) const { return (max - min) * 0.5f; }
+
+	static BoundingBox empty(void) {
+		return { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()) };
+	}
+
+	void merge(BoundingBox const& other) {
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	// box around the transformed box: center by the matrix, extent by |upper 3x3| (Arvo)
+	BoundingBox transformed(glm::mat4 const& m) const {
+		glm::vec3 c = glm::vec3(m * glm::vec4(center(), 1.0f));
+		glm::vec3 e = extent();
+		glm::vec3 world_extent = glm::abs(glm::vec3(m[0])) * e.x + glm::abs(glm::vec3(m[1])) * e.y + glm::abs(glm::vec3(m[2])) * e.z;
+		return { c - world_extent, c + world_extent };
+	}
+};
+
+struct BoundingSphere {
+	glm::vec3 center{ 0.0f };
+	float radius{ 0.0f };
+
+	// radius grows with the largest axis scale, so it stays conservative for non-uniform scale
+	BoundingSphere transformed(glm::mat4 const& m) const {
+		float scale = std::sqrt(std::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])),
+			std::max(glm::dot(glm::vec3(m[1]), glm::vec3(m[1])), glm::dot(glm::vec3(m[2]), glm::vec3(m[2])))));
+		return { glm::vec3(m * glm::vec4(center, 1.0f)), radius * scale };
+	}
+};
+
+// six planes (normal, distance), normalized, pointing inside
+struct Frustum {
+	enum class Test { OUTSIDE, INTERSECTS, INSIDE };
+
+	std::array<glm::vec4, 6> planes{};
+
+	// Gribb & Hartmann, GL clip space (z in -w..w)
+	static Frustum from_matrix(glm::mat4 const& m) {
+		// rows of the matrix (glm is column major)
+		glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+		Frustum f;
+		f.planes = { row3 + row0, row3 - row0,   // left, right
+			row3 + row1, row3 - row1,            // bottom, top
+			row3 + row2, row3 - row2 };          // near, far
+		for (glm::vec4& p : f.planes)
+			p /= glm::length(glm::vec3(p));
+		return f;
+	}
+
+	Test test(BoundingBox const& box) const {
+		glm::vec3 c = box.center();
+		glm::vec3 e = box.extent();
+		Test result = Test::INSIDE;
+		for (glm::vec4 const& p : planes) {
+			float d = glm::dot(glm::vec3(p), c) + p.w;
+			float r = glm::dot(glm::abs(glm::vec3(p)), e);
+			if (d + r < 0.0f)
+				return Test::OUTSIDE;
+			if (d - r < 0.0f)
+				result = Test::INTERSECTS;
+		}
+		return result;
+	}
+};
+
+inline bool overlapsSphere(BoundingBox const& box, glm::vec3 const& center, float radius) {
+	glm::vec3 d = center - glm::clamp(center, box.min, box.max);
+	return glm::dot(d, d) <= radius * radius;
+}
+
+// slab test, inv_dir = 1 / ray direction; hit distance in t (entry point, 0 when origin is inside)
+inline bool intersectRay(BoundingBox const& box, glm::vec3 const& origin, glm::vec3 const& inv_dir, float t_max, float& t) {
+	glm::vec3 t0 = (box.min - origin) * inv_dir;
+	glm::vec3 t1 = (box.max - origin) * inv_dir;
+	glm::vec3 t_lo = glm::min(t0, t1), t_hi = glm::max(t0, t1);  // not near/far, windows.h defines those
+	float t_near = std::max(std::max(t_lo.x, t_lo.y), std::max(t_lo.z, 0.0f));
+	float t_far = std::min(std::min(t_hi.x, t_hi.y), std::min(t_hi.z, t_max));
+	t = t_near;
+	return t_near <= t_far;
+}
+
+// AABB of the vertices, sphere centered in the AABB center
+inline void computeBounds(const Vertex* vertices, size_t count, BoundingBox& box, BoundingSphere& sphere) {
+	if (count == 0) {
+		box = BoundingBox{};
+		sphere = BoundingSphere{};
+		return;
+	}
+	box = BoundingBox::empty();
+	for (size_t i = 0; i < count; i++) {
+		box.min = glm::min(box.min, vertices[i].Position);
+		box.max = glm::max(box.max, vertices[i].Position);
+	}
+	sphere.center = box.center();
+	float radius2 = 0.0f;
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 d = vertices[i].Position - sphere.center;
+		radius2 = std::max(radius2, glm::dot(d, d));
+	}
+	sphere.radius = std::sqrt(radius2);
+}
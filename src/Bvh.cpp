@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#include "Bvh.hpp"
+
+namespace {
+	float surfaceArea(BoundingBox const& box)
+	{
+		glm::vec3 d = box.max - box.min;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+}
+
+void Bvh::clear(void)
+{
+	nodes.clear();
+	items.clear();
+	item_bounds.clear();
+}
+
+void Bvh::build(std::vector<BoundingBox> const& boxes)
+{
+	clear();
+	if (boxes.empty())
+		return;
+
+	item_bounds = boxes;
+	items.resize(boxes.size());
+	std::vector<glm::vec3> centroids(boxes.size());
+	for (uint32_t i = 0; i < boxes.size(); i++) {
+		items[i] = i;
+		centroids[i] = boxes[i].center();
+	}
+
+	nodes.reserve(2 * boxes.size());
+	nodes.push_back(Node{ BoundingBox{}, 0, static_cast<uint32_t>(boxes.size()) });
+
+	// children are always appended after their parent, refit() depends on it
+	std::vector<std::pair<uint32_t, unsigned>> stack{ { 0, 0 } };  // node, depth
+	while (!stack.empty()) {
+		auto [node_index, depth] = stack.back();
+		stack.pop_back();
+		subdivide(node_index, centroids, depth < MAX_DEPTH);
+		if (nodes[node_index].count == 0) {
+			stack.push_back({ nodes[node_index].first, depth + 1 });
+			stack.push_back({ nodes[node_index].first + 1, depth + 1 });
+		}
+	}
+}
+
+void Bvh::subdivide(uint32_t node_index, std::vector<glm::vec3> const& centroids, bool split)
+{
+	Node& node = nodes[node_index];
+	BoundingBox centroid_bounds = BoundingBox::empty();
+	node.bounds = BoundingBox::empty();
+	for (uint32_t i = node.first; i < node.first + node.count; i++) {
+		node.bounds.merge(item_bounds[items[i]]);
+		centroid_bounds.min = glm::min(centroid_bounds.min, centroids[items[i]]);
+		centroid_bounds.max = glm::max(centroid_bounds.max, centroids[items[i]]);
+	}
+	if (node.count <= MAX_LEAF_ITEMS || !split)
+		return;
+
+	// binned SAH: cost of a split = items left * area left + items right * area right
+	struct Bin {
+		BoundingBox bounds = BoundingBox::empty();
+		uint32_t count = 0;
+	};
+	float best_cost = node.count * surfaceArea(node.bounds);  // as a leaf
+	int best_axis = -1;
+	unsigned best_split = 0;
+
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+		if (extent <= 0.0f)
+			continue;
+		float scale = SAH_BINS / extent;
+
+		std::array<Bin, SAH_BINS> bins{};
+		for (uint32_t i = node.first; i < node.first + node.count; i++) {
+			unsigned b = std::min(SAH_BINS - 1, static_cast<unsigned>((centroids[items[i]][axis] - centroid_bounds.min[axis]) * scale));
+			bins[b].bounds.merge(item_bounds[items[i]]);
+			bins[b].count++;
+		}
+
+		// sweep from the right to get area/count right of every split, then from the left
+		std::array<float, SAH_BINS - 1> right_cost{};
+		BoundingBox right = BoundingBox::empty();
+		uint32_t right_count = 0;
+		for (unsigned b = SAH_BINS - 1; b > 0; b--) {
+			right.merge(bins[b].bounds);
+			right_count += bins[b].count;
+			right_cost[b - 1] = right_count ? right_count * surfaceArea(right) : 0.0f;
+		}
+		BoundingBox left = BoundingBox::empty();
+		uint32_t left_count = 0;
+		for (unsigned split = 0; split < SAH_BINS - 1; split++) {
+			left.merge(bins[split].bounds);
+			left_count += bins[split].count;
+			if (left_count == 0 || left_count == node.count)
+				continue;
+			float cost = left_count * surfaceArea(left) + right_cost[split];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_split = split;
+			}
+		}
+	}
+	if (best_axis < 0)
+		return;  // no split is cheaper than a leaf
+
+	float min = centroid_bounds.min[best_axis];
+	float scale = SAH_BINS / (centroid_bounds.max[best_axis] - min);
+	auto middle = std::partition(items.begin() + node.first, items.begin() + node.first + node.count, [&](uint32_t item) {
+		return std::min(SAH_BINS - 1, static_cast<unsigned>((centroids[item][best_axis] - min) * scale)) <= best_split;
+	});
+	uint32_t left_count = static_cast<uint32_t>(middle - (items.begin() + node.first));
+
+	uint32_t first = node.first, count = node.count;
+	uint32_t left_index = static_cast<uint32_t>(nodes.size());
+	node.first = left_index;
+	node.count = 0;
+	// node reference is invalid from here
+	nodes.push_back(Node{ BoundingBox{}, first, left_count });
+	nodes.push_back(Node{ BoundingBox{}, first + left_count, count - left_count });
+}
+
+void Bvh::refit(std::vector<BoundingBox> const& boxes)
+{
+	if (boxes.size() != item_bounds.size()) {
+		build(boxes);
+		return;
+	}
+	item_bounds = boxes;
+	for (size_t n = nodes.size(); n-- > 0;) {
+		Node& node = nodes[n];
+		if (node.count > 0) {
+			node.bounds = BoundingBox::empty();
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+				node.bounds.merge(item_bounds[items[i]]);
+		}
+		else {
+			node.bounds = nodes[node.first].bounds;
+			node.bounds.merge(nodes[node.first + 1].bounds);
+		}
+	}
+}
+
+void Bvh::collect(uint32_t node_index, std::vector<uint32_t>& out) const
+{
+	Node const& node = nodes[node_index];
+	if (node.count > 0)
+		out.insert(out.end(), items.begin() + node.first, items.begin() + node.first + node.count);
+	else {
+		collect(node.first, out);
+		collect(node.first + 1, out);
+	}
+}
+
+void Bvh::query_frustum(Frustum const& frustum, std::vector<uint32_t>& out) const
+{
+	if (nodes.empty())
+		return;
+	uint32_t stack[MAX_DEPTH + 2];  // one per level + sibling of the deepest node
+	unsigned top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		Node const& node = nodes[stack[--top]];
+		Frustum::Test test = frustum.test(node.bounds);
+		if (test == Frustum::Test::OUTSIDE)
+			continue;
+		if (test == Frustum::Test::INSIDE) {
+			collect(static_cast<uint32_t>(&node - nodes.data()), out);
+			continue;
+		}
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+				if (frustum.test(item_bounds[items[i]]) != Frustum::Test::OUTSIDE)
+					out.push_back(items[i]);
+		}
+		else {
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+		}
+	}
+}
+
+void Bvh::query_radius(glm::vec3 const& center, float radius, std::vector<uint32_t>& out) const
+{
+	if (nodes.empty())
+		return;
+	uint32_t stack[MAX_DEPTH + 2];  // one per level + sibling of the deepest node
+	unsigned top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		Node const& node = nodes[stack[--top]];
+		if (!overlapsSphere(node.bounds, center, radius))
+			continue;
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+				if (overlapsSphere(item_bounds[items[i]], center, radius))
+					out.push_back(items[i]);
+		}
+		else {
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+		}
+	}
+}
+
+Bvh::Hit Bvh::raycast(glm::vec3 const& origin, glm::vec3 const& direction, float t_max) const
+{
+	glm::vec3 inv_dir = 1.0f / direction;
+	Hit hit;
+	hit.t = t_max;
+	float t;
+	if (nodes.empty() || !intersectRay(nodes[0].bounds, origin, inv_dir, t_max, t))
+		return Hit{};
+
+	uint32_t stack[MAX_DEPTH + 2];
+	unsigned top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		Node const& node = nodes[stack[--top]];
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+				if (intersectRay(item_bounds[items[i]], origin, inv_dir, hit.t, t) && t < hit.t) {
+					hit.item = items[i];
+					hit.t = t;
+				}
+			continue;
+		}
+		// nearer child on top of the stack; children are tested against the nearest hit so far
+		float t_left, t_right;
+		bool left = intersectRay(nodes[node.first].bounds, origin, inv_dir, hit.t, t_left);
+		bool right = intersectRay(nodes[node.first + 1].bounds, origin, inv_dir, hit.t, t_right);
+		if (left && right) {
+			bool left_first = t_left <= t_right;
+			stack[top++] = left_first ? node.first + 1 : node.first;
+			stack[top++] = left_first ? node.first : node.first + 1;
+		}
+		else if (left)
+			stack[top++] = node.first;
+		else if (right)
+			stack[top++] = node.first + 1;
+	}
+	if (hit.item == NO_HIT)
+		return Hit{};
+	return hit;
+}
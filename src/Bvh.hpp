@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.hpp"
+
+// Bounding volume hierarchy over a set of boxes (world bounds of meshes), items are indices into that set.
+// build() splits by binned surface area heuristic, for objects that do not move.
+// refit() keeps the topology and only recomputes node boxes - cheap, for moving objects;
+// the tree gets worse when objects move far, build() again then.
+class Bvh {
+public:
+	static constexpr uint32_t NO_HIT = std::numeric_limits<uint32_t>::max();
+
+	struct Hit {
+		uint32_t item{ NO_HIT };
+		float t{ std::numeric_limits<float>::max() };
+	};
+
+	void build(std::vector<BoundingBox> const& boxes);
+	// same number of boxes as in build(), in the same order
+	void refit(std::vector<BoundingBox> const& boxes);
+	void clear(void);
+
+	// items whose box is not completely outside; subtrees completely inside are taken without further tests
+	void query_frustum(Frustum const& frustum, std::vector<uint32_t>& items) const;
+	// items whose box overlaps the sphere
+	void query_radius(glm::vec3 const& center, float radius, std::vector<uint32_t>& items) const;
+	// nearest box hit by the ray (direction need not be normalized, t is in its units)
+	Hit raycast(glm::vec3 const& origin, glm::vec3 const& direction, float t_max = std::numeric_limits<float>::max()) const;
+
+	size_t size(void) const { return item_bounds.size(); }
+	size_t node_count(void) const { return nodes.size(); }
+
+private:
+	static constexpr uint32_t MAX_LEAF_ITEMS = 4;
+	static constexpr unsigned SAH_BINS = 12;
+	static constexpr unsigned MAX_DEPTH = 48;  // deeper nodes become leaves, bounds the traversal stacks
+
+	// leaf: count > 0, items[first .. first + count); inner: count == 0, children at first and first + 1
+	struct Node {
+		BoundingBox bounds;
+		uint32_t first{ 0 };
+		uint32_t count{ 0 };
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> items;
+	std::vector<BoundingBox> item_bounds;
+
+	void subdivide(uint32_t node_index, std::vector<glm::vec3> const& centroids, bool split);
+	void collect(uint32_t node_index, std::vector<uint32_t>& out) const;
+};
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "ClipmapTerrain.hpp"
+#include "GLBuffers.hpp"
+#include "GLState.hpp"
+
+ClipmapTerrain::~ClipmapTerrain()
+{
+	clear();
+}
+
+void ClipmapTerrain::clear(void)
+{
+	GLState::get().forget_vertex_array(VAO);
+	GLState::get().forget_texture(height_texture);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteTextures(1, &height_texture);
+	GLuint buffers[] = { VBO, EBO, level_buffer };
+	glDeleteBuffers(3, buffers);
+	VAO = VBO = EBO = height_texture = level_buffer = 0;
+	level_capacity = 0;
+	index_count = 0;
+	level_state.clear();
+	draw_levels.clear();
+	staging.clear();
+	atlas.reset();
+	streamer.reset();
+	shader = nullptr;
+}
+
+void ClipmapTerrain::init(ShaderProgram& shader, std::shared_ptr<HeightStreamer> streamer, std::shared_ptr<Texture> atlas, float texture_tile)
+{
+	clear();
+	this->shader = &shader;
+	this->streamer = std::move(streamer);
+	this->atlas = std::move(atlas);
+	level_state.resize(std::min(this->streamer->levels(), MAX_LEVELS));
+
+	// one grid for all levels: shared vertices, 16-bit indices
+	static_assert(GRID * GRID <= 65536, "clipmap grid must fit 16-bit indices");
+	static_assert((GRID - 1) % 4 == 0, "hole of a level must lie on its grid lines");
+	std::vector<glm::vec2> grid;
+	for (int z = 0; z < GRID; z++)
+		for (int x = 0; x < GRID; x++)
+			grid.emplace_back(x, z);
+	std::vector<GLushort> indices;
+	for (int z = 0; z + 1 < GRID; z++)
+		for (int x = 0; x + 1 < GRID; x++) {
+			// same winding as Terrain. Diagonals alternate with x + z: a hole is HALF (even) samples wide and starts
+			// at an even x + z (centers are multiples of 4), so the diagonal of each corner quad of the hole runs
+			// through the hole's corner. No triangle inside the hole has all 3 vertices on its border (clip distance 0 there).
+			GLushort i0 = static_cast<GLushort>(z * GRID + x);
+			GLushort i1 = i0 + 1, i3 = i0 + GRID, i2 = i3 + 1;
+			if ((x + z) % 2 == 0)
+				indices.insert(indices.end(), { i0, i2, i1, i0, i3, i2 });
+			else
+				indices.insert(indices.end(), { i0, i3, i1, i1, i3, i2 });
+		}
+	index_count = static_cast<GLsizei>(indices.size());
+
+	glCreateBuffers(1, &VBO);
+	glCreateBuffers(1, &EBO);
+	glNamedBufferStorage(VBO, grid.size() * sizeof(glm::vec2), grid.data(), 0);
+	glNamedBufferStorage(EBO, indices.size() * sizeof(GLushort), indices.data(), 0);
+
+	glCreateVertexArrays(1, &VAO);
+	GLint grid_location = glGetAttribLocation(shader.getID(), "aGrid");
+	if (grid_location == -1)
+		std::cerr << "Position of 'aGrid' not found" << std::endl;
+	else {
+		glVertexArrayAttribFormat(VAO, grid_location, 2, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(VAO, grid_location, 0);
+		glEnableVertexArrayAttrib(VAO, grid_location);
+	}
+	glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(glm::vec2));
+	glVertexArrayElementBuffer(VAO, EBO);
+
+	// sample s of level l is texel s mod TEXTURE_SIZE of layer l, repeat makes bilinear lookups wrap too
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &height_texture);
+	glTextureStorage3D(height_texture, 1, GL_R16, TEXTURE_SIZE, TEXTURE_SIZE, levels());
+	glTextureParameteri(height_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(height_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(height_texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(height_texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	glCreateBuffers(1, &level_buffer);
+
+	shader.activate();
+	shader.setUniform("tex0", 0);
+	shader.setUniform("heights", 1);
+	shader.setUniform("height_scale", this->streamer->header().height_scale);
+	shader.setUniform("texture_tile", texture_tile);
+	shader.setUniform("top_layer", levels() - 1);
+
+	std::cout << "Clipmap terrain: " << this->streamer->level_width(0) << "x" << this->streamer->level_height(0) << ", "
+		<< levels() << " levels of " << GRID << "^2, " << gpu_bytes() / 1024 << " KiB GPU\n";
+}
+
+size_t ClipmapTerrain::gpu_bytes(void) const
+{
+	if (VAO == 0)
+		return 0;
+	return size_t(TEXTURE_SIZE) * TEXTURE_SIZE * sizeof(HeightTileFile::Sample) * levels()
+		+ size_t(GRID) * GRID * sizeof(glm::vec2) + size_t(index_count) * sizeof(GLushort);
+}
+
+bool ClipmapTerrain::resident(int level, glm::ivec2 lo, glm::ivec2 hi)
+{
+	glm::ivec2 last(streamer->level_width(level) - 1, streamer->level_height(level) - 1);
+	lo = glm::clamp(lo, glm::ivec2(0), last) / streamer->tile_size();
+	hi = glm::clamp(hi, glm::ivec2(0), last) / streamer->tile_size();
+	bool all = true;
+	for (int tz = lo.y; tz <= hi.y; tz++)
+		for (int tx = lo.x; tx <= hi.x; tx++)
+			all &= streamer->tile(level, tx, tz) != nullptr;  // requests every missing one
+	return all;
+}
+
+void ClipmapTerrain::upload(int level, glm::ivec2 lo, glm::ivec2 hi)
+{
+	const int T = streamer->tile_size();
+	const int W = streamer->level_width(level), H = streamer->level_height(level);
+	int w = hi.x - lo.x + 1, h = hi.y - lo.y + 1;
+	staging.resize(size_t(w) * h);
+
+	// outside the map: nearest border sample
+	std::shared_ptr<const HeightStreamer::Tile> tile;
+	int tile_x = -1, tile_z = -1;
+	for (int z = 0; z < h; z++) {
+		int sz = std::clamp(lo.y + z, 0, H - 1);
+		for (int x = 0; x < w; x++) {
+			int sx = std::clamp(lo.x + x, 0, W - 1);
+			if (sx / T != tile_x || sz / T != tile_z) {
+				tile_x = sx / T;
+				tile_z = sz / T;
+				tile = streamer->tile(level, tile_x, tile_z);
+			}
+			staging[size_t(z) * w + x] = tile ? (*tile)[size_t(sz % T) * T + sx % T] : 0;
+		}
+	}
+
+	// toroidal: up to 4 pieces where the rectangle wraps around the texture
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, w);
+	for (int z = 0; z < h;) {
+		int tz = (lo.y + z) & (TEXTURE_SIZE - 1);
+		int rows = std::min(h - z, TEXTURE_SIZE - tz);
+		for (int x = 0; x < w;) {
+			int tx = (lo.x + x) & (TEXTURE_SIZE - 1);
+			int cols = std::min(w - x, TEXTURE_SIZE - tx);
+			glTextureSubImage3D(height_texture, 0, tx, tz, level, cols, rows, 1, GL_RED, GL_UNSIGNED_SHORT, staging.data() + size_t(z) * w + x);
+			x += cols;
+		}
+		z += rows;
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	uploaded += size_t(w) * h;
+}
+
+void ClipmapTerrain::update(glm::vec3 const& camera_pos)
+{
+	draw_levels.clear();
+	uploaded = 0;
+	if (!ready())
+		return;
+	streamer->begin_frame();
+
+	// finest first: the streamer reads the newest requests first, so coarse levels (needed to draw anything) win
+	glm::vec2 camera(camera_pos.x, camera_pos.z);
+	for (int l = 0; l < levels(); l++) {
+		Level& level = level_state[l];
+		float spacing = static_cast<float>(1 << l);
+		glm::ivec2 center = 4 * glm::ivec2(glm::floor(camera / (4.0f * spacing) + 0.5f));
+
+		resident(l, center - (HALF + 1 + PREFETCH), center + (HALF + 1 + PREFETCH));
+		if (level.valid && level.center == center)
+			continue;
+		glm::ivec2 lo = center - (HALF + 1), hi = center + (HALF + 1);  // grid + border
+		if (!resident(l, lo, hi))
+			continue;  // stays where it was until the tiles arrive
+
+		glm::ivec2 old = level.center, moved = center - old;
+		if (!level.valid || std::abs(moved.x) > 2 * HALF + 2 || std::abs(moved.y) > 2 * HALF + 2)
+			upload(l, lo, hi);
+		else {
+			// only what came into range; the rest of the texture is still valid where it is
+			if (moved.x > 0)
+				upload(l, glm::ivec2(old.x + HALF + 2, lo.y), hi);
+			else if (moved.x < 0)
+				upload(l, lo, glm::ivec2(old.x - HALF - 2, hi.y));
+			if (moved.y > 0)
+				upload(l, glm::ivec2(lo.x, old.y + HALF + 2), hi);
+			else if (moved.y < 0)
+				upload(l, lo, glm::ivec2(hi.x, old.y - HALF - 2));
+		}
+		level.center = center;
+		level.valid = true;
+	}
+
+	// from the coarsest down, while a level is loaded, has the camera in its inner half and fits in the coarser one
+	int top = levels() - 1;
+	if (top < 0 || !level_state[top].valid)
+		return;
+	int finest = top;
+	for (int l = top - 1; l >= 0; l--) {
+		Level const& fine = level_state[l];
+		Level const& coarse = level_state[l + 1];
+		if (!fine.valid)
+			break;
+		glm::ivec2 camera_sample = glm::ivec2(glm::floor(camera / static_cast<float>(1 << l)));
+		glm::ivec2 from_center = glm::abs(camera_sample - fine.center);
+		glm::ivec2 offset = glm::abs(fine.center / 2 - coarse.center);
+		if (std::max(from_center.x, from_center.y) > HALF / 2 || std::max(offset.x, offset.y) + HALF / 2 > HALF - 1)
+			break;
+		finest = l;
+	}
+
+	for (int l = finest; l <= top; l++) {
+		float spacing = static_cast<float>(1 << l);
+		glm::vec4 hole(1.0f, 1.0f, -1.0f, -1.0f);  // none
+		if (l > finest) {
+			glm::vec2 fine_center = glm::vec2(level_state[l - 1].center) * (spacing * 0.5f);
+			float fine_half = HALF * spacing * 0.5f;
+			hole = glm::vec4(fine_center - fine_half, fine_center + fine_half);
+		}
+		draw_levels.push_back(LevelData{ level_state[l].center - HALF, spacing, l, hole });
+	}
+}
+
+void ClipmapTerrain::draw(void)
+{
+	if (draw_levels.empty())
+		return;
+
+	uploadGrowing(level_buffer, level_capacity, draw_levels);
+
+	shader->activate();
+	GLState::get().bind_texture_unit(0, atlas ? atlas->id : 0);
+	GLState::get().bind_texture_unit(1, height_texture);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, level_buffer);
+	GLState::get().bind_vertex_array(VAO);
+	GLState::get().set_enabled(GL_CLIP_DISTANCE0, true);
+	glDrawElementsInstanced(GL_TRIANGLES, index_count, GL_UNSIGNED_SHORT, nullptr, static_cast<GLsizei>(draw_levels.size()));
+	GLState::get().set_enabled(GL_CLIP_DISTANCE0, false);
+}
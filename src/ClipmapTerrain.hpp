@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "HeightStreamer.hpp"
+#include "ShaderProgram.hpp"
+#include "Texture.h"
+
+// Geometry clipmap (Losasso & Hoppe 2004) over a streamed HeightTileFile, for maps of any size:
+// GPU memory is TEXTURE_SIZE^2 samples per level, CPU memory the streamer's tile budget.
+// Level l holds GRID x GRID samples of the file's mip l around the camera, in layer l of a texture array
+// addressed toroidally: when the camera moves, only the rows and columns that came into range are uploaded.
+// A level whose tiles are not resident yet keeps its old position (and is not drawn when it no longer
+// contains the camera); coarser levels fill in meanwhile. See clipmap.vert for drawing.
+class ClipmapTerrain {
+public:
+	static constexpr int GRID = 253;          // vertices per side, (GRID - 1) / 4 whole: a level's hole lies on its grid lines
+	static constexpr int HALF = (GRID - 1) / 2;
+	static constexpr int TEXTURE_SIZE = 256;  // power of 2, > GRID + 1 (a border sample for normals)
+	static constexpr int MAX_LEVELS = 16;
+	static constexpr int PREFETCH = 64;       // samples beyond a level's region whose tiles are requested ahead
+
+	// std430 layout of Level in clipmap.vert
+	struct LevelData {
+		glm::ivec2 origin;
+		float spacing;
+		GLint layer;
+		glm::vec4 hole;
+	};
+	static_assert(sizeof(LevelData) == 32, "LevelData must match std430 layout in clipmap.vert");
+
+	ClipmapTerrain(void) = default;
+	ClipmapTerrain(ClipmapTerrain const&) = delete;
+	ClipmapTerrain& operator=(ClipmapTerrain const&) = delete;
+	~ClipmapTerrain();
+
+	// atlas: 16 x 16 tiles picked by height in terrain.frag
+	void init(ShaderProgram& shader, std::shared_ptr<HeightStreamer> streamer, std::shared_ptr<Texture> atlas, float texture_tile = 10.0f);
+	bool ready(void) const { return VAO != 0; }
+
+	// follow the camera: request tiles, upload what came into range, choose the levels to draw
+	void update(glm::vec3 const& camera_pos);
+	void draw(void);
+
+	int levels(void) const { return static_cast<int>(level_state.size()); }
+	int levels_drawn(void) const { return static_cast<int>(draw_levels.size()); }
+	size_t texels_uploaded(void) const { return uploaded; }  // by the last update()
+	size_t gpu_bytes(void) const;
+
+	// delete GL objects, GL context must be current
+	void clear(void);
+
+private:
+	struct Level {
+		glm::ivec2 center{ 0 };  // multiple of 4, in samples of the level (hole corners at even x + z of the coarser one)
+		bool valid{ false };
+	};
+
+	ShaderProgram* shader{ nullptr };
+	std::shared_ptr<HeightStreamer> streamer;
+	std::shared_ptr<Texture> atlas;
+
+	std::vector<Level> level_state;
+	std::vector<LevelData> draw_levels;  // finest first
+	size_t uploaded{ 0 };
+	std::vector<HeightTileFile::Sample> staging;
+
+	GLuint VAO{ 0 }, VBO{ 0 }, EBO{ 0 }, height_texture{ 0 }, level_buffer{ 0 };
+	size_t level_capacity{ 0 };
+	GLsizei index_count{ 0 };
+
+	// tiles of the level under [lo, hi] (samples, clamped to the level) resident; missing ones are requested
+	bool resident(int level, glm::ivec2 lo, glm::ivec2 hi);
+	// samples [lo, hi] of the level into its layer, wrapped around TEXTURE_SIZE; tiles must be resident
+	void upload(int level, glm::ivec2 lo, glm::ivec2 hi);
+};
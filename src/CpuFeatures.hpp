@@ -0,0 +1,28 @@
+#pragma once
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles AVX2 intrinsics in any function
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+// AVX2 usable: the CPU has it and the OS saves YMM registers; ask once and keep the answer
+inline bool cpuHasAvx2(void)
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!osxsave || (_xgetbv(0) & 6) != 6)  // OS saves YMM registers
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
@@ -0,0 +1,110 @@
+#include <cmath>
+#include <initializer_list>
+
+#include <immintrin.h>
+
+#include "CpuFeatures.hpp"
+#include "FrustumCuller.hpp"
+
+namespace {
+	constexpr size_t LANES = 8;  // padding, enough for both paths
+
+	struct Soa {
+		const float *cx, *cy, *cz, *ex, *ey, *ez;
+	};
+
+	// writes 0/1 per box, returns number of visible boxes among the first count
+	AVX2_TARGET size_t cull_avx2(std::array<glm::vec4, 6> const& planes, Soa const& boxes, size_t count, uint8_t* result)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		size_t visible = 0;
+		for (size_t i = 0; i < count; i += 8) {
+			__m256 cx = _mm256_loadu_ps(boxes.cx + i), cy = _mm256_loadu_ps(boxes.cy + i), cz = _mm256_loadu_ps(boxes.cz + i);
+			__m256 ex = _mm256_loadu_ps(boxes.ex + i), ey = _mm256_loadu_ps(boxes.ey + i), ez = _mm256_loadu_ps(boxes.ez + i);
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (glm::vec4 const& p : planes) {
+				// signed distance of the center + projected half size of the box
+				__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.x), cx), _mm256_mul_ps(_mm256_set1_ps(p.y), cy)),
+					_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.z), cz), _mm256_set1_ps(p.w)));
+				__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(p.x)), ex), _mm256_mul_ps(_mm256_set1_ps(std::abs(p.y)), ey)),
+					_mm256_mul_ps(_mm256_set1_ps(std::abs(p.z)), ez));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+			}
+			int mask = _mm256_movemask_ps(inside);
+			for (size_t k = 0; k < 8 && i + k < count; k++) {
+				result[i + k] = (mask >> k) & 1;
+				visible += result[i + k];
+			}
+		}
+		return visible;
+	}
+
+	size_t cull_sse(std::array<glm::vec4, 6> const& planes, Soa const& boxes, size_t count, uint8_t* result)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		size_t visible = 0;
+		for (size_t i = 0; i < count; i += 4) {
+			__m128 cx = _mm_loadu_ps(boxes.cx + i), cy = _mm_loadu_ps(boxes.cy + i), cz = _mm_loadu_ps(boxes.cz + i);
+			__m128 ex = _mm_loadu_ps(boxes.ex + i), ey = _mm_loadu_ps(boxes.ey + i), ez = _mm_loadu_ps(boxes.ez + i);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (glm::vec4 const& p : planes) {
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), cx), _mm_mul_ps(_mm_set1_ps(p.y), cy)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.z), cz), _mm_set1_ps(p.w)));
+				__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(p.x)), ex), _mm_mul_ps(_mm_set1_ps(std::abs(p.y)), ey)),
+					_mm_mul_ps(_mm_set1_ps(std::abs(p.z)), ez));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+			}
+			int mask = _mm_movemask_ps(inside);
+			for (size_t k = 0; k < 4 && i + k < count; k++) {
+				result[i + k] = (mask >> k) & 1;
+				visible += result[i + k];
+			}
+		}
+		return visible;
+	}
+
+	const bool use_avx2 = cpuHasAvx2();
+}
+
+const char* FrustumCuller::simd_path(void)
+{
+	return use_avx2 ? "AVX2" : "SSE";
+}
+
+void FrustumCuller::set_frustum(glm::mat4 const& view_projection)
+{
+	planes = Frustum::from_matrix(view_projection).planes;
+}
+
+void FrustumCuller::clear(void)
+{
+	count = 0;
+	visible_total = 0;
+	cx.clear(); cy.clear(); cz.clear();
+	ex.clear(); ey.clear(); ez.clear();
+}
+
+size_t FrustumCuller::add(BoundingBox const& box)
+{
+	glm::vec3 c = box.center();
+	glm::vec3 e = box.extent();
+	cx.push_back(c.x); cy.push_back(c.y); cz.push_back(c.z);
+	ex.push_back(e.x); ey.push_back(e.y); ez.push_back(e.z);
+	return count++;
+}
+
+void FrustumCuller::run(void)
+{
+	// pad with empty boxes, so that the last group can be loaded whole
+	size_t padded = (count + LANES - 1) / LANES * LANES;
+	for (std::vector<float>* v : { &cx, &cy, &cz, &ex, &ey, &ez })
+		v->resize(padded, 0.0f);
+	result.resize(padded);
+
+	Soa boxes{ cx.data(), cy.data(), cz.data(), ex.data(), ey.data(), ez.data() };
+	visible_total = use_avx2 ? cull_avx2(planes, boxes, count, result.data()) : cull_sse(planes, boxes, count, result.data());
+
+	// back to unpadded, add() appends after the real boxes
+	for (std::vector<float>* v : { &cx, &cy, &cz, &ex, &ey, &ez })
+		v->resize(count);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.hpp"
+
+// Tests world-space AABBs against the six planes of a view-projection matrix.
+// Boxes are kept as center/extent in structure-of-arrays form, padded to a multiple of 8,
+// and tested 8 at a time with AVX2 when the CPU has it, 4 at a time with SSE otherwise.
+// A box is culled only when it lies completely behind one plane, so the test is conservative.
+class FrustumCuller {
+public:
+	// see Frustum::from_matrix
+	void set_frustum(glm::mat4 const& view_projection);
+	void set_frustum(Frustum const& frustum) { planes = frustum.planes; }
+
+	void clear(void);
+	// returns index for visible()
+	size_t add(BoundingBox const& box);
+
+	// test all boxes added since clear()
+	void run(void);
+
+	bool visible(size_t index) const { return result[index] != 0; }
+	size_t size(void) const { return count; }
+	size_t visible_count(void) const { return visible_total; }
+	size_t culled_count(void) const { return count - visible_total; }
+
+	// "AVX2" or "SSE", chosen once at startup
+	static const char* simd_path(void);
+
+private:
+	std::array<glm::vec4, 6> planes{};
+
+	size_t count{ 0 };
+	size_t visible_total{ 0 };
+	std::vector<float> cx, cy, cz, ex, ey, ez;
+	std::vector<uint8_t> result;
+};
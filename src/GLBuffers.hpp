@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLState.hpp"
+#include "ShaderProgram.hpp"
+
+// Buffers that grow with their contents (glNamedBufferData, not immutable storage), capacity is in elements.
+
+// grow to the whole vector (and upload all of it), or update elements [first, size)
+template <typename T>
+void uploadGrowing(GLuint buffer, size_t& capacity, std::vector<T> const& data, size_t first = 0)
+{
+	if (data.size() > capacity) {
+		capacity = data.size();
+		glNamedBufferData(buffer, capacity * sizeof(T), data.data(), GL_DYNAMIC_DRAW);
+	}
+	else if (data.size() > first)
+		glNamedBufferSubData(buffer, first * sizeof(T), (data.size() - first) * sizeof(T), data.data() + first);
+}
+
+// room for count elements written by the GPU, contents are undefined after growing
+inline void reserveGrowing(GLuint buffer, size_t& capacity, size_t count, size_t element_size)
+{
+	if (count <= capacity)
+		return;
+	capacity = count;
+	glNamedBufferData(buffer, capacity * element_size, nullptr, GL_DYNAMIC_COPY);
+}
+
+// Textures of a multi-draw: bound to units 0..n-1, picked per draw by index into the sampler array
+// "textures" of tex_indirect.frag. Shared by IndirectRenderer and MeshletRenderer.
+class TextureSlots {
+public:
+	static constexpr size_t MAX_TEXTURES = 16;  // sampler array size in tex_indirect.frag
+
+	explicit TextureSlots(const char* owner) : owner(owner) {}
+
+	// unit i for textures[i], shader must be linked
+	static void setup_samplers(ShaderProgram& shader)
+	{
+		shader.activate();
+		for (size_t i = 0; i < MAX_TEXTURES; i++)
+			shader.setUniform("textures[" + std::to_string(i) + "]", static_cast<int>(i));
+	}
+
+	// index of the texture, added if new; 0 (with a warning) when all slots are taken
+	GLint slot(GLuint texture_id)
+	{
+		auto it = index.find(texture_id);
+		if (it != index.end())
+			return it->second;
+
+		if (textures.size() == MAX_TEXTURES) {
+			std::cerr << owner << ": more than " << MAX_TEXTURES << " textures, using texture 0 instead of " << texture_id << '\n';
+			return 0;
+		}
+		textures.push_back(texture_id);
+		return index[texture_id] = static_cast<GLint>(textures.size() - 1);
+	}
+
+	void bind(void) const { GLState::get().bind_textures(0, static_cast<GLsizei>(textures.size()), textures.data()); }
+
+	void clear(void)
+	{
+		textures.clear();
+		index.clear();
+	}
+
+private:
+	const char* owner;
+	std::vector<GLuint> textures;
+	std::unordered_map<GLuint, GLint> index;
+};
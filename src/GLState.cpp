@@ -0,0 +1,128 @@
+#include "GLState.hpp"
+
+GLState& GLState::get(void)
+{
+	static GLState state;
+	return state;
+}
+
+void GLState::invalidate(void)
+{
+	program = UNKNOWN;
+	vao = UNKNOWN;
+	textures.fill(UNKNOWN);
+	blend = depth_test = cull_face = -1;
+	depth_write = -1;
+}
+
+void GLState::forget_program(GLuint program)
+{
+	if (this->program == program)
+		this->program = UNKNOWN;
+}
+
+void GLState::forget_vertex_array(GLuint vao)
+{
+	if (this->vao == vao)
+		this->vao = UNKNOWN;
+}
+
+void GLState::forget_texture(GLuint texture)
+{
+	for (GLuint& t : textures)
+		if (t == texture)
+			t = UNKNOWN;
+}
+
+void GLState::begin_frame(void)
+{
+	previous = current;
+	current = Counters{};
+}
+
+void GLState::use_program(GLuint program)
+{
+	if (this->program == program) {
+		current.skipped++;
+		return;
+	}
+	glUseProgram(program);
+	this->program = program;
+	current.issued++;
+}
+
+void GLState::bind_vertex_array(GLuint vao)
+{
+	if (this->vao == vao) {
+		current.skipped++;
+		return;
+	}
+	glBindVertexArray(vao);
+	this->vao = vao;
+	current.issued++;
+}
+
+void GLState::bind_texture_unit(GLuint unit, GLuint texture)
+{
+	if (unit < MAX_TEXTURE_UNITS) {
+		if (textures[unit] == texture) {
+			current.skipped++;
+			return;
+		}
+		textures[unit] = texture;
+	}
+	glBindTextureUnit(unit, texture);
+	current.issued++;
+}
+
+void GLState::bind_textures(GLuint first, GLsizei count, const GLuint* textures)
+{
+	bool same = first + count <= MAX_TEXTURE_UNITS;
+	for (GLsizei i = 0; same && i < count; i++)
+		same = this->textures[first + i] == textures[i];
+	if (same) {
+		current.skipped++;
+		return;
+	}
+	glBindTextures(first, count, textures);
+	for (GLsizei i = 0; i < count && first + i < MAX_TEXTURE_UNITS; i++)
+		this->textures[first + i] = textures[i];
+	current.issued++;
+}
+
+int* GLState::capability_slot(GLenum capability)
+{
+	switch (capability) {
+	case GL_BLEND: return &blend;
+	case GL_DEPTH_TEST: return &depth_test;
+	case GL_CULL_FACE: return &cull_face;
+	default: return nullptr;
+	}
+}
+
+void GLState::set_enabled(GLenum capability, bool enabled)
+{
+	int* slot = capability_slot(capability);
+	if (slot && *slot == int(enabled)) {
+		current.skipped++;
+		return;
+	}
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+	if (slot)
+		*slot = int(enabled);
+	current.issued++;
+}
+
+void GLState::depth_mask(bool write)
+{
+	if (depth_write == int(write)) {
+		current.skipped++;
+		return;
+	}
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+	depth_write = int(write);
+	current.issued++;
+}
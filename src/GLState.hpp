@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// Shadow copy of the GL state we change per draw: program, VAO, texture units, blend/depth/cull.
+// Calls that would not change anything are skipped and counted.
+// One GL context = one instance, use GLState::get(). Anything that touches GL state behind its back
+// (ImGui, raw GL calls) must be followed by invalidate().
+class GLState {
+public:
+	static constexpr size_t MAX_TEXTURE_UNITS = 32;
+
+	struct Counters {
+		size_t issued{ 0 };
+		size_t skipped{ 0 };
+	};
+
+	static GLState& get(void);
+
+	void use_program(GLuint program);
+	void bind_vertex_array(GLuint vao);
+	void bind_texture_unit(GLuint unit, GLuint texture);
+	void bind_textures(GLuint first, GLsizei count, const GLuint* textures);
+
+	void set_enabled(GLenum capability, bool enabled);  // GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE
+	void depth_mask(bool write);
+
+	// for redundant uniform uploads found by ShaderProgram
+	void count_skipped(void) { current.skipped++; }
+	void count_issued(void) { current.issued++; }
+
+	// forget everything, next call of each kind goes to GL
+	void invalidate(void);
+	// object was deleted (GL unbinds it, its name may be reused), do not match it any more
+	void forget_program(GLuint program);
+	void forget_vertex_array(GLuint vao);
+	void forget_texture(GLuint texture);
+
+	// start counting a new frame, previous frame's numbers stay in last_frame()
+	void begin_frame(void);
+	Counters const& last_frame(void) const { return previous; }
+
+private:
+	GLState(void) { invalidate(); }
+
+	static constexpr GLuint UNKNOWN = ~GLuint(0);
+
+	GLuint program;
+	GLuint vao;
+	std::array<GLuint, MAX_TEXTURE_UNITS> textures;
+
+	// -1 unknown, 0 disabled, 1 enabled
+	int blend, depth_test, cull_face;
+	int depth_write;
+
+	Counters current, previous;
+
+	int* capability_slot(GLenum capability);
+};
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "HeightPyramid.hpp"
+
+namespace {
+	// entry and exit of the ray through the box, within [0, t_max]
+	bool slab(BoundingBox const& box, glm::vec3 const& origin, glm::vec3 const& inv_dir, float t_max, float& t_in, float& t_out)
+	{
+		glm::vec3 t0 = (box.min - origin) * inv_dir;
+		glm::vec3 t1 = (box.max - origin) * inv_dir;
+		glm::vec3 t_lo = glm::min(t0, t1), t_hi = glm::max(t0, t1);
+		t_in = std::max(std::max(t_lo.x, t_lo.y), std::max(t_lo.z, 0.0f));
+		t_out = std::min(std::min(t_hi.x, t_hi.y), std::min(t_hi.z, t_max));
+		return t_in <= t_out;
+	}
+}
+
+void HeightPyramid::clear(void)
+{
+	field = nullptr;
+	levels.clear();
+}
+
+void HeightPyramid::build(Heightfield const& field)
+{
+	clear();
+	if (field.width() < 2 || field.depth() < 2)
+		return;
+	this->field = &field;
+
+	Level base;
+	base.cells_x = field.width() - 1;
+	base.cells_z = field.depth() - 1;
+	base.range.resize(size_t(base.cells_x) * base.cells_z);
+	for (int z = 0; z < base.cells_z; z++)
+		for (int x = 0; x < base.cells_x; x++) {
+			float h00 = field.sample(x, z), h10 = field.sample(x + 1, z);
+			float h01 = field.sample(x, z + 1), h11 = field.sample(x + 1, z + 1);
+			base.range[size_t(z) * base.cells_x + x] = glm::vec2(std::min(std::min(h00, h10), std::min(h01, h11)), std::max(std::max(h00, h10), std::max(h01, h11)));
+		}
+	levels.push_back(std::move(base));
+
+	while (levels.back().cells_x > 1 || levels.back().cells_z > 1) {
+		Level const& child = levels.back();
+		Level parent;
+		parent.cells_x = (child.cells_x + 1) / 2;
+		parent.cells_z = (child.cells_z + 1) / 2;
+		parent.cell_size = child.cell_size * 2;
+		parent.range.assign(size_t(parent.cells_x) * parent.cells_z, glm::vec2(std::numeric_limits<float>::max(), -std::numeric_limits<float>::max()));
+		for (int z = 0; z < child.cells_z; z++)
+			for (int x = 0; x < child.cells_x; x++) {
+				glm::vec2 const& c = child.range[size_t(z) * child.cells_x + x];
+				glm::vec2& p = parent.range[size_t(z / 2) * parent.cells_x + x / 2];
+				p.x = std::min(p.x, c.x);
+				p.y = std::max(p.y, c.y);
+			}
+		levels.push_back(std::move(parent));
+	}
+}
+
+BoundingBox HeightPyramid::cell_box(int level, int x, int z) const
+{
+	Level const& l = levels[level];
+	glm::vec2 range = l.range[size_t(z) * l.cells_x + x];
+	// the last cells of a level may reach past the map
+	float x0 = static_cast<float>(x * l.cell_size), z0 = static_cast<float>(z * l.cell_size);
+	float x1 = static_cast<float>(std::min((x + 1) * l.cell_size, levels[0].cells_x));
+	float z1 = static_cast<float>(std::min((z + 1) * l.cell_size, levels[0].cells_z));
+	return { glm::vec3(x0, range.x, z0), glm::vec3(x1, range.y, z1) };
+}
+
+bool HeightPyramid::intersect_cell(int x, int z, glm::vec3 const& origin, glm::vec3 const& direction, float t_min, float t_max, float& t) const
+{
+	// surface h00 + a u + b v + k u v over the cell, u and v local; along the ray f(s) = y(s) - h(s) is quadratic.
+	// s = t - t_min keeps the coefficients small, far from the origin too
+	float h00 = field->sample(x, z), h10 = field->sample(x + 1, z);
+	float h01 = field->sample(x, z + 1), h11 = field->sample(x + 1, z + 1);
+	float a = h10 - h00, b = h01 - h00, k = h11 - h10 - h01 + h00;
+	glm::vec3 entry = origin + t_min * direction;
+	float u0 = entry.x - x, v0 = entry.z - z;
+
+	float qa = -k * direction.x * direction.z;
+	float qb = direction.y - a * direction.x - b * direction.z - k * (u0 * direction.z + v0 * direction.x);
+	float qc = entry.y - h00 - a * u0 - b * v0 - k * u0 * v0;
+	auto f = [&](float s) { return (qa * s + qb) * s + qc; };
+
+	if (qc <= 0.0f) {
+		t = t_min;
+		return true;
+	}
+	float s_max = t_max - t_min;
+	float roots[2];
+	int root_count = 0;
+	if (std::abs(qa) < 1e-12f) {
+		if (qb != 0.0f)
+			roots[root_count++] = -qc / qb;
+	}
+	else {
+		float discriminant = qb * qb - 4.0f * qa * qc;
+		if (discriminant >= 0.0f) {
+			// no cancellation: q has the sign of qb
+			float q = -0.5f * (qb + std::copysign(std::sqrt(discriminant), qb));
+			roots[root_count++] = q / qa;
+			if (q != 0.0f)
+				roots[root_count++] = qc / q;
+		}
+	}
+	if (root_count == 2 && roots[1] < roots[0])
+		std::swap(roots[0], roots[1]);
+	for (int i = 0; i < root_count; i++)
+		if (roots[i] >= 0.0f && roots[i] <= s_max) {
+			t = t_min + roots[i];
+			return true;
+		}
+	// a root just past the interval by rounding
+	if (f(s_max) <= 0.0f) {
+		t = t_max;
+		return true;
+	}
+	return false;
+}
+
+HeightPyramid::Hit HeightPyramid::raycast(glm::vec3 const& origin, glm::vec3 const& direction, float t_max) const
+{
+	if (levels.empty())
+		return Hit{};
+	glm::vec3 inv_dir = 1.0f / direction;
+
+	struct Entry {
+		int level, x, z;
+		float t_in, t_out;
+	};
+	// at most 3 siblings wait per level
+	Entry stack[3 * 32 + 1];
+	unsigned top = 0;
+	int root = level_count() - 1;
+	float t_in, t_out;
+	if (!slab(cell_box(root, 0, 0), origin, inv_dir, t_max, t_in, t_out))
+		return Hit{};
+	stack[top++] = Entry{ root, 0, 0, t_in, t_out };
+
+	while (top > 0) {
+		Entry e = stack[--top];
+		if (e.level == 0) {
+			// the whole column over the cell: its box is empty for a flat cell, entry and exit would round past the surface
+			BoundingBox column = cell_box(0, e.x, e.z);
+			column.min.y = -std::numeric_limits<float>::max();
+			column.max.y = std::numeric_limits<float>::max();
+			float t;
+			// cells are visited nearest first and do not overlap: the first hit is the nearest
+			if (slab(column, origin, inv_dir, t_max, t_in, t_out) && intersect_cell(e.x, e.z, origin, direction, t_in, t_out, t))
+				return Hit{ true, t, origin + t * direction };
+			continue;
+		}
+		Level const& children = levels[e.level - 1];
+		Entry hit_children[4];
+		unsigned count = 0;
+		for (int dz = 0; dz < 2; dz++)
+			for (int dx = 0; dx < 2; dx++) {
+				int x = 2 * e.x + dx, z = 2 * e.z + dz;
+				if (x < children.cells_x && z < children.cells_z && slab(cell_box(e.level - 1, x, z), origin, inv_dir, t_max, t_in, t_out))
+					hit_children[count++] = Entry{ e.level - 1, x, z, t_in, t_out };
+			}
+		// farthest pushed first, nearest popped next
+		for (unsigned i = 1; i < count; i++)
+			for (unsigned j = i; j > 0 && hit_children[j - 1].t_in < hit_children[j].t_in; j--)
+				std::swap(hit_children[j - 1], hit_children[j]);
+		for (unsigned i = 0; i < count; i++)
+			stack[top++] = hit_children[i];
+	}
+	return Hit{};
+}
+
+void HeightPyramid::raycast(const Ray* rays, Hit* hits, size_t count) const
+{
+	auto cast = [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++)
+			hits[i] = raycast(rays[i].origin, rays[i].direction, rays[i].t_max);
+	};
+
+	size_t hw_threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t chunk_count = std::max<size_t>(1, std::min(hw_threads, count / MIN_RAYS_PER_THREAD));
+	if (chunk_count == 1) {
+		cast(0, count);
+		return;
+	}
+	size_t chunk = (count + chunk_count - 1) / chunk_count;
+	std::vector<std::thread> workers;
+	for (size_t first = chunk; first < count; first += chunk)
+		workers.emplace_back(cast, first, std::min(first + chunk, count));
+	cast(0, std::min(chunk, count));
+	for (auto& w : workers)
+		w.join();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.hpp"
+#include "Heightfield.hpp"
+
+// Min/max mip pyramid over a Heightfield, for ray casts against the terrain (picking, line of sight).
+// Level 0 has one cell per quad of 4 samples, holding the lowest and highest of them (bounds of the
+// bilinear surface in the quad); each further level halves the cells, up to a single root.
+// A ray descends only into cells whose box it passes through, nearest first, and is intersected
+// with the bilinear surface in the level 0 cells it reaches: exact, same surface as Heightfield::height().
+// Only the map itself is hit, nothing beyond its border; rays are expected to start above the ground.
+class HeightPyramid {
+public:
+	struct Ray {
+		glm::vec3 origin{ 0.0f };
+		glm::vec3 direction{ 0.0f, -1.0f, 0.0f };  // need not be normalized, t is in its units
+		float t_max{ std::numeric_limits<float>::max() };
+	};
+
+	struct Hit {
+		bool hit{ false };
+		float t{ std::numeric_limits<float>::max() };
+		glm::vec3 position{ 0.0f };
+	};
+
+	// field must outlive the pyramid (or be followed by another build())
+	void build(Heightfield const& field);
+	void clear(void);
+	bool empty(void) const { return levels.empty(); }
+	int level_count(void) const { return static_cast<int>(levels.size()); }
+
+	// nearest point of the terrain on the ray
+	Hit raycast(glm::vec3 const& origin, glm::vec3 const& direction, float t_max = std::numeric_limits<float>::max()) const;
+	// hits[i] for rays[i]; large batches are split over hardware threads
+	void raycast(const Ray* rays, Hit* hits, size_t count) const;
+	// no terrain between a and b
+	bool line_of_sight(glm::vec3 const& a, glm::vec3 const& b) const { return !raycast(a, b - a, 1.0f).hit; }
+
+private:
+	static constexpr size_t MIN_RAYS_PER_THREAD = 256;
+
+	struct Level {
+		int cells_x{ 0 }, cells_z{ 0 };
+		int cell_size{ 1 };              // in samples
+		std::vector<glm::vec2> range;    // lowest, highest height per cell, rows along x
+	};
+
+	Heightfield const* field{ nullptr };
+	std::vector<Level> levels;           // finest first
+
+	BoundingBox cell_box(int level, int x, int z) const;
+	// first t in [t_min, t_max] where the ray is at or below the bilinear surface of level 0 cell (x, z)
+	bool intersect_cell(int x, int z, glm::vec3 const& origin, glm::vec3 const& direction, float t_min, float t_max, float& t) const;
+};
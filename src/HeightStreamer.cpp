@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "HeightStreamer.hpp"
+
+HeightStreamer::HeightStreamer(const std::filesystem::path& path, size_t max_resident_tiles)
+	: max_resident(std::max<size_t>(max_resident_tiles, 1))
+{
+	if (!sync_file.open(path))
+		throw std::runtime_error("Height tiles missing or invalid: " + path.string());
+	head = sync_file.header();
+	worker = std::thread(&HeightStreamer::worker_loop, this, path);
+}
+
+HeightStreamer::~HeightStreamer()
+{
+	{
+		std::scoped_lock lk(mutex);
+		stopping = true;
+	}
+	cv.notify_all();
+	worker.join();
+}
+
+void HeightStreamer::unpack(std::uint64_t key, int& level, int& tx, int& tz)
+{
+	level = static_cast<int>(key >> 56);
+	tz = static_cast<int>((key >> 28) & 0xFFFFFFF);
+	tx = static_cast<int>(key & 0xFFFFFFF);
+}
+
+void HeightStreamer::begin_frame(void)
+{
+	std::scoped_lock lk(mutex);
+	frame++;
+	queue.erase(std::remove_if(queue.begin(), queue.end(), [this](std::uint64_t k) { return requested_this_frame.count(k) == 0; }), queue.end());
+	queued.clear();
+	queued.insert(queue.begin(), queue.end());
+	requested_this_frame.clear();
+}
+
+std::shared_ptr<const HeightStreamer::Tile> HeightStreamer::tile(int level, int tx, int tz)
+{
+	std::uint64_t k = key(level, tx, tz);
+	std::scoped_lock lk(mutex);
+	auto it = resident.find(k);
+	if (it != resident.end()) {
+		it->second.last_used = frame;
+		return it->second.data;
+	}
+	requested_this_frame.insert(k);
+	if (queued.insert(k).second) {
+		queue.push_back(k);
+		cv.notify_one();
+	}
+	return nullptr;
+}
+
+void HeightStreamer::insert(std::uint64_t key, std::shared_ptr<const Tile> data)
+{
+	auto it = resident.find(key);
+	if (it != resident.end()) {
+		it->second = Entry{ std::move(data), frame };
+		return;
+	}
+	if (resident.size() >= max_resident) {
+		auto oldest = std::min_element(resident.begin(), resident.end(), [](auto const& a, auto const& b) { return a.second.last_used < b.second.last_used; });
+		resident.erase(oldest);  // users still holding it keep their copy alive
+	}
+	resident[key] = Entry{ std::move(data), frame };
+}
+
+void HeightStreamer::worker_loop(std::filesystem::path path)
+{
+	HeightTileFile file(path);
+	const size_t samples = size_t(tile_size()) * tile_size();
+	for (;;) {
+		std::uint64_t k;
+		{
+			std::unique_lock lk(mutex);
+			cv.wait(lk, [this] { return stopping || !queue.empty(); });
+			if (stopping)
+				return;
+			k = queue.back();
+			queue.pop_back();
+			if (resident.count(k)) {
+				queued.erase(k);
+				continue;  // requested again while being read
+			}
+		}
+
+		int level, tx, tz;
+		unpack(k, level, tx, tz);
+		auto data = std::make_shared<Tile>(samples);
+		bool ok = file.read_tile(level, tx, tz, data->data());
+		read_count++;
+
+		std::scoped_lock lk(mutex);
+		queued.erase(k);
+		if (ok)
+			insert(k, std::move(data));
+	}
+}
+
+float HeightStreamer::height(glm::vec2 xz)
+{
+	int w = level_width(0), h = level_height(0), T = tile_size();
+	xz = glm::clamp(xz, glm::vec2(0.0f), glm::vec2(w - 1, h - 1));
+	int x0 = std::min(static_cast<int>(xz.x), std::max(w - 2, 0)), z0 = std::min(static_cast<int>(xz.y), std::max(h - 2, 0));
+
+	auto sample = [&](int x, int z) -> float {
+		x = std::min(x, w - 1);
+		z = std::min(z, h - 1);
+		std::shared_ptr<const Tile> data;
+		{
+			std::scoped_lock lk(mutex);
+			auto it = resident.find(key(0, x / T, z / T));
+			if (it != resident.end()) {
+				it->second.last_used = frame;
+				data = it->second.data;
+			}
+		}
+		if (!data) {
+			auto loaded = std::make_shared<Tile>(size_t(T) * T);
+			if (!sync_file.read_tile(0, x / T, z / T, loaded->data()))
+				return 0.0f;
+			read_count++;
+			std::scoped_lock lk(mutex);
+			insert(key(0, x / T, z / T), loaded);
+			data = loaded;
+		}
+		return (*data)[size_t(z % T) * T + x % T] * (head.height_scale / 65535.0f);
+	};
+
+	float fx = xz.x - x0, fz = xz.y - z0;
+	float bottom = glm::mix(sample(x0, z0), sample(x0 + 1, z0), fx);
+	float top = glm::mix(sample(x0, z0 + 1), sample(x0 + 1, z0 + 1), fx);
+	return glm::mix(bottom, top, fz);
+}
+
+size_t HeightStreamer::resident_tiles(void) const
+{
+	std::scoped_lock lk(mutex);
+	return resident.size();
+}
+
+size_t HeightStreamer::queued_tiles(void) const
+{
+	std::scoped_lock lk(mutex);
+	return queue.size();
+}
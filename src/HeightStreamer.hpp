@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "HeightTiles.hpp"
+
+// Pages tiles of a HeightTileFile in on a background thread, keeping at most max_resident_tiles in memory.
+// tile() never waits: a tile that is not resident is queued and nullptr returned, ask again next frame.
+// begin_frame() drops the requests nobody repeated since, so the queue always holds what is needed now;
+// the newest requests are read first. The least recently used tiles are evicted - max_resident_tiles
+// must hold what one frame needs, or tiles are read again and again.
+// All methods are for one (the main) thread, the streaming thread is internal.
+class HeightStreamer {
+public:
+	using Tile = std::vector<HeightTileFile::Sample>;
+
+	// throws std::runtime_error when the file can not be opened
+	explicit HeightStreamer(const std::filesystem::path& path, size_t max_resident_tiles = 128);
+	~HeightStreamer();
+
+	HeightStreamer(const HeightStreamer&) = delete;
+	HeightStreamer& operator=(const HeightStreamer&) = delete;
+
+	HeightTilesHeader const& header(void) const { return head; }
+	int levels(void) const { return static_cast<int>(head.levels); }
+	int tile_size(void) const { return static_cast<int>(head.tile_size); }
+	int level_width(int level) const { return HeightTileFile::levelSamples(head.width, level); }
+	int level_height(int level) const { return HeightTileFile::levelSamples(head.height, level); }
+
+	void begin_frame(void);
+
+	// resident tile, or nullptr and the tile is queued; tile coordinates must lie inside the level
+	std::shared_ptr<const Tile> tile(int level, int tx, int tz);
+
+	// world height (y) at world x, z: bilinear on level 0, clamped to the map;
+	// a missing tile is read right away, on this thread
+	float height(glm::vec2 xz);
+
+	size_t resident_tiles(void) const;
+	size_t queued_tiles(void) const;
+	size_t resident_bytes(void) const { return resident_tiles() * tile_size() * tile_size() * sizeof(HeightTileFile::Sample); }
+	size_t tiles_read(void) const { return read_count; }
+
+private:
+	struct Entry {
+		std::shared_ptr<const Tile> data;
+		std::uint64_t last_used{ 0 };
+	};
+
+	HeightTilesHeader head{};
+	HeightTileFile sync_file;  // height() misses, main thread
+	const size_t max_resident;
+
+	mutable std::mutex mutex;
+	std::condition_variable cv;
+	std::unordered_map<std::uint64_t, Entry> resident;
+	std::vector<std::uint64_t> queue;  // newest last
+	std::unordered_set<std::uint64_t> queued, requested_this_frame;
+	std::uint64_t frame{ 0 };
+	bool stopping{ false };
+	std::atomic<size_t> read_count{ 0 };
+	std::thread worker;
+
+	static std::uint64_t key(int level, int tx, int tz) { return (std::uint64_t(level) << 56) | (std::uint64_t(std::uint32_t(tz)) << 28) | std::uint32_t(tx); }
+	static void unpack(std::uint64_t key, int& level, int& tx, int& tz);
+
+	void insert(std::uint64_t key, std::shared_ptr<const Tile> data);  // mutex held
+	void worker_loop(std::filesystem::path path);
+};
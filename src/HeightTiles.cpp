@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <utility>
+
+#include <opencv2/opencv.hpp>
+
+#include "HeightTiles.hpp"
+
+namespace {
+	constexpr char HEIGHT_TILES_MAGIC[8] = { 'H', 'T', 'I', 'L', 'E', 'S', '\0', '\0' };
+
+	std::uint32_t hashLattice(int x, int z, std::uint32_t seed)
+	{
+		std::uint32_t h = static_cast<std::uint32_t>(x) * 0x8DA6B343u ^ static_cast<std::uint32_t>(z) * 0xD8163841u ^ seed * 0xCB1AB31Fu;
+		h ^= h >> 13;
+		h *= 0x5BD1E995u;
+		h ^= h >> 15;
+		return h;
+	}
+
+	// smooth value noise, 0..1, one lattice cell per unit
+	float valueNoise(float x, float z, std::uint32_t seed)
+	{
+		float fx = std::floor(x), fz = std::floor(z);
+		int xi = static_cast<int>(fx), zi = static_cast<int>(fz);
+		float u = x - fx, v = z - fz;
+		u = u * u * (3.0f - 2.0f * u);
+		v = v * v * (3.0f - 2.0f * v);
+		auto lattice = [&](int dx, int dz) { return hashLattice(xi + dx, zi + dz, seed) * (1.0f / 4294967295.0f); };
+		float bottom = lattice(0, 0) + (lattice(1, 0) - lattice(0, 0)) * u;
+		float top = lattice(0, 1) + (lattice(1, 1) - lattice(0, 1)) * u;
+		return bottom + (top - bottom) * v;
+	}
+
+	std::uint64_t tileBytes(std::uint32_t tile_size) { return std::uint64_t(tile_size) * tile_size * sizeof(HeightTileFile::Sample); }
+}
+
+float syntheticHeight(int x, int z, std::uint32_t seed)
+{
+	// ridged fractal: 8 octaves from 2048 samples down to 16 per feature
+	float sum = 0.0f, norm = 0.0f, amplitude = 1.0f, frequency = 1.0f / 2048.0f;
+	for (std::uint32_t octave = 0; octave < 8; octave++) {
+		float ridge = 1.0f - std::abs(2.0f * valueNoise(x * frequency, z * frequency, seed + octave) - 1.0f);
+		sum += ridge * ridge * amplitude;
+		norm += amplitude;
+		amplitude *= 0.5f;
+		frequency *= 2.0f;
+	}
+	return sum / norm;
+}
+
+bool HeightTileFile::open(const std::filesystem::path& path)
+{
+	stream.close();
+	stream.open(path, std::ios::binary);
+	if (!stream.is_open())
+		return false;
+
+	stream.read(reinterpret_cast<char*>(&head), sizeof(head));
+	if (!stream.good() || std::memcmp(head.magic, HEIGHT_TILES_MAGIC, sizeof(HEIGHT_TILES_MAGIC)) != 0
+		|| head.version != HEIGHT_TILES_VERSION || head.tile_size == 0 || head.width == 0 || head.height == 0
+		|| head.levels == 0 || head.levels > 32) {
+		stream.close();
+		return false;
+	}
+
+	level_first_tile.clear();
+	std::uint64_t first = 0;
+	for (int level = 0; level < levels(); level++) {
+		level_first_tile.push_back(first);
+		first += std::uint64_t(tiles_x(level)) * tiles_z(level);
+	}
+
+	stream.seekg(0, std::ios::end);
+	if (static_cast<std::uint64_t>(stream.tellg()) < head.data_offset + first * tileBytes(head.tile_size)) {
+		stream.close();
+		return false;  // truncated
+	}
+	return true;
+}
+
+bool HeightTileFile::read_tile(int level, int tx, int tz, Sample* out)
+{
+	if (level < 0 || level >= levels() || tx < 0 || tz < 0 || tx >= tiles_x(level) || tz >= tiles_z(level))
+		return false;
+	std::uint64_t tile = level_first_tile[level] + std::uint64_t(tz) * tiles_x(level) + tx;
+	stream.clear();
+	stream.seekg(head.data_offset + tile * tileBytes(head.tile_size));
+	stream.read(reinterpret_cast<char*>(out), tileBytes(head.tile_size));
+	return stream.good();
+}
+
+bool writeHeightTiles(const std::filesystem::path& path, std::uint32_t width, std::uint32_t height, float height_scale, HeightTileSource const& source, std::uint32_t tile_size)
+{
+	if (width == 0 || height == 0 || tile_size == 0)
+		return false;
+
+	HeightTilesHeader header{};
+	std::memcpy(header.magic, HEIGHT_TILES_MAGIC, sizeof(HEIGHT_TILES_MAGIC));
+	header.version = HEIGHT_TILES_VERSION;
+	header.tile_size = tile_size;
+	header.width = width;
+	header.height = height;
+	header.height_scale = height_scale;
+	header.data_offset = sizeof(HeightTilesHeader);
+	header.levels = 1;
+	while (HeightTileFile::levelSamples(width, header.levels - 1) > static_cast<int>(tile_size) || HeightTileFile::levelSamples(height, header.levels - 1) > static_cast<int>(tile_size))
+		header.levels++;
+
+	auto tiles = [&](std::uint32_t samples, int level) { return static_cast<int>((HeightTileFile::levelSamples(samples, level) + tile_size - 1) / tile_size); };
+	std::vector<std::uint64_t> level_first_tile;
+	std::uint64_t total = 0;
+	for (std::uint32_t level = 0; level < header.levels; level++) {
+		level_first_tile.push_back(total);
+		total += std::uint64_t(tiles(width, level)) * tiles(height, level);
+	}
+	const std::uint64_t TILE_BYTES = tileBytes(tile_size);
+	const int T = static_cast<int>(tile_size);
+
+	// write to temporary file first, so that a crash never leaves a half-written file behind
+	std::filesystem::path tmp_path = path;
+	tmp_path += ".tmp";
+	{
+		std::fstream file(tmp_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		auto tile_offset = [&](int level, int tx, int tz) {
+			return header.data_offset + (level_first_tile[level] + std::uint64_t(tz) * tiles(width, level) + tx) * TILE_BYTES;
+		};
+
+		std::vector<HeightTileFile::Sample> tile(std::size_t(T) * T);
+		for (int tz = 0; tz < tiles(height, 0); tz++)
+			for (int tx = 0; tx < tiles(width, 0); tx++) {
+				source(tx * T, tz * T, T, tile.data());
+				file.seekp(tile_offset(0, tx, tz));
+				file.write(reinterpret_cast<const char*>(tile.data()), TILE_BYTES);
+			}
+		std::cout << "Height tiles: level 0 " << width << "x" << height << " written\n";
+
+		// level + 1 from level: 1-2-1 tent around sample 2i, clamped at the border.
+		// Child tiles are kept for the current row of parent tiles only (up to 4 rows of them).
+		for (int level = 0; level + 1 < static_cast<int>(header.levels); level++) {
+			int child_w = HeightTileFile::levelSamples(width, level), child_h = HeightTileFile::levelSamples(height, level);
+			std::map<std::pair<int, int>, std::vector<HeightTileFile::Sample>> children;  // (tz, tx)
+			auto child_sample = [&](int x, int z) -> int {
+				x = std::clamp(x, 0, child_w - 1);
+				z = std::clamp(z, 0, child_h - 1);
+				auto key = std::make_pair(z / T, x / T);
+				auto it = children.find(key);
+				if (it == children.end()) {
+					std::vector<HeightTileFile::Sample> data(std::size_t(T) * T);
+					file.seekg(tile_offset(level, key.second, key.first));
+					file.read(reinterpret_cast<char*>(data.data()), TILE_BYTES);
+					it = children.emplace(key, std::move(data)).first;
+				}
+				return it->second[std::size_t(z % T) * T + x % T];
+			};
+
+			for (int tz = 0; tz < tiles(height, level + 1); tz++) {
+				// rows of child tiles above this row of parents are done with
+				children.erase(children.begin(), children.lower_bound(std::make_pair((2 * tz * T - 1) / T, 0)));
+				for (int tx = 0; tx < tiles(width, level + 1); tx++) {
+					for (int z = 0; z < T; z++)
+						for (int x = 0; x < T; x++) {
+							int cx = 2 * (tx * T + x), cz = 2 * (tz * T + z);
+							int sum = 0;
+							for (int dz = -1; dz <= 1; dz++)
+								for (int dx = -1; dx <= 1; dx++)
+									sum += child_sample(cx + dx, cz + dz) * (2 - std::abs(dx)) * (2 - std::abs(dz));
+							tile[std::size_t(z) * T + x] = static_cast<HeightTileFile::Sample>((sum + 8) / 16);
+						}
+					file.seekp(tile_offset(level + 1, tx, tz));
+					file.write(reinterpret_cast<const char*>(tile.data()), TILE_BYTES);
+				}
+			}
+		}
+		if (!file.good())
+			return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+	std::filesystem::rename(tmp_path, path, ec);
+	if (ec) {
+		std::filesystem::remove(tmp_path, ec);
+		return false;
+	}
+	std::cout << "Height tiles: " << path.string() << ", " << header.levels << " levels, " << total << " tiles of " << tile_size << "^2\n";
+	return true;
+}
+
+bool generateHeightTiles(const std::filesystem::path& path, std::uint32_t size, std::uint32_t seed, float height_scale)
+{
+	return writeHeightTiles(path, size, size, height_scale, [seed](int x0, int z0, int tile, HeightTileFile::Sample* out) {
+		for (int z = 0; z < tile; z++)
+			for (int x = 0; x < tile; x++)
+				out[std::size_t(z) * tile + x] = static_cast<HeightTileFile::Sample>(syntheticHeight(x0 + x, z0 + z, seed) * 65535.0f + 0.5f);
+	});
+}
+
+bool convertHeightImage(const std::filesystem::path& image_path, const std::filesystem::path& path, float height_scale)
+{
+	cv::Mat image = cv::imread(image_path.string(), cv::IMREAD_ANYDEPTH | cv::IMREAD_GRAYSCALE);
+	if (image.empty()) {
+		std::cerr << "Height tiles: can not read " << image_path.string() << '\n';
+		return false;
+	}
+	// same orientation as the height map of init_hm(): image rows bottom up
+	cv::flip(image, image, 0);
+	if (image.depth() == CV_8U)
+		image.convertTo(image, CV_16U, 257.0);
+	else if (image.depth() != CV_16U)
+		image.convertTo(image, CV_16U);
+
+	return writeHeightTiles(path, image.cols, image.rows, height_scale, [&image](int x0, int z0, int tile, HeightTileFile::Sample* out) {
+		for (int z = 0; z < tile; z++)
+			for (int x = 0; x < tile; x++)
+				out[std::size_t(z) * tile + x] = image.at<std::uint16_t>(std::min(z0 + z, image.rows - 1), std::min(x0 + x, image.cols - 1));
+	});
+}
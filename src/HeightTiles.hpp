@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+// Tiled, mipmapped height field on disk ("*.htiles"), for maps too big to keep in memory.
+//
+// layout: HeightTilesHeader | level 0 tiles | level 1 tiles | ... each level row-major,
+// every tile tile_size x tile_size uint16 samples (rows along x), edge tiles padded.
+// Sample i of level l lies at world x = i * 2^l (1 level 0 sample = 1 world unit), so level l + 1 is
+// level l decimated with a 1-2-1 tent, centered on the even samples. The top level fits in one tile.
+// Value 65535 is height_scale world units high.
+
+constexpr std::uint32_t HEIGHT_TILES_VERSION = 1;
+
+struct HeightTilesHeader {
+	char magic[8];                 // "HTILES\0\0"
+	std::uint32_t version;         // HEIGHT_TILES_VERSION
+	std::uint32_t tile_size;       // samples per tile side
+	std::uint32_t width;           // level 0 samples
+	std::uint32_t height;
+	std::uint32_t levels;
+	float height_scale;
+	std::uint64_t data_offset;     // first tile, from start of file
+};
+
+// Random access to the tiles of one file. Not thread safe: one reader per thread.
+class HeightTileFile {
+public:
+	using Sample = std::uint16_t;
+
+	HeightTileFile(void) = default;
+	explicit HeightTileFile(const std::filesystem::path& path) { open(path); }
+
+	bool open(const std::filesystem::path& path);
+	bool is_open(void) const { return stream.is_open(); }
+
+	HeightTilesHeader const& header(void) const { return head; }
+	int levels(void) const { return static_cast<int>(head.levels); }
+	int tile_size(void) const { return static_cast<int>(head.tile_size); }
+	int level_width(int level) const { return levelSamples(head.width, level); }
+	int level_height(int level) const { return levelSamples(head.height, level); }
+	int tiles_x(int level) const { return (level_width(level) + tile_size() - 1) / tile_size(); }
+	int tiles_z(int level) const { return (level_height(level) + tile_size() - 1) / tile_size(); }
+
+	// tile_size^2 samples into out; false on read error
+	bool read_tile(int level, int tx, int tz, Sample* out);
+
+	// samples of level l covering [0, samples - 1] world units at spacing 2^l
+	static int levelSamples(std::uint32_t samples, int level) { return static_cast<int>(((samples - 1 + (1u << level) - 1) >> level) + 1); }
+
+private:
+	std::ifstream stream;
+	HeightTilesHeader head{};
+	std::vector<std::uint64_t> level_first_tile;
+};
+
+// fills size x size level 0 samples starting at (x0, z0), rows along x; samples beyond the map are not used
+using HeightTileSource = std::function<void(int x0, int z0, int size, HeightTileFile::Sample* out)>;
+
+// write (replace) a tiled file, level 0 from source and the mip levels from the file itself:
+// memory stays at a few rows of tiles whatever the map size
+bool writeHeightTiles(const std::filesystem::path& path, std::uint32_t width, std::uint32_t height, float height_scale, HeightTileSource const& source, std::uint32_t tile_size = 256);
+
+// synthetic ridged fractal terrain of size x size samples, for testing without real data
+bool generateHeightTiles(const std::filesystem::path& path, std::uint32_t size, std::uint32_t seed = 1, float height_scale = 400.0f);
+
+// convert an 8 or 16-bit grayscale image (e.g. a DEM export); the image is read whole, this is an offline tool
+bool convertHeightImage(const std::filesystem::path& image_path, const std::filesystem::path& path, float height_scale);
+
+// height of the synthetic terrain at a level 0 sample, 0..1; generateHeightTiles() stores it scaled to 65535
+float syntheticHeight(int x, int z, std::uint32_t seed);
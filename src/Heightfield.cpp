@@ -0,0 +1,160 @@
+#include <algorithm>
+
+#include <immintrin.h>
+
+#include "CpuFeatures.hpp"
+#include "Heightfield.hpp"
+
+namespace {
+	struct Grid {
+		const float* samples;
+		int stride;
+		float max_x, max_z;  // last sample
+	};
+
+	// handles count rounded down to 8, returns how many
+	AVX2_TARGET size_t heights_avx2(Grid const& g, const float* x, const float* z, float* out, size_t count)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 max_x = _mm256_set1_ps(g.max_x), max_z = _mm256_set1_ps(g.max_z);
+		const __m256i stride = _mm256_set1_epi32(g.stride);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256 px = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(x + i), zero), max_x);
+			__m256 pz = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(z + i), zero), max_z);
+			__m256i x0 = _mm256_cvttps_epi32(px), z0 = _mm256_cvttps_epi32(pz);  // >= 0: truncation is floor
+			__m256 fx = _mm256_sub_ps(px, _mm256_cvtepi32_ps(x0)), fz = _mm256_sub_ps(pz, _mm256_cvtepi32_ps(z0));
+			__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(z0, stride), x0);
+
+			__m256 h00 = _mm256_i32gather_ps(g.samples, index, 4);
+			__m256 h10 = _mm256_i32gather_ps(g.samples + 1, index, 4);
+			__m256 h01 = _mm256_i32gather_ps(g.samples + g.stride, index, 4);
+			__m256 h11 = _mm256_i32gather_ps(g.samples + g.stride + 1, index, 4);
+			__m256 bottom = _mm256_add_ps(h00, _mm256_mul_ps(_mm256_sub_ps(h10, h00), fx));
+			__m256 top = _mm256_add_ps(h01, _mm256_mul_ps(_mm256_sub_ps(h11, h01), fx));
+			_mm256_storeu_ps(out + i, _mm256_add_ps(bottom, _mm256_mul_ps(_mm256_sub_ps(top, bottom), fz)));
+		}
+		return i;
+	}
+
+	// SSE2 has no gather nor 32-bit multiply: indices are computed per lane, the interpolation 4 at a time
+	size_t heights_sse(Grid const& g, const float* x, const float* z, float* out, size_t count)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 max_x = _mm_set1_ps(g.max_x), max_z = _mm_set1_ps(g.max_z);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128 px = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(x + i), zero), max_x);
+			__m128 pz = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(z + i), zero), max_z);
+			__m128i x0 = _mm_cvttps_epi32(px), z0 = _mm_cvttps_epi32(pz);
+			__m128 fx = _mm_sub_ps(px, _mm_cvtepi32_ps(x0)), fz = _mm_sub_ps(pz, _mm_cvtepi32_ps(z0));
+
+			alignas(16) int xs[4], zs[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(xs), x0);
+			_mm_store_si128(reinterpret_cast<__m128i*>(zs), z0);
+			alignas(16) float c00[4], c10[4], c01[4], c11[4];
+			for (int k = 0; k < 4; k++) {
+				const float* p = g.samples + static_cast<size_t>(zs[k]) * g.stride + xs[k];
+				c00[k] = p[0];
+				c10[k] = p[1];
+				c01[k] = p[g.stride];
+				c11[k] = p[g.stride + 1];
+			}
+			__m128 h00 = _mm_load_ps(c00), h10 = _mm_load_ps(c10), h01 = _mm_load_ps(c01), h11 = _mm_load_ps(c11);
+			__m128 bottom = _mm_add_ps(h00, _mm_mul_ps(_mm_sub_ps(h10, h00), fx));
+			__m128 top = _mm_add_ps(h01, _mm_mul_ps(_mm_sub_ps(h11, h01), fx));
+			_mm_storeu_ps(out + i, _mm_add_ps(bottom, _mm_mul_ps(_mm_sub_ps(top, bottom), fz)));
+		}
+		return i;
+	}
+
+	const bool use_avx2 = cpuHasAvx2();
+}
+
+const char* Heightfield::simd_path(void)
+{
+	return use_avx2 ? "AVX2" : "SSE";
+}
+
+void Heightfield::clear(void)
+{
+	size_x = size_z = 0;
+	stride = 0;
+	grid.clear();
+}
+
+void Heightfield::build(const std::uint8_t* samples, int width, int depth, size_t row_stride, float height_scale)
+{
+	clear();
+	if (width < 1 || depth < 1)
+		return;
+	size_x = width;
+	size_z = depth;
+	stride = size_t(width) + 1;
+	grid.resize(stride * (size_t(depth) + 1));
+
+	const float scale = height_scale / 255.0f;
+	for (int z = 0; z <= depth; z++) {
+		const std::uint8_t* row = samples + size_t(std::min(z, depth - 1)) * row_stride;
+		float* out = &grid[size_t(z) * stride];
+		for (int x = 0; x < width; x++)
+			out[x] = row[x] * scale;
+		out[width] = out[width - 1];
+	}
+}
+
+float Heightfield::height(float x, float z) const
+{
+	if (grid.empty())
+		return 0.0f;
+	x = std::clamp(x, 0.0f, static_cast<float>(size_x - 1));
+	z = std::clamp(z, 0.0f, static_cast<float>(size_z - 1));
+	int x0 = static_cast<int>(x), z0 = static_cast<int>(z);
+	float fx = x - x0, fz = z - z0;
+
+	const float* p = &grid[size_t(z0) * stride + x0];
+	float bottom = p[0] + (p[1] - p[0]) * fx;
+	float top = p[stride] + (p[stride + 1] - p[stride]) * fx;
+	return bottom + (top - bottom) * fz;
+}
+
+glm::vec3 Heightfield::snap(glm::vec3 position) const
+{
+	if (grid.empty())
+		return position;
+	position.x = std::clamp(position.x, 0.0f, static_cast<float>(size_x - 1));
+	position.z = std::clamp(position.z, 0.0f, static_cast<float>(size_z - 1));
+	position.y = height(position.x, position.z);
+	return position;
+}
+
+void Heightfield::heights(const float* x, const float* z, float* out, size_t count) const
+{
+	if (grid.empty()) {
+		std::fill(out, out + count, 0.0f);
+		return;
+	}
+	Grid g{ grid.data(), static_cast<int>(stride), static_cast<float>(size_x - 1), static_cast<float>(size_z - 1) };
+	size_t done = use_avx2 ? heights_avx2(g, x, z, out, count) : heights_sse(g, x, z, out, count);
+	for (size_t i = done; i < count; i++)
+		out[i] = height(x[i], z[i]);
+}
+
+void Heightfield::snap(glm::vec3* positions, size_t count) const
+{
+	if (grid.empty())
+		return;
+	// to structure of arrays, in blocks that stay in L1
+	constexpr size_t BLOCK = 256;
+	alignas(32) float xs[BLOCK], zs[BLOCK], ys[BLOCK];
+	for (size_t first = 0; first < count; first += BLOCK) {
+		size_t n = std::min(BLOCK, count - first);
+		for (size_t i = 0; i < n; i++) {
+			xs[i] = std::clamp(positions[first + i].x, 0.0f, static_cast<float>(size_x - 1));
+			zs[i] = std::clamp(positions[first + i].z, 0.0f, static_cast<float>(size_z - 1));
+		}
+		heights(xs, zs, ys, n);
+		for (size_t i = 0; i < n; i++)
+			positions[first + i] = glm::vec3(xs[i], ys[i], zs[i]);
+	}
+}
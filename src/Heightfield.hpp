@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Terrain heights as a float grid, one sample per world unit, for putting things on the ground.
+// height() is one bilinear lookup; heights() answers many queries at once, 8 at a time with AVX2
+// (gathers) when the CPU has it, 4 at a time with SSE otherwise. Positions outside the grid are
+// clamped to its border. The grid has a duplicated last row and column, so no lookup needs a bounds check.
+class Heightfield {
+public:
+	// 8-bit samples, rows along x; value 255 is height_scale world units high (as Terrain::Settings)
+	void build(const std::uint8_t* samples, int width, int depth, size_t row_stride, float height_scale);
+	void clear(void);
+
+	bool empty(void) const { return grid.empty(); }
+	int width(void) const { return size_x; }
+	int depth(void) const { return size_z; }
+
+	float height(float x, float z) const;
+	// sample at integer coordinates inside [0, width] x [0, depth]
+	float sample(int x, int z) const { return grid[size_t(z) * stride + x]; }
+	// position moved into the grid, y on the surface
+	glm::vec3 snap(glm::vec3 position) const;
+
+	// out[i] = height(x[i], z[i])
+	void heights(const float* x, const float* z, float* out, size_t count) const;
+	// snap() for every position
+	void snap(glm::vec3* positions, size_t count) const;
+
+	// "AVX2" or "SSE", chosen once at startup
+	static const char* simd_path(void);
+
+private:
+	int size_x{ 0 }, size_z{ 0 };
+	size_t stride{ 0 };       // size_x + 1
+	std::vector<float> grid;  // (size_x + 1) x (size_z + 1)
+};
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cmath>
+
+#include "HiZPyramid.hpp"
+#include "GLState.hpp"
+
+namespace {
+	// local_size of hiz_copy.comp and hiz_downsample.comp
+	constexpr int GROUP_SIZE = 8;
+
+	GLuint groups(int size)
+	{
+		return static_cast<GLuint>((size + GROUP_SIZE - 1) / GROUP_SIZE);
+	}
+}
+
+HiZPyramid::~HiZPyramid()
+{
+	clear();
+}
+
+void HiZPyramid::clear(void)
+{
+	GLState::get().forget_texture(depth_copy);
+	GLState::get().forget_texture(pyramid);
+	GLuint textures[] = { depth_copy, pyramid };
+	glDeleteTextures(2, textures);
+	depth_copy = pyramid = 0;
+	width = height = level_count = 0;
+	built = false;
+}
+
+void HiZPyramid::init(ShaderProgram& copy_shader, ShaderProgram& downsample_shader)
+{
+	this->copy_shader = &copy_shader;
+	this->downsample_shader = &downsample_shader;
+}
+
+void HiZPyramid::allocate(int width, int height)
+{
+	clear();
+	this->width = width;
+	this->height = height;
+	level_count = 1 + static_cast<int>(std::floor(std::log2(std::max(width, height))));
+
+	// copy target of the default framebuffer's depth, it cannot be sampled directly
+	glCreateTextures(GL_TEXTURE_2D, 1, &depth_copy);
+	glTextureStorage2D(depth_copy, 1, GL_DEPTH_COMPONENT32F, width, height);
+	glTextureParameteri(depth_copy, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(depth_copy, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	// only read by texelFetch, no filtering
+	glCreateTextures(GL_TEXTURE_2D, 1, &pyramid);
+	glTextureStorage2D(pyramid, level_count, GL_R32F, width, height);
+	glTextureParameteri(pyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(pyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(pyramid, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(pyramid, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void HiZPyramid::build(int width, int height, glm::mat4 const& view_projection)
+{
+	if (!copy_shader || width <= 0 || height <= 0) {
+		built = false;
+		return;
+	}
+	if (width != this->width || height != this->height)
+		allocate(width, height);
+
+	glCopyTextureSubImage2D(depth_copy, 0, 0, 0, 0, 0, width, height);
+
+	copy_shader->activate();
+	GLState::get().bind_texture_unit(TEXTURE_UNIT, depth_copy);
+	glBindImageTexture(0, pyramid, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glDispatchCompute(groups(width), groups(height), 1);
+
+	downsample_shader->activate();
+	for (int level = 1; level < level_count; level++) {
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		glBindImageTexture(0, pyramid, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute(groups(std::max(1, width >> level)), groups(std::max(1, height >> level)), 1);
+	}
+	// read with texelFetch by cull_objects.comp
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	built_view_projection = view_projection;
+	built = true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.hpp"
+
+// Hierarchical depth: the default framebuffer's depth buffer and a R32F mip chain where every texel
+// holds the farthest depth of the texels it covers (hiz_copy.comp, hiz_downsample.comp).
+// Built at the end of a frame, used for occlusion tests in the next one together with the matrix
+// it was rendered with - a box is hidden if its nearest depth is behind the farthest one under it.
+class HiZPyramid {
+public:
+	// texture unit of the pyramid (and of the depth copy while building), above IndirectRenderer::MAX_TEXTURES
+	static constexpr GLuint TEXTURE_UNIT = 16;
+
+	HiZPyramid(void) = default;
+	HiZPyramid(HiZPyramid const&) = delete;
+	HiZPyramid& operator=(HiZPyramid const&) = delete;
+	~HiZPyramid();
+
+	// shaders must outlive the pyramid
+	void init(ShaderProgram& copy_shader, ShaderProgram& downsample_shader);
+
+	// after all depth writes of the frame; reallocates when the framebuffer size changes
+	void build(int width, int height, glm::mat4 const& view_projection);
+	// next frame has no usable depth (e.g. the camera jumped)
+	void invalidate(void) { built = false; }
+
+	bool valid(void) const { return built; }
+	GLuint texture(void) const { return pyramid; }
+	int levels(void) const { return level_count; }
+	glm::mat4 const& view_projection(void) const { return built_view_projection; }
+
+	// delete textures, GL context must be current
+	void clear(void);
+
+private:
+	ShaderProgram* copy_shader{ nullptr };
+	ShaderProgram* downsample_shader{ nullptr };
+
+	GLuint depth_copy{ 0 }, pyramid{ 0 };
+	int width{ 0 }, height{ 0 }, level_count{ 0 };
+	bool built{ false };
+	glm::mat4 built_view_projection{ 1.0f };
+
+	void allocate(int width, int height);
+};
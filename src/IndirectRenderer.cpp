@@ -0,0 +1,276 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "IndirectRenderer.hpp"
+#include "GLState.hpp"
+#include "GLBuffers.hpp"
+
+namespace {
+	// local_size_x of cull_objects.comp and compact_draws.comp
+	constexpr size_t CULL_GROUP_SIZE = 64;
+}
+
+IndirectRenderer::~IndirectRenderer()
+{
+	clear();
+}
+
+void IndirectRenderer::clear(void)
+{
+	GLuint buffers[] = { VBO, EBO, command_buffer, record_buffer, cull_buffer, count_buffer, visible_buffer, culled_command_buffer };
+	glDeleteBuffers(8, buffers);
+	GLState::get().forget_vertex_array(VAO);
+	glDeleteVertexArrays(1, &VAO);
+	VAO = VBO = EBO = command_buffer = record_buffer = 0;
+	cull_buffer = count_buffer = visible_buffer = culled_command_buffer = 0;
+	command_capacity = record_capacity = 0;
+	cull_capacity = count_capacity = visible_capacity = culled_command_capacity = 0;
+	meshes.clear();
+	groups.clear();
+	commands.clear();
+	records.clear();
+	cull_objects.clear();
+	group_record_count = 0;
+}
+
+void IndirectRenderer::build(ShaderProgram& shader, std::vector<Mesh*> const& meshes, std::vector<InstancedMesh*> const& groups)
+{
+	clear();
+	this->shader = &shader;
+	this->meshes = meshes;
+	this->groups = groups;
+	ranges.clear();
+	textures.clear();
+	group_revisions.assign(groups.size(), ~size_t(0));  // force first upload
+
+	// unique geometries, in order of first use
+	std::vector<MeshGeometry const*> geometries;
+	auto add_geometry = [&](MeshGeometry const* geometry, GLenum primitive_type) {
+		if (!geometry)
+			throw std::runtime_error("IndirectRenderer: mesh without geometry");
+		if (primitive_type != GL_TRIANGLES)
+			throw std::runtime_error("IndirectRenderer: only GL_TRIANGLES meshes can be merged");
+		if (ranges.count(geometry))
+			return;
+		if (!geometries.empty() && geometry->quantized != geometries.front()->quantized)
+			throw std::runtime_error("IndirectRenderer: all meshes must use the same vertex format");
+		ranges[geometry] = Range{};
+		geometries.push_back(geometry);
+	};
+	for (Mesh* m : meshes)
+		add_geometry(m->geometry.get(), m->primitive_type);
+	for (InstancedMesh* g : groups)
+		add_geometry(g->geometry.get(), g->primitive_type);
+
+	if (geometries.empty())
+		return;
+
+	bool quantized = geometries.front()->quantized;
+	size_t stride = geometries.front()->vertex_stride();
+
+	size_t vertex_total = 0, index_total = 0;
+	for (MeshGeometry const* geometry : geometries) {
+		ranges[geometry] = Range{ static_cast<GLuint>(index_total), static_cast<GLint>(vertex_total) };
+		vertex_total += geometry->vertex_count;
+		index_total += geometry->index_count;
+	}
+
+	// merge on the GPU, no CPU-side copy of the geometry exists any more
+	glCreateBuffers(1, &VBO);
+	glCreateBuffers(1, &EBO);
+	glNamedBufferStorage(VBO, vertex_total * stride, nullptr, 0);
+	glNamedBufferStorage(EBO, index_total * sizeof(GLuint), nullptr, 0);
+	for (MeshGeometry const* geometry : geometries) {
+		Range const& range = ranges[geometry];
+		glCopyNamedBufferSubData(geometry->vbo(), VBO, 0, range.base_vertex * stride, geometry->vertex_count * stride);
+		glCopyNamedBufferSubData(geometry->ebo(), EBO, 0, range.first_index * sizeof(GLuint), geometry->index_count * sizeof(GLuint));
+	}
+
+	glCreateVertexArrays(1, &VAO);
+	MeshGeometry::setup_vertex_format(VAO, shader.getID(), quantized);
+	glVertexArrayVertexBuffer(VAO, 0, VBO, 0, static_cast<GLsizei>(stride));
+	glVertexArrayElementBuffer(VAO, EBO);
+
+	glCreateBuffers(1, &command_buffer);
+	glCreateBuffers(1, &record_buffer);
+	glCreateBuffers(1, &cull_buffer);
+	glCreateBuffers(1, &count_buffer);
+	glCreateBuffers(1, &visible_buffer);
+	glCreateBuffers(1, &culled_command_buffer);
+
+	TextureSlots::setup_samplers(shader);
+	gpu_culled_location = shader.getUniformLocation("gpu_culled");
+
+	std::cout << "IndirectRenderer: " << meshes.size() << " meshes, " << groups.size() << " instanced groups, "
+		<< geometries.size() << " geometries merged into " << (vertex_total * stride + index_total * sizeof(GLuint)) / 1024 << " KiB\n";
+}
+
+IndirectRenderer::DrawRecord IndirectRenderer::make_record(MeshGeometry const& geometry, glm::mat4 const& model, glm::vec4 const& diffuse_color, GLuint texture_id)
+{
+	return DrawRecord{ model, diffuse_color, geometry.quantization.scale, textures.slot(texture_id), geometry.quantization.offset, geometry.quantized ? 1 : 0 };
+}
+
+IndirectRenderer::DrawElementsIndirectCommand IndirectRenderer::make_command(MeshGeometry const& geometry, unsigned lod_level, GLuint instance_count, GLuint base_instance) const
+{
+	Range const& range = ranges.at(&geometry);
+	MeshLod const& lod = geometry.lod(lod_level);
+	return DrawElementsIndirectCommand{ lod.index_count, instance_count, range.first_index + lod.index_offset, range.base_vertex, base_instance };
+}
+
+void IndirectRenderer::update(glm::vec3 const& camera_pos, glm::mat4 const& projection, float viewport_height, bool use_visible)
+{
+	commands.clear();
+
+	// groups: records change only with the instances
+	bool groups_changed = false;
+	for (size_t g = 0; g < groups.size(); g++)
+		groups_changed |= group_revisions[g] != groups[g]->revision();
+
+	if (groups_changed) {
+		records.clear();
+		cull_objects.clear();
+		GLuint group_draw = 0;  // command of the group when none is culled
+		for (size_t g = 0; g < groups.size(); g++) {
+			InstancedMesh const& group = *groups[g];
+			for (size_t i = 0; i < group.count(); i++) {
+				InstancedMesh::Instance const& instance = group.instance(i);
+				glm::mat4 model = Mesh::compute_model_matrix(instance.origin, instance.orientation, instance.size);
+				records.push_back(make_record(*group.geometry, model, instance.diffuse_color, group.texture ? group.texture->id : 0));
+				BoundingBox box = group.geometry->bounds.transformed(model);
+				cull_objects.push_back(CullObject{ box.min, group_draw, box.max, 0 });
+			}
+			if (group.count() > 0)
+				group_draw++;
+			group_revisions[g] = group.revision();
+		}
+		group_record_count = records.size();
+	}
+	records.resize(group_record_count);
+	cull_objects.resize(group_record_count);
+
+	GLuint base_instance = 0;
+	for (InstancedMesh* group : groups) {
+		if (group->count() > 0 && (group->visible || !use_visible))
+			commands.push_back(make_command(*group->geometry, group->lod_level, static_cast<GLuint>(group->count()), base_instance));
+		base_instance += static_cast<GLuint>(group->count());
+	}
+
+	// meshes: may move, LOD depends on the camera
+	for (Mesh* mesh : meshes) {
+		if (!mesh->visible && use_visible)
+			continue;
+		mesh->select_lod(camera_pos, projection, viewport_height);
+		mesh->model_matrix = Mesh::compute_model_matrix(mesh->origin, mesh->orientation, mesh->size);
+		cull_objects.push_back(CullObject{ mesh->world_bounds.min, static_cast<GLuint>(commands.size()), mesh->world_bounds.max, 0 });
+		commands.push_back(make_command(*mesh->geometry, mesh->lod_level, 1, static_cast<GLuint>(records.size())));
+		records.push_back(make_record(*mesh->geometry, mesh->model_matrix, mesh->diffuse_color, mesh->texture_id));
+	}
+
+	// upload: groups part only when changed
+	size_t first = groups_changed ? 0 : group_record_count;
+	uploadGrowing(record_buffer, record_capacity, records, first);
+	uploadGrowing(command_buffer, command_capacity, commands);
+	if (!use_visible)
+		uploadGrowing(cull_buffer, cull_capacity, cull_objects, first);
+	else if (groups_changed)
+		cull_capacity = 0;  // group part is stale on the GPU, next upload must grow (= write all)
+}
+
+void IndirectRenderer::bind(bool gpu_culled)
+{
+	shader->activate();
+	shader->setUniform(gpu_culled_location, gpu_culled ? 1 : 0);
+	textures.bind();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, record_buffer);
+	GLState::get().bind_vertex_array(VAO);
+}
+
+void IndirectRenderer::draw(glm::vec3 const& camera_pos, glm::mat4 const& projection, float viewport_height)
+{
+	if (VAO == 0)
+		return;
+
+	update(camera_pos, projection, viewport_height, true);
+
+	bind(false);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(commands.size()), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void IndirectRenderer::init_gpu_culling(ShaderProgram& cull_shader, ShaderProgram& compact_shader)
+{
+	this->cull_shader = &cull_shader;
+	this->compact_shader = &compact_shader;
+	indirect_count = GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters;
+	for (int i = 0; i < 6; i++)
+		plane_locations[i] = cull_shader.getUniformLocation("planes[" + std::to_string(i) + "]");
+	hiz_view_projection_location = cull_shader.getUniformLocation("hiz_view_projection");
+	object_count_location = cull_shader.getUniformLocation("object_count");
+	use_hiz_location = cull_shader.getUniformLocation("use_hiz");
+	draw_total_location = compact_shader.getUniformLocation("draw_total");
+	compact_location = compact_shader.getUniformLocation("compact");
+	std::cout << "IndirectRenderer: GPU culling, " << (indirect_count ? "draw count from the GPU" : "no indirect count, empty draws are submitted") << '\n';
+}
+
+void IndirectRenderer::draw_gpu_culled(glm::vec3 const& camera_pos, glm::mat4 const& projection, glm::mat4 const& view_projection,
+	float viewport_height, HiZPyramid const& hiz)
+{
+	if (VAO == 0)
+		return;
+	if (!cull_shader) {
+		draw(camera_pos, projection, viewport_height);
+		return;
+	}
+
+	// all objects, commands are templates: instanceCount = most visible, baseInstance = first slot in visible_buffer
+	update(camera_pos, projection, viewport_height, false);
+	if (commands.empty())
+		return;
+
+	GLuint draw_total = static_cast<GLuint>(commands.size());
+	reserveGrowing(count_buffer, count_capacity, 1 + commands.size(), sizeof(GLuint));
+	reserveGrowing(visible_buffer, visible_capacity, records.size(), sizeof(GLuint));
+	reserveGrowing(culled_command_buffer, culled_command_capacity, commands.size(), sizeof(DrawElementsIndirectCommand));
+	GLuint zero = 0;
+	glClearNamedBufferSubData(count_buffer, GL_R32UI, 0, (1 + commands.size()) * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visible_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cull_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, command_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, count_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, culled_command_buffer);
+
+	Frustum frustum = Frustum::from_matrix(view_projection);
+	cull_shader->activate();
+	for (int i = 0; i < 6; i++)
+		cull_shader->setUniform(plane_locations[i], frustum.planes[i]);
+	cull_shader->setUniform(hiz_view_projection_location, hiz.view_projection());
+	cull_shader->setUniform(object_count_location, static_cast<int>(records.size()));
+	cull_shader->setUniform(use_hiz_location, hiz.valid() ? 1 : 0);
+	if (hiz.valid())
+		GLState::get().bind_texture_unit(HiZPyramid::TEXTURE_UNIT, hiz.texture());
+	glDispatchCompute(static_cast<GLuint>((records.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	compact_shader->activate();
+	compact_shader->setUniform(draw_total_location, static_cast<int>(draw_total));
+	compact_shader->setUniform(compact_location, indirect_count ? 1 : 0);
+	glDispatchCompute((draw_total + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	bind(true);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culled_command_buffer);
+	if (indirect_count) {
+		glBindBuffer(GL_PARAMETER_BUFFER, count_buffer);
+		if (GLEW_VERSION_4_6)
+			glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, static_cast<GLsizei>(draw_total), 0);
+		else
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, static_cast<GLsizei>(draw_total), 0);
+		glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	}
+	else
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(draw_total), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
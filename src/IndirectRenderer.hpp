@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "InstancedMesh.h"
+#include "GLBuffers.hpp"
+#include "ShaderProgram.hpp"
+#include "HiZPyramid.hpp"
+
+// Draws a set of meshes and instanced groups with one glMultiDrawElementsIndirect.
+// build() copies the geometry of all of them (on the GPU) into one VBO + EBO, every frame draw()
+// selects LODs, writes one DrawElementsIndirectCommand per mesh/group and one record per object
+// (model matrix, color, texture index, dequantization) into a SSBO read as records[gl_BaseInstance + gl_InstanceID],
+// see tex_indirect.vert. Meshes are referenced, not owned: build() again when the set changes.
+// Meshes and groups with visible == false get no command.
+//
+// draw_gpu_culled() ignores visible and culls every mesh and instance on the GPU instead (cull_objects.comp:
+// frustum + Hi-Z occlusion), compact_draws.comp then writes the commands of what is left and their count.
+// The CPU cost does not depend on what is visible: two dispatches and one glMultiDrawElementsIndirectCount
+// (plain glMultiDrawElementsIndirect with empty commands where GL_ARB_indirect_parameters is missing).
+class IndirectRenderer {
+public:
+	// sampler array size in tex_indirect.frag
+	static constexpr size_t MAX_TEXTURES = TextureSlots::MAX_TEXTURES;
+
+	// GL layout, see glMultiDrawElementsIndirect
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// std430 layout of DrawRecord in tex_indirect.vert
+	struct DrawRecord {
+		glm::mat4 model;
+		glm::vec4 diffuse_color;
+		glm::vec3 pos_scale;
+		GLint texture_index;
+		glm::vec3 pos_offset;
+		GLint quantized;
+	};
+	static_assert(sizeof(DrawRecord) == 112, "DrawRecord must match std430 layout in tex_indirect.vert");
+	static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand is 5 packed uints");
+
+	// std430 layout of CullObject in cull_objects.comp, one per record
+	struct CullObject {
+		glm::vec3 aabb_min;
+		GLuint draw;  // command index
+		glm::vec3 aabb_max;
+		GLuint pad;
+	};
+	static_assert(sizeof(CullObject) == 32, "CullObject must match std430 layout in cull_objects.comp");
+
+	IndirectRenderer(void) = default;
+	IndirectRenderer(IndirectRenderer const&) = delete;
+	IndirectRenderer& operator=(IndirectRenderer const&) = delete;
+	~IndirectRenderer();
+
+	// all geometry must be GL_TRIANGLES with the same vertex format (quantized or not), throws std::runtime_error otherwise
+	void build(ShaderProgram& shader, std::vector<Mesh*> const& meshes, std::vector<InstancedMesh*> const& groups);
+
+	void draw(glm::vec3 const& camera_pos, glm::mat4 const& projection, float viewport_height);
+
+	// compute shaders for draw_gpu_culled(), must outlive the renderer
+	void init_gpu_culling(ShaderProgram& cull_shader, ShaderProgram& compact_shader);
+	bool gpu_culling_available(void) const { return cull_shader != nullptr; }
+	bool indirect_count_available(void) const { return indirect_count; }
+
+	// occlusion is tested only when hiz is valid; world bounds of the meshes must be up to date
+	void draw_gpu_culled(glm::vec3 const& camera_pos, glm::mat4 const& projection, glm::mat4 const& view_projection,
+		float viewport_height, HiZPyramid const& hiz);
+
+	// commands before culling with draw_gpu_culled()
+	size_t draw_count(void) const { return commands.size(); }
+	size_t object_count(void) const { return records.size(); }
+
+	// delete GL buffers and forget the meshes, GL context must be current
+	void clear(void);
+
+private:
+	struct Range {
+		GLuint first_index;  // of LOD 0 in the merged EBO
+		GLint base_vertex;
+	};
+
+	ShaderProgram* shader{ nullptr };
+	GLint gpu_culled_location{ -1 };
+	std::vector<Mesh*> meshes;
+	std::vector<InstancedMesh*> groups;
+
+	std::unordered_map<MeshGeometry const*, Range> ranges;
+	TextureSlots textures{ "IndirectRenderer" };
+
+	// records of groups first (re-uploaded only when a group changes), then one per mesh (every frame)
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<DrawRecord> records;
+	std::vector<CullObject> cull_objects;  // parallel to records, same update scheme
+	std::vector<size_t> group_revisions;
+	size_t group_record_count{ 0 };
+
+	GLuint VAO{ 0 }, VBO{ 0 }, EBO{ 0 };
+	GLuint command_buffer{ 0 }, record_buffer{ 0 };
+	size_t command_capacity{ 0 }, record_capacity{ 0 };
+
+	// GPU culling: objects, per command instance counts (after the total draw count), record index per visible slot, output commands
+	ShaderProgram* cull_shader{ nullptr };
+	ShaderProgram* compact_shader{ nullptr };
+	// uniform locations of both, resolved in init_gpu_culling()
+	GLint plane_locations[6]{ -1, -1, -1, -1, -1, -1 };
+	GLint hiz_view_projection_location{ -1 }, object_count_location{ -1 }, use_hiz_location{ -1 };
+	GLint draw_total_location{ -1 }, compact_location{ -1 };
+	bool indirect_count{ false };
+	GLuint cull_buffer{ 0 }, count_buffer{ 0 }, visible_buffer{ 0 }, culled_command_buffer{ 0 };
+	size_t cull_capacity{ 0 }, count_capacity{ 0 }, visible_capacity{ 0 }, culled_command_capacity{ 0 };
+
+	// records, cull objects and commands of this frame, uploaded; use_visible: leave out meshes and groups with visible == false
+	void update(glm::vec3 const& camera_pos, glm::mat4 const& projection, float viewport_height, bool use_visible);
+	void bind(bool gpu_culled);
+
+	DrawRecord make_record(MeshGeometry const& geometry, glm::mat4 const& model, glm::vec4 const& diffuse_color, GLuint texture_id);
+	DrawElementsIndirectCommand make_command(MeshGeometry const& geometry, unsigned lod_level, GLuint instance_count, GLuint base_instance) const;
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "Mesh.h"
+#include "MeshGeometry.h"
+#include "Bounds.hpp"
+#include "Texture.h"
+#include "ShaderProgram.hpp"
+#include "GLState.hpp"
+#include "UniformBlocks.hpp"
+#include "UniformRing.hpp"
+
+// Many copies of one geometry + texture, drawn with a single glDrawElementsInstanced.
+// Per-instance transform and color live in a SSBO (binding 0, see tex_instanced.vert).
+class InstancedMesh {
+public:
+    // std430 layout of one instance in the SSBO
+    struct InstanceData {
+        glm::mat4 model;
+        glm::vec4 diffuse_color;
+    };
+    static_assert(sizeof(InstanceData) == 80, "InstanceData must match std430 layout of Instance in shader");
+
+    struct Instance {
+        glm::vec3 origin{};
+        glm::vec3 orientation{};
+        glm::vec3 size{ 1.0f };
+        glm::vec4 diffuse_color{ 1.0f };
+    };
+
+    GLenum primitive_type = GL_POINT;
+    ShaderProgram& shader;
+
+    std::shared_ptr<MeshGeometry> geometry;
+    std::shared_ptr<Texture> texture;
+
+    bool transparent = false;
+    unsigned lod_level = 0;
+
+    bool visible = true;  // result of the last frustum culling of world_bounds()
+
+    InstancedMesh(GLenum primitive_type, ShaderProgram& shader, std::shared_ptr<MeshGeometry> geometry, std::shared_ptr<Texture> texture = nullptr) :
+        primitive_type(primitive_type),
+        shader(shader),
+        geometry(std::move(geometry)),
+        texture(std::move(texture))
+    {
+        glCreateBuffers(1, &SSBO);
+    }
+
+    InstancedMesh(InstancedMesh const&) = delete;
+    InstancedMesh& operator=(InstancedMesh const&) = delete;
+
+    InstancedMesh(InstancedMesh&& other) noexcept :
+        primitive_type(other.primitive_type),
+        shader(other.shader),
+        geometry(std::move(other.geometry)),
+        texture(std::move(other.texture)),
+        transparent(other.transparent),
+        lod_level(other.lod_level),
+        visible(other.visible),
+        instances(std::move(other.instances)),
+        dirty(other.dirty),
+        revision_counter(other.revision_counter),
+        bounds(other.bounds),
+        bounds_revision(other.bounds_revision),
+        SSBO(other.SSBO),
+        capacity(other.capacity)
+    {
+        other.SSBO = 0;
+        other.capacity = 0;
+    }
+
+    ~InstancedMesh() {
+        glDeleteBuffers(1, &SSBO);
+    }
+
+    size_t add(Instance const& instance) {
+        instances.push_back(instance);
+        dirty = true;
+        revision_counter++;
+        return instances.size() - 1;
+    }
+
+    // modify instances through this, so that the SSBO is updated before the next draw
+    Instance& instance(size_t i) {
+        dirty = true;
+        revision_counter++;
+        return instances[i];
+    }
+    Instance const& instance(size_t i) const { return instances[i]; }
+    size_t count(void) const { return instances.size(); }
+    // changes with every (possible) modification of instances, for caches of instance data elsewhere
+    size_t revision(void) const { return revision_counter; }
+
+    // box around all instances, recomputed only after instances changed
+    BoundingBox const& world_bounds(void) {
+        if (bounds_revision != revision_counter) {
+            bounds = instances.empty() ? BoundingBox{} : BoundingBox::empty();
+            if (geometry)
+                for (Instance const& i : instances)
+                    bounds.merge(geometry->bounds.transformed(Mesh::compute_model_matrix(i.origin, i.orientation, i.size)));
+            bounds_revision = revision_counter;
+        }
+        return bounds;
+    }
+
+    // painter's algorithm inside the group: instances are rasterized in order (indices of instances change).
+    // One squared distance per instance; nothing changes (no upload) while the order holds.
+    void sort_back_to_front(glm::vec3 const& camera_pos) {
+        std::vector<std::pair<float, size_t>> order(instances.size());
+        for (size_t i = 0; i < instances.size(); i++) {
+            glm::vec3 d = instances[i].origin - camera_pos;
+            order[i] = { -glm::dot(d, d), i };  // farthest first, equal ones keep their order
+        }
+        if (std::is_sorted(order.begin(), order.end()))
+            return;
+        std::sort(order.begin(), order.end());
+
+        std::vector<Instance> sorted;
+        sorted.reserve(instances.size());
+        for (auto const& o : order)
+            sorted.push_back(instances[o.second]);
+        instances.swap(sorted);
+        dirty = true;
+        revision_counter++;
+    }
+
+    // dequantization goes to ObjectData block (binding 1) through the ring, FrameData must be bound already
+    void draw(UniformRing& object_data) {
+        if (!geometry || geometry->vao() == 0) {
+            std::cerr << "VAO not initialized!\n";
+            return;
+        }
+        if (instances.empty())
+            return;
+
+        if (dirty)
+            upload();
+
+        shader.activate();
+
+        object_data.bind(OBJECT_DATA_BINDING, ObjectData{ glm::mat4(1.0f), glm::vec4(1.0f),
+            geometry->quantization.scale, geometry->quantized ? 1 : 0, geometry->quantization.offset, 0.0f });
+
+        GLState::get().bind_texture_unit(0, texture ? texture->id : 0); // tex0 samples unit 0
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, SSBO);
+        GLState::get().bind_vertex_array(geometry->vao());
+        MeshLod const& lod = geometry->lod(lod_level);
+        glDrawElementsInstanced(primitive_type, lod.index_count, GL_UNSIGNED_INT, reinterpret_cast<const void*>(lod.index_offset * sizeof(GLuint)), static_cast<GLsizei>(instances.size()));
+    }
+
+private:
+    std::vector<Instance> instances;
+    bool dirty = true;
+    size_t revision_counter{0};
+
+    BoundingBox bounds;
+    size_t bounds_revision{~size_t(0)};
+
+    GLuint SSBO{0};
+    size_t capacity{0}; // instances the SSBO can hold
+
+    void upload(void) {
+        std::vector<InstanceData> data;
+        data.reserve(instances.size());
+        for (Instance const& i : instances)
+            data.push_back({ Mesh::compute_model_matrix(i.origin, i.orientation, i.size), i.diffuse_color });
+
+        if (data.size() > capacity) {
+            capacity = data.size();
+            glNamedBufferData(SSBO, capacity * sizeof(InstanceData), data.data(), GL_DYNAMIC_DRAW);
+        }
+        else
+            glNamedBufferSubData(SSBO, 0, data.size() * sizeof(InstanceData), data.data());
+        dirty = false;
+    }
+};
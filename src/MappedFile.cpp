@@ -0,0 +1,139 @@
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.hpp"
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+	open(path);
+}
+
+MappedFile::~MappedFile(void)
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	swap(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other) {
+		close();
+		swap(other);
+	}
+	return *this;
+}
+
+void MappedFile::swap(MappedFile& other) noexcept
+{
+	std::swap(view, other.view);
+	std::swap(length, other.length);
+	std::swap(opened, other.opened);
+#ifdef _WIN32
+	std::swap(file_handle, other.file_handle);
+	std::swap(mapping_handle, other.mapping_handle);
+#endif
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::filesystem::path& path)
+{
+	close();
+
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		return false;
+	}
+	file_handle = file;
+	length = static_cast<size_t>(file_size.QuadPart);
+	opened = true;
+
+	if (length == 0) // empty file can not be mapped, but it is still a valid (empty) file
+		return true;
+
+	mapping_handle = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping_handle == NULL) {
+		close();
+		return false;
+	}
+	view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close(void)
+{
+	if (view)
+		UnmapViewOfFile(view);
+	if (mapping_handle)
+		CloseHandle(mapping_handle);
+	if (file_handle)
+		CloseHandle(file_handle);
+	view = nullptr;
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+	length = 0;
+	opened = false;
+}
+
+#else
+
+bool MappedFile::open(const std::filesystem::path& path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	length = static_cast<size_t>(st.st_size);
+	opened = true;
+
+	if (length > 0) {
+		void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			::close(fd);
+			close();
+			return false;
+		}
+		view = p;
+	}
+	::close(fd); // mapping stays valid after the descriptor is closed
+	return true;
+}
+
+void MappedFile::close(void)
+{
+	if (view)
+		munmap(view, length);
+	view = nullptr;
+	length = 0;
+	opened = false;
+}
+
+#endif
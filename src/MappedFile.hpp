@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+// Read-only memory mapping of a whole file.
+// The mapping lives as long as the object; move-only.
+class MappedFile {
+public:
+	MappedFile(void) = default;
+	explicit MappedFile(const std::filesystem::path& path);
+	~MappedFile(void);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	bool open(const std::filesystem::path& path);
+	void close(void);
+
+	bool is_open(void) const { return opened; }
+	const char* data(void) const { return static_cast<const char*>(view); }
+	size_t size(void) const { return length; }
+
+private:
+	void* view{ nullptr };
+	size_t length{ 0 };
+	bool opened{ false };
+#ifdef _WIN32
+	void* file_handle{ nullptr };
+	void* mapping_handle{ nullptr };
+#endif
+	void swap(MappedFile& other) noexcept;
+};
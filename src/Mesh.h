@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -7,7 +9,14 @@
 #include <glm/ext.hpp>
 
 #include "Vertex.h"
+#include "MeshCache.hpp"
+#include "MeshGeometry.h"
+#include "Bounds.hpp"
+#include "Texture.h"
 #include "ShaderProgram.hpp"
+#include "GLState.hpp"
+#include "UniformBlocks.hpp"
+#include "UniformRing.hpp"
 
 class Mesh {
 public:
@@ -27,85 +36,130 @@ public:
 
     bool transparent = false;
 
-    // indirect (indexed) draw 
-    Mesh(GLenum primitive_type, ShaderProgram& shader, std::vector<Vertex> const& vertices, std::vector<GLuint> const& indices, glm::vec3 const& origin, glm::vec3 const& orientation, glm::vec3 const& size, GLuint const texture_id = 0) :
+    // level of detail: coarsest level whose projected error stays below this many pixels
+    float lod_pixel_error = 1.0f;
+    unsigned lod_level = 0;
+
+    // GPU buffers and textures, possibly shared with other meshes (see ResourceRegistry)
+    std::shared_ptr<MeshGeometry> geometry;
+    std::shared_ptr<Texture> texture;
+
+    // world space, follow origin/orientation/size after update_bounds()
+    BoundingBox world_bounds;
+    BoundingSphere world_sphere;
+    bool visible = true;  // result of the last frustum culling
+    bool dynamic = false; // moves every frame: refitted instead of rebuilt spatial index (see App::init_bvh)
+
+    // indexed draw of shared geometry
+    Mesh(GLenum primitive_type, ShaderProgram& shader, std::shared_ptr<MeshGeometry> geometry, glm::vec3 const& origin, glm::vec3 const& orientation, glm::vec3 const& size, std::shared_ptr<Texture> texture = nullptr) :
         primitive_type(primitive_type),
         shader(shader),
-        vertices(vertices),
-        indices(indices),
+        geometry(std::move(geometry)),
+        origin(origin),
+        orientation(orientation),
+        size(size)
+    {
+        set_texture(std::move(texture));
+        update_bounds();
+    }
+
+    // indirect (indexed) draw, uploads its own copy of the geometry
+    // vertices and indices are not kept after upload, unless keep_cpu_data is set (see MeshGeometry)
+    Mesh(GLenum primitive_type, ShaderProgram& shader, std::vector<Vertex> const& vertices, std::vector<GLuint> const& indices, glm::vec3 const& origin, glm::vec3 const& orientation, glm::vec3 const& size, GLuint const texture_id = 0, bool const quantized = false, bool const keep_cpu_data = false) :
+        primitive_type(primitive_type),
+        shader(shader),
+        geometry(std::make_shared<MeshGeometry>(shader, vertices, indices, quantized, keep_cpu_data)),
         origin(origin),
         orientation(orientation),
         texture_id(texture_id),
         size(size)
     {
-        GLuint prog_h = shader.getID();
-        glCreateVertexArrays(1, &VAO);
-
-        // Set Vertex Attribute to explain OpenGL how to interpret the data
-        GLint position_attrib_location = glGetAttribLocation(prog_h, "aPos");
-        if (position_attrib_location == -1)
-            std::cerr << "Position of 'aPos' not found" << std::endl;
-        else {
-            glVertexArrayAttribFormat(VAO, position_attrib_location, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position));
-            glVertexArrayAttribBinding(VAO, position_attrib_location, 0);
-            glEnableVertexArrayAttrib(VAO, position_attrib_location);
-        }
-        // Set end enable Vertex Attribute for Normal
-        GLint normal_attrib_location = glGetAttribLocation(prog_h, "aNorm");
-        if (normal_attrib_location == -1)
-            std::cerr << "Position of 'aNorm' not found" << std::endl;
-        else {
-            glVertexArrayAttribFormat(VAO, normal_attrib_location, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal));
-            glVertexArrayAttribBinding(VAO, normal_attrib_location, 0);
-            glEnableVertexArrayAttrib(VAO, normal_attrib_location);
-        }
-        // Set end enable Vertex Attribute for Texture Coordinates
-        GLint tex_attrib_location = glGetAttribLocation(prog_h, "aTex");
-        if (tex_attrib_location == -1)
-            std::cerr << "Position of 'aTex' not found" << std::endl;
-        else {
-            glVertexArrayAttribFormat(VAO, tex_attrib_location, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords));
-            glVertexArrayAttribBinding(VAO, tex_attrib_location, 0);
-            glEnableVertexArrayAttrib(VAO, tex_attrib_location);
-        }
-        
-        // Create and fill data
-        glCreateBuffers(1, &VBO); // Vertex Buffer Object
-        glCreateBuffers(1, &EBO); // Element Buffer Object
-        glNamedBufferData(VBO, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-        glNamedBufferData(EBO, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
-        //Connect together
-        glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(Vertex));
-        glVertexArrayElementBuffer(VAO, EBO);
+        update_bounds();
     }
 
+    // indirect (indexed) draw straight from mapped mesh data, no CPU-side copy is kept
+    Mesh(GLenum primitive_type, ShaderProgram& shader, MeshData const& data, glm::vec3 const& origin, glm::vec3 const& orientation, glm::vec3 const& size, GLuint const texture_id = 0, bool const quantized = false, bool const keep_cpu_data = false) :
+        primitive_type(primitive_type),
+        shader(shader),
+        geometry(std::make_shared<MeshGeometry>(shader, data, quantized, keep_cpu_data)),
+        origin(origin),
+        orientation(orientation),
+        texture_id(texture_id),
+        size(size)
+    {
+        update_bounds();
+    }
 
-    
-    void draw() {
- 		if (VAO == 0) {
-			std::cerr << "VAO not initialized!\n";
-			return;
-		}
-        shader.activate();
+    // move-only: a copy would be a second owner of the same scene object, share geometry through the registry instead
+    Mesh(Mesh const&) = delete;
+    Mesh& operator=(Mesh const&) = delete;
+    Mesh(Mesh&&) = default;
 
-        // compute complete transformation
+    // complete transformation, orientation in degrees
+    static glm::mat4 compute_model_matrix(glm::vec3 const& origin, glm::vec3 const& orientation, glm::vec3 const& size) {
         glm::mat4 t = glm::translate(glm::mat4(1.0f), origin);
         glm::mat4 rx = glm::rotate(glm::mat4(1.0f), glm::radians(orientation.x), glm::vec3(1.0f, 0.0f, 0.0f));
         glm::mat4 ry = glm::rotate(glm::mat4(1.0f), glm::radians(orientation.y), glm::vec3(0.0f, 1.0f, 0.0f));
         glm::mat4 rz = glm::rotate(glm::mat4(1.0f), glm::radians(orientation.z), glm::vec3(0.0f, 0.0f, 1.0f));
         glm::mat4 s = glm::scale(glm::mat4(1.0f), size);
 
-        model_matrix = t * s * rx * ry * rz;
+        return t * s * rx * ry * rz;
+    }
 
-        shader.setUniform("uM_m", model_matrix);
+    // call after moving the mesh
+    void update_bounds(void) {
+        model_matrix = compute_model_matrix(origin, orientation, size);
+        if (!geometry)
+            return;
+        world_bounds = geometry->bounds.transformed(model_matrix);
+        world_sphere = geometry->sphere.transformed(model_matrix);
+    }
 
-        glBindTextureUnit(0, texture_id);
-        shader.setUniform("tex0", 0);
+    void set_texture(std::shared_ptr<Texture> new_texture) {
+        texture = std::move(new_texture);
+        texture_id = texture ? texture->id : 0;
+    }
+
+    // pick LOD from screen-space error: object space error scaled to world, projected at the mesh distance
+    void select_lod(glm::vec3 const& camera_pos, glm::mat4 const& projection, float viewport_height) {
+        lod_level = 0;
+        if (!geometry || geometry->lods.size() < 2)
+            return;
 
-        shader.setUniform("u_diffuse_color", diffuse_color);
+        float scale = std::max(std::abs(size.x), std::max(std::abs(size.y), std::abs(size.z)));
+        float distance = std::max(glm::distance(camera_pos, origin) - geometry->bounding_radius * scale, 0.001f);
+        float pixels_per_unit = projection[1][1] * viewport_height * 0.5f / distance;
 
-        glBindVertexArray(VAO);
-        glDrawElements(primitive_type, indices.size(), GL_UNSIGNED_INT, 0);
+        for (unsigned level = 1; level < geometry->lods.size(); level++) {
+            if (geometry->lods[level].error * scale * pixels_per_unit > lod_pixel_error)
+                break;
+            lod_level = level;
+        }
+    }
+
+    void draw(UniformRing& object_data, glm::vec3 const& camera_pos, glm::mat4 const& projection, float viewport_height) {
+        select_lod(camera_pos, projection, viewport_height);
+        draw(object_data);
+    }
+
+    // per-object uniforms go to ObjectData block (binding 1) through the ring, FrameData must be bound already
+    void draw(UniformRing& object_data) {
+ 		if (!geometry || geometry->vao() == 0) {
+			std::cerr << "VAO not initialized!\n";
+			return;
+		}
+        shader.activate();
+
+        model_matrix = compute_model_matrix(origin, orientation, size);
+
+        object_data.bind(OBJECT_DATA_BINDING, ObjectData{ model_matrix, diffuse_color,
+            geometry->quantization.scale, geometry->quantized ? 1 : 0, geometry->quantization.offset, 0.0f });
+
+        GLState::get().bind_texture_unit(0, texture_id); // tex0 samples unit 0
+
+        GLState::get().bind_vertex_array(geometry->vao());
+        MeshLod const& lod = geometry->lod(lod_level);
+        glDrawElements(primitive_type, lod.index_count, GL_UNSIGNED_INT, reinterpret_cast<const void*>(lod.index_offset * sizeof(GLuint)));
         
     }
 
@@ -116,19 +170,8 @@ public:
         // TODO: clear rest of the member variables to safe default
 
         shader.clear();
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
-        glDeleteVertexArrays(1, &VAO);
-        
+        // GL objects go away with the last mesh using them
+        geometry.reset();
+        texture.reset();
     };
-
-private:
-
-    std::vector<Vertex> vertices;
-    std::vector<GLuint> indices;
-
-    unsigned int VAO{0}, VBO{0}, EBO{0};
-};
-  
-
-
+};
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "MeshCache.hpp"
+#include "OBJloader.hpp"
+
+namespace {
+	constexpr char MESH_CACHE_MAGIC[8] = { 'M', 'E', 'S', 'H', 'B', 'I', 'N', '\0' };
+
+	constexpr std::uint64_t align16(std::uint64_t x) { return (x + 15) & ~std::uint64_t(15); }
+
+	bool sourceStamp(const std::filesystem::path& obj_path, std::uint64_t& size, std::int64_t& mtime) {
+		std::error_code ec;
+		size = std::filesystem::file_size(obj_path, ec);
+		if (ec)
+			return false;
+		auto time = std::filesystem::last_write_time(obj_path, ec);
+		if (ec)
+			return false;
+		mtime = static_cast<std::int64_t>(time.time_since_epoch().count());
+		return true;
+	}
+
+	// new source mtime in the header of an existing cache (must not be mapped: Windows denies writing then)
+	bool updateSourceMtime(const std::filesystem::path& cache_path, std::int64_t mtime) {
+		std::fstream file(cache_path, std::ios::in | std::ios::out | std::ios::binary);
+		if (!file.is_open())
+			return false;
+		file.seekp(offsetof(MeshCacheHeader, source_mtime));
+		file.write(reinterpret_cast<const char*>(&mtime), sizeof(mtime));
+		return file.good();
+	}
+}
+
+std::filesystem::path meshCachePath(const std::filesystem::path& obj_path)
+{
+	std::filesystem::path p = obj_path;
+	p += ".meshbin";
+	return p;
+}
+
+std::uint64_t hashBytes(const char* data, size_t size)
+{
+	// FNV-1a style mixing over 8-byte words, tail byte by byte
+	std::uint64_t h = 0xCBF29CE484222325ull;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		std::uint64_t w;
+		std::memcpy(&w, data + i, 8);
+		h = (h ^ w) * 0x100000001B3ull;
+		h ^= h >> 29;
+	}
+	for (; i < size; i++)
+		h = (h ^ static_cast<unsigned char>(data[i])) * 0x100000001B3ull;
+	return h ^ size;
+}
+
+bool openMeshCache(const std::filesystem::path& obj_path, MeshData& mesh)
+{
+	std::uint64_t source_size;
+	std::int64_t source_mtime;
+	if (!sourceStamp(obj_path, source_size, source_mtime))
+		return false;
+
+	std::filesystem::path cache_path = meshCachePath(obj_path);
+	MappedFile file(cache_path);
+	if (!file.is_open() || file.size() < sizeof(MeshCacheHeader))
+		return false;
+
+	MeshCacheHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0
+		|| header.version != MESH_CACHE_VERSION
+		|| header.vertex_size != sizeof(Vertex)
+		|| header.source_size != source_size)
+		return false;
+
+	if (header.vertex_offset % alignof(Vertex) != 0
+		|| header.index_offset % alignof(GLuint) != 0
+		|| header.vertex_offset + header.vertex_count * sizeof(Vertex) > file.size()
+		|| header.index_offset + header.index_count * sizeof(GLuint) > file.size()
+		|| header.lod_offset + header.lod_count * sizeof(MeshLod) > file.size()
+		|| header.lod_count == 0)
+		return false;
+
+	if (header.source_mtime != source_mtime) {
+		// touched, but maybe not changed
+		MappedFile source(obj_path);
+		if (!source.is_open() || hashBytes(source.data(), source.size()) != header.source_hash)
+			return false;
+
+		// same content: remember the new time, so later starts do not hash the source again
+		size_t cache_size = file.size();
+		file.close();
+		if (!updateSourceMtime(cache_path, source_mtime))
+			std::cerr << "Mesh cache: can not update " << cache_path.string() << '\n';
+		if (!file.open(cache_path) || file.size() != cache_size)
+			return false;
+	}
+
+	std::vector<MeshLod> lods(static_cast<size_t>(header.lod_count));
+	std::memcpy(lods.data(), file.data() + header.lod_offset, lods.size() * sizeof(MeshLod));
+	for (MeshLod const& lod : lods)
+		if (std::uint64_t(lod.index_offset) + lod.index_count > header.index_count)
+			return false;
+
+	mesh.owned_vertices.clear();
+	mesh.owned_indices.clear();
+	mesh.vertex_ptr = reinterpret_cast<const Vertex*>(file.data() + header.vertex_offset);
+	mesh.vertex_num = static_cast<size_t>(header.vertex_count);
+	mesh.index_ptr = reinterpret_cast<const GLuint*>(file.data() + header.index_offset);
+	mesh.index_num = static_cast<size_t>(header.index_count);
+	mesh.lod_list = std::move(lods);
+	mesh.file = std::move(file);
+	return true;
+}
+
+bool writeMeshCache(const std::filesystem::path& obj_path, std::uint64_t source_hash, std::vector<Vertex> const& vertices, std::vector<GLuint> const& indices, std::vector<MeshLod> const& lods)
+{
+	MeshCacheHeader header{};
+	std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+	header.version = MESH_CACHE_VERSION;
+	header.vertex_size = sizeof(Vertex);
+	if (!sourceStamp(obj_path, header.source_size, header.source_mtime))
+		return false;
+	header.source_hash = source_hash;
+	header.vertex_count = vertices.size();
+	header.index_count = indices.size();
+	header.lod_count = lods.size();
+	header.vertex_offset = align16(sizeof(MeshCacheHeader));
+	header.index_offset = align16(header.vertex_offset + vertices.size() * sizeof(Vertex));
+	header.lod_offset = align16(header.index_offset + indices.size() * sizeof(GLuint));
+
+	// write to temporary file first, so that a crash never leaves a half-written cache behind
+	std::filesystem::path cache_path = meshCachePath(obj_path);
+	std::filesystem::path tmp_path = cache_path;
+	tmp_path += ".tmp";
+	{
+		std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		const char zeros[16] = {};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(zeros, header.vertex_offset - sizeof(header));
+		out.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+		out.write(zeros, header.index_offset - (header.vertex_offset + vertices.size() * sizeof(Vertex)));
+		out.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(GLuint));
+		out.write(zeros, header.lod_offset - (header.index_offset + indices.size() * sizeof(GLuint)));
+		out.write(reinterpret_cast<const char*>(lods.data()), lods.size() * sizeof(MeshLod));
+		if (!out.good())
+			return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmp_path, cache_path, ec);
+	if (ec) {
+		std::filesystem::remove(tmp_path, ec);
+		return false;
+	}
+	return true;
+}
+
+bool loadMesh(const std::filesystem::path& obj_path, MeshData& mesh)
+{
+	if (openMeshCache(obj_path, mesh)) {
+		std::cout << "Model mapped from cache: " << meshCachePath(obj_path).string() << " (" << mesh.lod_list[0].index_count / 3 << " faces, " << mesh.lod_list.size() << " LODs)" << std::endl;
+		return true;
+	}
+
+	// parse, which also writes the cache
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	if (!loadOBJ(obj_path.string().c_str(), vertices, indices))
+		return false;
+
+	if (openMeshCache(obj_path, mesh))
+		return true;
+
+	// no usable cache, keep own copy
+	mesh.file.close();
+	mesh.owned_vertices = std::move(vertices);
+	mesh.owned_indices = std::move(indices);
+	mesh.vertex_ptr = mesh.owned_vertices.data();
+	mesh.vertex_num = mesh.owned_vertices.size();
+	mesh.index_ptr = mesh.owned_indices.data();
+	mesh.index_num = mesh.owned_indices.size();
+	mesh.lod_list = { MeshLod{ 0, static_cast<GLuint>(mesh.index_num), 0.0f } };
+	return true;
+}
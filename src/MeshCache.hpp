@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "MappedFile.hpp"
+#include "MeshSimplifier.hpp"
+#include "Vertex.h"
+
+// Binary cache of welded OBJ geometry, stored next to the source as "<name>.obj.meshbin".
+//
+// layout: MeshCacheHeader | Vertex[vertex_count] | GLuint[index_count] | MeshLod[lod_count]
+// The index array holds all LOD levels, level 0 first.
+// The cache is valid while the source has the same size and either the same
+// modification time or the same content hash.
+
+constexpr std::uint32_t MESH_CACHE_VERSION = 4; // 2: optimized triangle/vertex order, 3: LOD chain, 4: -0.0 welded with 0.0
+
+struct MeshCacheHeader {
+	char magic[8];                 // "MESHBIN\0"
+	std::uint32_t version;         // MESH_CACHE_VERSION
+	std::uint32_t vertex_size;     // sizeof(Vertex)
+	std::uint64_t source_size;
+	std::int64_t source_mtime;
+	std::uint64_t source_hash;
+	std::uint64_t vertex_count;
+	std::uint64_t index_count;
+	std::uint64_t lod_count;
+	std::uint64_t vertex_offset;   // from start of file
+	std::uint64_t index_offset;
+	std::uint64_t lod_offset;
+};
+
+// Welded mesh geometry, either mapped straight from the cache file (zero copy)
+// or owned, when no cache could be used (e.g. read-only resource directory).
+class MeshData {
+public:
+	const Vertex* vertices(void) const { return vertex_ptr; }
+	size_t vertex_count(void) const { return vertex_num; }
+	const GLuint* indices(void) const { return index_ptr; }
+	size_t index_count(void) const { return index_num; } // all levels
+	std::vector<MeshLod> const& lods(void) const { return lod_list; }
+
+	bool is_mapped(void) const { return file.is_open(); }
+
+private:
+	MappedFile file;
+	std::vector<Vertex> owned_vertices;
+	std::vector<GLuint> owned_indices;
+
+	const Vertex* vertex_ptr{ nullptr };
+	size_t vertex_num{ 0 };
+	const GLuint* index_ptr{ nullptr };
+	size_t index_num{ 0 };
+	std::vector<MeshLod> lod_list;
+
+	friend bool openMeshCache(const std::filesystem::path& obj_path, MeshData& mesh);
+	friend bool loadMesh(const std::filesystem::path& obj_path, MeshData& mesh);
+};
+
+std::filesystem::path meshCachePath(const std::filesystem::path& obj_path);
+
+// 64-bit hash of file contents, used to validate the cache when only mtime changed
+std::uint64_t hashBytes(const char* data, size_t size);
+
+// map the cache of obj_path, if it exists and is up to date
+bool openMeshCache(const std::filesystem::path& obj_path, MeshData& mesh);
+
+// write (replace) the cache of obj_path; indices hold all levels described by lods
+bool writeMeshCache(const std::filesystem::path& obj_path, std::uint64_t source_hash, std::vector<Vertex> const& vertices, std::vector<GLuint> const& indices, std::vector<MeshLod> const& lods);
+
+// load welded OBJ geometry, from the cache when valid, otherwise parse the OBJ (which refreshes the cache)
+bool loadMesh(const std::filesystem::path& obj_path, MeshData& mesh);
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+#include "Bounds.hpp"
+#include "Meshlets.hpp"
+#include "MeshCache.hpp"
+#include "VertexQuantization.hpp"
+#include "ShaderProgram.hpp"
+#include "GLState.hpp"
+
+// GPU side of a mesh: VBO, EBO, VAO and LOD table.
+// Shared through std::shared_ptr by every Mesh that draws the same geometry (see ResourceRegistry),
+// the GL objects are deleted with the last owner - GL context must still be current at that time.
+// VAO attribute locations come from the shader, so the geometry is only valid with that shader (or a compatible one).
+class MeshGeometry {
+public:
+    // vertices stored as PackedVertex (half the memory and fetch bandwidth), dequantized in vertex shader
+    bool quantized = false;
+    VertexQuantization quantization{};
+
+    std::vector<MeshLod> lods;
+    float bounding_radius{0.0f}; // around local origin, for LOD distance
+    // local space, for culling
+    BoundingBox bounds;
+    BoundingSphere sphere;
+
+    size_t vertex_count{0};
+    size_t index_count{0};    // all LOD levels
+    size_t gpu_bytes{0};      // VBO + EBO
+
+    // CPU-side copy (full precision, all LOD levels) for picking, collision etc.
+    // Empty unless asked for with keep_cpu_data - after upload only the counts above are needed for drawing.
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+
+    // clusters of LOD 0 for per-cluster culling (MeshletRenderer), empty unless build_meshlets() was called
+    std::vector<Meshlet> meshlets;
+    std::vector<GLuint> meshlet_indices;  // LOD 0 triangles in meshlet order, same vertices as the EBO
+
+    MeshGeometry(ShaderProgram& shader, const Vertex* vertex_data, size_t vertex_count, const GLuint* index_data, size_t index_count, std::vector<MeshLod> const& lods, bool const quantized = false, bool const keep_cpu_data = false) :
+        quantized(quantized),
+        lods(lods),
+        vertex_count(vertex_count),
+        index_count(index_count)
+    {
+        if (this->lods.empty())
+            this->lods = { MeshLod{ 0, static_cast<GLuint>(index_count), 0.0f } };
+        upload(shader, vertex_data, index_data);
+        if (keep_cpu_data) {
+            vertices.assign(vertex_data, vertex_data + vertex_count);
+            indices.assign(index_data, index_data + index_count);
+        }
+    }
+
+    // single level, from CPU-side vectors
+    MeshGeometry(ShaderProgram& shader, std::vector<Vertex> const& vertices, std::vector<GLuint> const& indices, bool const quantized = false, bool const keep_cpu_data = false) :
+        MeshGeometry(shader, vertices.data(), vertices.size(), indices.data(), indices.size(), {}, quantized, keep_cpu_data) {}
+
+    // straight from mapped mesh data (including its LOD chain), no CPU-side copy is kept unless asked for
+    MeshGeometry(ShaderProgram& shader, MeshData const& data, bool const quantized = false, bool const keep_cpu_data = false) :
+        MeshGeometry(shader, data.vertices(), data.vertex_count(), data.indices(), data.index_count(), data.lods(), quantized, keep_cpu_data) {}
+
+    MeshGeometry(MeshGeometry const&) = delete;
+    MeshGeometry& operator=(MeshGeometry const&) = delete;
+
+    ~MeshGeometry() {
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        GLState::get().forget_vertex_array(VAO);
+        glDeleteVertexArrays(1, &VAO);
+    }
+
+    GLuint vao(void) const { return VAO; }
+    GLuint vbo(void) const { return VBO; }
+    GLuint ebo(void) const { return EBO; }
+    size_t vertex_stride(void) const { return quantized ? sizeof(PackedVertex) : sizeof(Vertex); }
+
+    // attribute formats of Vertex/PackedVertex at binding 0, locations of aPos, aNorm, aTex queried from the program
+    static void setup_vertex_format(GLuint vao, GLuint prog_h, bool quantized) {
+        // Set Vertex Attribute to explain OpenGL how to interpret the data
+        GLint position_attrib_location = glGetAttribLocation(prog_h, "aPos");
+        if (position_attrib_location == -1)
+            std::cerr << "Position of 'aPos' not found" << std::endl;
+        else {
+            if (quantized)
+                glVertexArrayAttribFormat(vao, position_attrib_location, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, Position));
+            else
+                glVertexArrayAttribFormat(vao, position_attrib_location, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position));
+            glVertexArrayAttribBinding(vao, position_attrib_location, 0);
+            glEnableVertexArrayAttrib(vao, position_attrib_location);
+        }
+        // Set end enable Vertex Attribute for Normal
+        GLint normal_attrib_location = glGetAttribLocation(prog_h, "aNorm");
+        if (normal_attrib_location == -1)
+            std::cerr << "Position of 'aNorm' not found" << std::endl;
+        else {
+            if (quantized)
+                glVertexArrayAttribFormat(vao, normal_attrib_location, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, Normal)); // octahedral
+            else
+                glVertexArrayAttribFormat(vao, normal_attrib_location, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal));
+            glVertexArrayAttribBinding(vao, normal_attrib_location, 0);
+            glEnableVertexArrayAttrib(vao, normal_attrib_location);
+        }
+        // Set end enable Vertex Attribute for Texture Coordinates
+        GLint tex_attrib_location = glGetAttribLocation(prog_h, "aTex");
+        if (tex_attrib_location == -1)
+            std::cerr << "Position of 'aTex' not found" << std::endl;
+        else {
+            if (quantized)
+                glVertexArrayAttribFormat(vao, tex_attrib_location, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, TexCoords));
+            else
+                glVertexArrayAttribFormat(vao, tex_attrib_location, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords));
+            glVertexArrayAttribBinding(vao, tex_attrib_location, 0);
+            glEnableVertexArrayAttrib(vao, tex_attrib_location);
+        }
+    }
+
+    MeshLod const& lod(unsigned level) const { return lods[std::min<size_t>(level, lods.size() - 1)]; }
+
+    // vertex and index data as passed to the constructor (full precision), only LOD 0 is clustered
+    void build_meshlets(const Vertex* vertex_data, const GLuint* index_data) {
+        MeshLod const& level0 = lods.front();
+        buildMeshlets(vertex_data, vertex_count, index_data + level0.index_offset, level0.index_count, meshlets, meshlet_indices);
+    }
+
+private:
+    GLuint VAO{0}, VBO{0}, EBO{0};
+
+    void upload(ShaderProgram& shader, const Vertex* vertex_data, const GLuint* index_data) {
+        bounding_radius = 0.0f;
+        for (size_t i = 0; i < vertex_count; i++)
+            bounding_radius = std::max(bounding_radius, glm::length(vertex_data[i].Position));
+        computeBounds(vertex_data, vertex_count, bounds, sphere);
+
+        glCreateVertexArrays(1, &VAO);
+        setup_vertex_format(VAO, shader.getID(), quantized);
+
+        // Create and fill data
+        glCreateBuffers(1, &VBO); // Vertex Buffer Object
+        glCreateBuffers(1, &EBO); // Element Buffer Object
+        size_t vertex_bytes;
+        if (quantized) {
+            std::vector<PackedVertex> packed;
+            quantization = packVertices(vertex_data, vertex_count, packed);
+            vertex_bytes = packed.size() * sizeof(PackedVertex);
+            glNamedBufferData(VBO, vertex_bytes, packed.data(), GL_STATIC_DRAW);
+        }
+        else {
+            quantization = VertexQuantization{};
+            vertex_bytes = vertex_count * sizeof(Vertex);
+            glNamedBufferData(VBO, vertex_bytes, vertex_data, GL_STATIC_DRAW);
+        }
+        glNamedBufferData(EBO, index_count * sizeof(GLuint), index_data, GL_STATIC_DRAW);
+        gpu_bytes = vertex_bytes + index_count * sizeof(GLuint);
+        //Connect together
+        glVertexArrayVertexBuffer(VAO, 0, VBO, 0, vertex_stride());
+        glVertexArrayElementBuffer(VAO, EBO);
+    }
+};
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+#include <glm/glm.hpp>
+
+#include "MeshOptimizer.hpp"
+
+VertexCacheStats analyzeVertexCache(std::vector<GLuint> const& indices, size_t vertex_count, unsigned cache_size)
+{
+	VertexCacheStats stats;
+	if (indices.empty() || vertex_count == 0)
+		return stats;
+
+	// FIFO cache simulated with timestamps: vertex is cached if it entered less than cache_size misses ago
+	std::vector<size_t> entered(vertex_count, 0);
+	std::vector<bool> used(vertex_count, false);
+	size_t misses = 0;
+	size_t referenced = 0;
+
+	for (GLuint v : indices) {
+		if (!used[v]) {
+			used[v] = true;
+			referenced++;
+		}
+		if (entered[v] == 0 || misses - entered[v] + 1 > cache_size) {
+			misses++;
+			entered[v] = misses;
+		}
+	}
+
+	stats.acmr = static_cast<float>(misses) / (indices.size() / 3);
+	stats.atvr = static_cast<float>(misses) / referenced;
+	return stats;
+}
+
+namespace {
+	// triangles adjacent to each vertex, CSR layout
+	struct Adjacency {
+		std::vector<unsigned> offsets;
+		std::vector<unsigned> triangles;
+		std::vector<unsigned> live; // adjacent triangles not emitted yet
+	};
+
+	Adjacency buildAdjacency(std::vector<GLuint> const& indices, size_t vertex_count) {
+		Adjacency adj;
+		adj.live.assign(vertex_count, 0);
+		for (GLuint v : indices)
+			adj.live[v]++;
+
+		adj.offsets.resize(vertex_count + 1);
+		adj.offsets[0] = 0;
+		for (size_t v = 0; v < vertex_count; v++)
+			adj.offsets[v + 1] = adj.offsets[v] + adj.live[v];
+
+		adj.triangles.resize(indices.size());
+		std::vector<unsigned> fill(adj.offsets.begin(), adj.offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adj.triangles[fill[indices[i]]++] = static_cast<unsigned>(i / 3);
+		return adj;
+	}
+}
+
+void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertex_count, unsigned cache_size, std::vector<size_t>* clusters)
+{
+	const size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+		return;
+
+	Adjacency adj = buildAdjacency(indices, vertex_count);
+
+	std::vector<size_t> cache_time(vertex_count, 0);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<GLuint> dead_end; // recently used vertices, candidates when fanning gets stuck
+	std::vector<GLuint> candidates;
+	std::vector<GLuint> output;
+	output.reserve(indices.size());
+
+	size_t time = cache_size + 1;
+	size_t cursor = 0; // scan position for the next unfinished vertex
+	long long fan = 0;
+
+	if (clusters) {
+		clusters->clear();
+		clusters->push_back(0);
+	}
+
+	while (fan >= 0) {
+		candidates.clear();
+
+		// emit all remaining triangles around the fanning vertex
+		for (unsigned k = adj.offsets[fan]; k < adj.offsets[fan + 1]; k++) {
+			unsigned t = adj.triangles[k];
+			if (emitted[t])
+				continue;
+			emitted[t] = true;
+
+			for (int c = 0; c < 3; c++) {
+				GLuint v = indices[3 * t + c];
+				output.push_back(v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				adj.live[v]--;
+				if (time - cache_time[v] > cache_size)
+					cache_time[v] = time++;
+			}
+		}
+
+		// next fanning vertex: the one staying longest in cache after its remaining triangles are emitted
+		long long next = -1;
+		long long best = -1;
+		for (GLuint v : candidates) {
+			if (adj.live[v] == 0)
+				continue;
+			long long priority = 0;
+			if (time - cache_time[v] + 2 * adj.live[v] <= cache_size)
+				priority = static_cast<long long>(time - cache_time[v]);
+			if (priority > best) {
+				best = priority;
+				next = v;
+			}
+		}
+
+		if (next == -1) {
+			// dead end: try recently used vertices, then any unfinished one (hard cluster boundary)
+			while (!dead_end.empty() && next == -1) {
+				GLuint v = dead_end.back();
+				dead_end.pop_back();
+				if (adj.live[v] > 0)
+					next = v;
+			}
+			if (next == -1) {
+				while (cursor < vertex_count && adj.live[cursor] == 0)
+					cursor++;
+				if (cursor < vertex_count) {
+					next = static_cast<long long>(cursor);
+					if (clusters && output.size() / 3 < triangle_count)
+						clusters->push_back(output.size() / 3);
+				}
+			}
+		}
+		fan = next;
+	}
+
+	indices.swap(output);
+}
+
+void optimizeOverdraw(std::vector<GLuint>& indices, std::vector<Vertex> const& vertices, std::vector<size_t> const& clusters, float threshold, unsigned cache_size)
+{
+	const size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0 || clusters.empty())
+		return;
+
+	// split hard clusters further, wherever the running ACMR of the cluster stays within the threshold
+	const float target_acmr = analyzeVertexCache(indices, vertices.size(), cache_size).acmr * threshold;
+	std::vector<size_t> starts;
+	{
+		std::vector<size_t> entered(vertices.size(), 0);
+		size_t misses = 0;
+		for (size_t c = 0; c < clusters.size(); c++) {
+			size_t begin = clusters[c];
+			size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangle_count;
+			size_t start = begin;
+			size_t start_misses = misses;
+			const size_t cold = misses; // cache starts empty at every hard boundary
+			starts.push_back(begin);
+
+			for (size_t t = begin; t < end; t++) {
+				for (int k = 0; k < 3; k++) {
+					GLuint v = indices[3 * t + k];
+					if (entered[v] <= cold || misses - entered[v] + 1 > cache_size) {
+						misses++;
+						entered[v] = misses;
+					}
+				}
+				size_t tris = t + 1 - start;
+				// minimum cluster size keeps the sort meaningful and cheap
+				if (tris >= 16 && t + 1 < end && static_cast<float>(misses - start_misses) / tris <= target_acmr) {
+					starts.push_back(t + 1);
+					start = t + 1;
+					start_misses = misses;
+				}
+			}
+		}
+	}
+
+	// mesh centroid
+	glm::vec3 mesh_center(0.0f);
+	float mesh_area = 0.0f;
+	for (size_t t = 0; t < triangle_count; t++) {
+		glm::vec3 const& a = vertices[indices[3 * t + 0]].Position;
+		glm::vec3 const& b = vertices[indices[3 * t + 1]].Position;
+		glm::vec3 const& c = vertices[indices[3 * t + 2]].Position;
+		float area = glm::length(glm::cross(b - a, c - a));
+		mesh_center += (a + b + c) * (area / 3.0f);
+		mesh_area += area;
+	}
+	if (mesh_area > 0.0f)
+		mesh_center /= mesh_area;
+
+	// view independent occlusion potential: how much the cluster faces away from the mesh center
+	struct Cluster {
+		size_t begin, end;
+		float sort_key;
+	};
+	std::vector<Cluster> sorted;
+	sorted.reserve(starts.size());
+	for (size_t c = 0; c < starts.size(); c++) {
+		Cluster cl{ starts[c], (c + 1 < starts.size()) ? starts[c + 1] : triangle_count, 0.0f };
+		glm::vec3 center(0.0f), normal(0.0f);
+		float area_sum = 0.0f;
+		for (size_t t = cl.begin; t < cl.end; t++) {
+			glm::vec3 const& a = vertices[indices[3 * t + 0]].Position;
+			glm::vec3 const& b = vertices[indices[3 * t + 1]].Position;
+			glm::vec3 const& d = vertices[indices[3 * t + 2]].Position;
+			glm::vec3 n = glm::cross(b - a, d - a); // length = 2 * area
+			float area = glm::length(n);
+			center += (a + b + d) * (area / 3.0f);
+			normal += n;
+			area_sum += area;
+		}
+		if (area_sum > 0.0f) {
+			center /= area_sum;
+			float len = glm::length(normal);
+			if (len > 0.0f)
+				cl.sort_key = glm::dot(center - mesh_center, normal / len);
+		}
+		sorted.push_back(cl);
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](Cluster const& a, Cluster const& b) { return a.sort_key > b.sort_key; });
+
+	std::vector<GLuint> output;
+	output.reserve(indices.size());
+	for (Cluster const& cl : sorted)
+		output.insert(output.end(), indices.begin() + 3 * cl.begin, indices.begin() + 3 * cl.end);
+	indices.swap(output);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	constexpr GLuint UNUSED = ~GLuint(0);
+	std::vector<GLuint> remap(vertices.size(), UNUSED);
+	std::vector<Vertex> output;
+	output.reserve(vertices.size());
+
+	for (GLuint& index : indices) {
+		if (remap[index] == UNUSED) {
+			remap[index] = static_cast<GLuint>(output.size());
+			output.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(output);
+}
+
+void optimizeMesh(const char* name, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	if (indices.size() < 3)
+		return;
+
+	VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+
+	std::vector<size_t> clusters;
+	optimizeVertexCache(indices, vertices.size(), VERTEX_CACHE_SIZE, &clusters);
+	optimizeOverdraw(indices, vertices, clusters);
+	optimizeVertexFetch(vertices, indices);
+
+	VertexCacheStats after = analyzeVertexCache(indices, vertices.size());
+	std::cout << "Mesh optimized: " << name << " ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << " (cache " << VERTEX_CACHE_SIZE << ")" << std::endl;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Vertex.h"
+
+// Post-load mesh optimization for indexed triangle lists:
+//   1. triangle order for post-transform vertex cache (Tipsify, Sander et al. 2007)
+//   2. cluster order for reduced overdraw (outward facing clusters first)
+//   3. vertex order equal to first use (fetch locality)
+
+// FIFO cache size the GPU is assumed to have
+constexpr unsigned VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+	float acmr{ 0 }; // average cache miss ratio: transformed vertices per triangle (0.5 ideal for big grids, 3 worst)
+	float atvr{ 0 }; // average transform to vertex ratio: transformed vertices per referenced vertex (1 ideal)
+};
+
+VertexCacheStats analyzeVertexCache(std::vector<GLuint> const& indices, size_t vertex_count, unsigned cache_size = VERTEX_CACHE_SIZE);
+
+// reorder triangles; clusters receives the first triangle of every hard cluster boundary (may be nullptr)
+void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertex_count, unsigned cache_size = VERTEX_CACHE_SIZE, std::vector<size_t>* clusters = nullptr);
+
+// reorder clusters produced by optimizeVertexCache so that outer surfaces are drawn first;
+// threshold limits how much ACMR may get worse when clusters are split further (1.05 = 5%)
+void optimizeOverdraw(std::vector<GLuint>& indices, std::vector<Vertex> const& vertices, std::vector<size_t> const& clusters, float threshold = 1.05f, unsigned cache_size = VERTEX_CACHE_SIZE);
+
+// reorder vertices to the order of first use, drop unreferenced ones
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+// all of the above, prints ACMR/ATVR before and after
+void optimizeMesh(const char* name, std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
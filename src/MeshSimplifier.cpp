@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "MeshSimplifier.hpp"
+#include "MeshOptimizer.hpp"
+
+namespace {
+	// symmetric 4x4 matrix of area weighted plane equations, error(p) = p^T Q p / weight
+	// (mean squared distance of p to the planes)
+	struct Quadric {
+		double a00{ 0 }, a01{ 0 }, a02{ 0 }, a03{ 0 };
+		double a11{ 0 }, a12{ 0 }, a13{ 0 };
+		double a22{ 0 }, a23{ 0 };
+		double a33{ 0 };
+		double weight{ 0 };
+
+		static Quadric plane(glm::dvec3 n, double d, double w) {
+			Quadric q;
+			q.a00 = w * n.x * n.x; q.a01 = w * n.x * n.y; q.a02 = w * n.x * n.z; q.a03 = w * n.x * d;
+			q.a11 = w * n.y * n.y; q.a12 = w * n.y * n.z; q.a13 = w * n.y * d;
+			q.a22 = w * n.z * n.z; q.a23 = w * n.z * d;
+			q.a33 = w * d * d;
+			q.weight = w;
+			return q;
+		}
+
+		Quadric& operator+=(Quadric const& q) {
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+			weight += q.weight;
+			return *this;
+		}
+
+		double error(glm::dvec3 p) const {
+			double e = a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + 2 * a03 * p.x
+				+ a11 * p.y * p.y + 2 * a12 * p.y * p.z + 2 * a13 * p.y
+				+ a22 * p.z * p.z + 2 * a23 * p.z
+				+ a33;
+			return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+		}
+	};
+
+	struct PositionHash {
+		size_t operator()(glm::vec3 const& p) const {
+			std::uint32_t w[3];
+			std::memcpy(w, &p, sizeof(w));
+			return (w[0] * 73856093u) ^ (w[1] * 19349663u) ^ (w[2] * 83492791u);
+		}
+	};
+	struct PositionEqual {
+		bool operator()(glm::vec3 const& a, glm::vec3 const& b) const { return std::memcmp(&a, &b, sizeof(glm::vec3)) == 0; }
+	};
+
+	struct Collapse {
+		GLuint from, to; // position ids
+		double cost;
+	};
+
+	class Simplifier {
+	public:
+		Simplifier(std::vector<Vertex> const& vertices, std::vector<GLuint> const& indices) :
+			vertices(vertices),
+			indices(indices)
+		{
+			// vertices sharing a position form one "position" with several wedges (seam)
+			std::unordered_map<glm::vec3, GLuint, PositionHash, PositionEqual> ids;
+			position_of.resize(vertices.size());
+			for (size_t v = 0; v < vertices.size(); v++) {
+				auto it = ids.emplace(vertices[v].Position, static_cast<GLuint>(ids.size())).first;
+				position_of[v] = it->second;
+			}
+			position_count = ids.size();
+			points.resize(position_count);
+			for (size_t v = 0; v < vertices.size(); v++)
+				points[position_of[v]] = vertices[v].Position;
+
+			// locked: seams (several referenced wedges), open borders and non-manifold edges
+			locked.assign(position_count, false);
+			std::vector<GLuint> wedge(position_count, ~GLuint(0));
+			for (GLuint v : indices) {
+				GLuint p = position_of[v];
+				if (wedge[p] == ~GLuint(0))
+					wedge[p] = v;
+				else if (wedge[p] != v)
+					locked[p] = true;
+			}
+			std::unordered_map<std::uint64_t, unsigned> edge_use;
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+				for (int k = 0; k < 3; k++)
+					edge_use[edge_key(position_of[indices[t + k]], position_of[indices[t + (k + 1) % 3]])]++;
+			for (auto const& e : edge_use) {
+				if (e.second != 2) {
+					locked[e.first >> 32] = true;
+					locked[e.first & 0xFFFFFFFFu] = true;
+				}
+			}
+
+			// no single collapse may move the surface by more than a fraction of the mesh size
+			glm::vec3 lo = points.empty() ? glm::vec3(0.0f) : points[0], hi = lo;
+			for (glm::vec3 const& p : points) {
+				lo = glm::min(lo, p);
+				hi = glm::max(hi, p);
+			}
+			double limit = 0.1 * glm::length(hi - lo);
+			max_collapse_cost = limit * limit;
+
+			// plane quadrics of all triangles
+			quadrics.resize(position_count);
+			for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+				glm::dvec3 a = points[position_of[indices[t]]], b = points[position_of[indices[t + 1]]], c = points[position_of[indices[t + 2]]];
+				glm::dvec3 n = glm::cross(b - a, c - a);
+				double len = glm::length(n);
+				if (len == 0.0)
+					continue;
+				n /= len;
+				Quadric q = Quadric::plane(n, -glm::dot(n, a), len * 0.5);
+				for (int k = 0; k < 3; k++)
+					quadrics[position_of[indices[t + k]]] += q;
+			}
+		}
+
+		// collapse edges until at most target_index_count indices remain or nothing can be collapsed
+		void reduce(size_t target_index_count) {
+			while (indices.size() > target_index_count) {
+				size_t collapsed = pass(target_index_count);
+				if (collapsed == 0)
+					break;
+			}
+		}
+
+		std::vector<GLuint> const& result(void) const { return indices; }
+		float result_error(void) const { return static_cast<float>(std::sqrt(max_error)); }
+
+	private:
+		std::vector<Vertex> const& vertices;
+		std::vector<GLuint> indices;
+		std::vector<GLuint> position_of; // vertex -> position id
+		std::vector<glm::vec3> points;   // position id -> position
+		std::vector<bool> locked;
+		std::vector<Quadric> quadrics;
+		size_t position_count{ 0 };
+		double max_error{ 0 };
+		double max_collapse_cost{ 0 };
+
+		static std::uint64_t edge_key(GLuint a, GLuint b) {
+			if (a > b)
+				std::swap(a, b);
+			return (std::uint64_t(a) << 32) | b;
+		}
+
+		bool flips(GLuint from, GLuint to, std::vector<unsigned> const& tri_offsets, std::vector<unsigned> const& tris) const {
+			glm::vec3 p_to = points[to];
+			for (unsigned k = tri_offsets[from]; k < tri_offsets[from + 1]; k++) {
+				unsigned t = tris[k];
+				GLuint p[3] = { position_of[indices[3 * t]], position_of[indices[3 * t + 1]], position_of[indices[3 * t + 2]] };
+				if (p[0] == to || p[1] == to || p[2] == to)
+					continue; // this triangle disappears
+				glm::vec3 a = points[p[0]], b = points[p[1]], c = points[p[2]];
+				glm::vec3 n0 = glm::cross(b - a, c - a);
+				for (int i = 0; i < 3; i++)
+					if (p[i] == from)
+						(i == 0 ? a : i == 1 ? b : c) = p_to;
+				glm::vec3 n1 = glm::cross(b - a, c - a);
+				if (glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1))
+					return true;
+			}
+			return false;
+		}
+
+		size_t pass(size_t target_index_count) {
+			const size_t triangle_count = indices.size() / 3;
+
+			// position -> triangles
+			std::vector<unsigned> tri_offsets(position_count + 1, 0);
+			for (GLuint v : indices)
+				tri_offsets[position_of[v] + 1]++;
+			for (size_t p = 0; p < position_count; p++)
+				tri_offsets[p + 1] += tri_offsets[p];
+			std::vector<unsigned> tris(indices.size());
+			{
+				std::vector<unsigned> fill(tri_offsets.begin(), tri_offsets.end() - 1);
+				for (size_t i = 0; i < indices.size(); i++)
+					tris[fill[position_of[indices[i]]]++] = static_cast<unsigned>(i / 3);
+			}
+
+			// cheapest direction of every edge
+			std::vector<std::uint64_t> edges;
+			edges.reserve(indices.size());
+			for (size_t t = 0; t < triangle_count; t++)
+				for (int k = 0; k < 3; k++)
+					edges.push_back(edge_key(position_of[indices[3 * t + k]], position_of[indices[3 * t + (k + 1) % 3]]));
+			std::sort(edges.begin(), edges.end());
+			edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+			std::vector<Collapse> collapses;
+			for (std::uint64_t e : edges) {
+				GLuint a = static_cast<GLuint>(e >> 32), b = static_cast<GLuint>(e & 0xFFFFFFFFu);
+				Collapse best{ 0, 0, -1.0 };
+				if (!locked[a]) {
+					Quadric q = quadrics[a];
+					q += quadrics[b];
+					best = { a, b, q.error(points[b]) };
+				}
+				if (!locked[b]) {
+					Quadric q = quadrics[a];
+					q += quadrics[b];
+					double cost = q.error(points[a]);
+					if (best.cost < 0 || cost < best.cost)
+						best = { b, a, cost };
+				}
+				if (best.cost >= 0 && best.cost <= max_collapse_cost)
+					collapses.push_back(best);
+			}
+			std::sort(collapses.begin(), collapses.end(), [](Collapse const& x, Collapse const& y) { return x.cost < y.cost; });
+
+			// collapse independent edges, cheapest first
+			std::vector<bool> touched(position_count, false);
+			std::vector<GLuint> remap(vertices.size());
+			for (size_t v = 0; v < remap.size(); v++)
+				remap[v] = static_cast<GLuint>(v);
+
+			size_t removed_indices = 0;
+			size_t collapsed = 0;
+			const size_t can_remove = indices.size() - target_index_count;
+			for (Collapse const& c : collapses) {
+				if (removed_indices >= can_remove)
+					break;
+				if (touched[c.from] || touched[c.to])
+					continue;
+				if (flips(c.from, c.to, tri_offsets, tris))
+					continue;
+
+				// source has a single wedge (not a seam); pick the wedge of the target used along the edge
+				GLuint from_vertex = ~GLuint(0), to_vertex = ~GLuint(0);
+				bool ambiguous = false;
+				size_t shared_triangles = 0;
+				for (unsigned k = tri_offsets[c.from]; k < tri_offsets[c.from + 1]; k++) {
+					unsigned t = tris[k];
+					bool has_to = false;
+					for (int i = 0; i < 3; i++) {
+						GLuint v = indices[3 * t + i];
+						if (position_of[v] == c.from)
+							from_vertex = v;
+						if (position_of[v] == c.to) {
+							has_to = true;
+							if (to_vertex != ~GLuint(0) && to_vertex != v)
+								ambiguous = true;
+							to_vertex = v;
+						}
+					}
+					if (has_to)
+						shared_triangles++;
+				}
+				if (ambiguous || to_vertex == ~GLuint(0) || from_vertex == ~GLuint(0))
+					continue;
+
+				remap[from_vertex] = to_vertex;
+				quadrics[c.to] += quadrics[c.from];
+				max_error = std::max(max_error, c.cost);
+				removed_indices += 3 * shared_triangles;
+				collapsed++;
+
+				// neighbours of the source change shape, keep them out of this pass
+				touched[c.from] = true;
+				touched[c.to] = true;
+				for (unsigned k = tri_offsets[c.from]; k < tri_offsets[c.from + 1]; k++)
+					for (int i = 0; i < 3; i++)
+						touched[position_of[indices[3 * tris[k] + i]]] = true;
+			}
+
+			if (collapsed == 0)
+				return 0;
+
+			// apply, drop degenerate triangles
+			std::vector<GLuint> output;
+			output.reserve(indices.size());
+			for (size_t t = 0; t < triangle_count; t++) {
+				GLuint a = remap[indices[3 * t]], b = remap[indices[3 * t + 1]], c = remap[indices[3 * t + 2]];
+				if (position_of[a] == position_of[b] || position_of[b] == position_of[c] || position_of[a] == position_of[c])
+					continue;
+				output.insert(output.end(), { a, b, c });
+			}
+			indices.swap(output);
+			return collapsed;
+		}
+	};
+}
+
+std::vector<MeshLod> buildLodChain(std::vector<Vertex> const& vertices, std::vector<GLuint> const& indices, std::vector<GLuint>& lod_indices, unsigned max_levels)
+{
+	std::vector<MeshLod> lods;
+	lod_indices.assign(indices.begin(), indices.end());
+	lods.push_back({ 0, static_cast<GLuint>(indices.size()), 0.0f });
+
+	if (indices.size() < 3 * 64) // too small to be worth it
+		return lods;
+
+	Simplifier simplifier(vertices, indices);
+	size_t previous = indices.size();
+	while (lods.size() < max_levels) {
+		size_t target = (previous / 2) / 3 * 3;
+		simplifier.reduce(target);
+
+		std::vector<GLuint> level = simplifier.result();
+		if (level.size() > previous * 9 / 10 || level.empty()) // no real progress, stop the chain
+			break;
+		optimizeVertexCache(level, vertices.size());
+
+		lods.push_back({ static_cast<GLuint>(lod_indices.size()), static_cast<GLuint>(level.size()), simplifier.result_error() });
+		lod_indices.insert(lod_indices.end(), level.begin(), level.end());
+		previous = level.size();
+	}
+	return lods;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Vertex.h"
+
+// Level of detail as a range of a shared index buffer; all levels use the same vertex buffer
+struct MeshLod {
+	GLuint index_offset{ 0 };
+	GLuint index_count{ 0 };
+	float error{ 0.0f }; // geometric deviation from level 0, in mesh (object space) units
+};
+
+constexpr unsigned MAX_MESH_LODS = 5;
+
+// Quadric error (Garland-Heckbert) edge collapse simplification.
+// Vertices are collapsed onto one of their neighbours (half-edge collapse), so no new vertices are created.
+// UV/normal seams and open borders are kept intact.
+//
+// Builds up to max_levels levels, each with about half the triangles of the previous one,
+// and appends their (vertex cache optimized) indices to lod_indices; level 0 is the input.
+std::vector<MeshLod> buildLodChain(std::vector<Vertex> const& vertices, std::vector<GLuint> const& indices, std::vector<GLuint>& lod_indices, unsigned max_levels = MAX_MESH_LODS);
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "MeshletRenderer.hpp"
+#include "GLState.hpp"
+#include "GLBuffers.hpp"
+
+namespace {
+	// local_size_x of cull_meshlets.comp
+	constexpr size_t CULL_GROUP_SIZE = 64;
+}
+
+MeshletRenderer::~MeshletRenderer()
+{
+	clear();
+}
+
+void MeshletRenderer::clear(void)
+{
+	for (GLsync& fence : fences) {
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (readback_buffer)
+		glUnmapNamedBuffer(readback_buffer);
+	readback = nullptr;
+
+	GLuint buffers[] = { VBO, EBO, meshlet_buffer, object_buffer, record_buffer, command_buffer, counter_buffer, readback_buffer };
+	glDeleteBuffers(8, buffers);
+	GLState::get().forget_vertex_array(VAO);
+	glDeleteVertexArrays(1, &VAO);
+	VAO = VBO = EBO = 0;
+	meshlet_buffer = object_buffer = record_buffer = command_buffer = counter_buffer = readback_buffer = 0;
+	object_capacity = record_capacity = command_capacity = 0;
+	meshes.clear();
+	records.clear();
+	commands.clear();
+	objects.clear();
+	frame = 0;
+	last_stats = Stats{};
+}
+
+void MeshletRenderer::build(ShaderProgram& shader, ShaderProgram& cull_shader, std::vector<Mesh*> const& meshes)
+{
+	clear();
+	this->shader = &shader;
+	this->cull_shader = &cull_shader;
+	this->meshes = meshes;
+	gpu_culled_location = shader.getUniformLocation("gpu_culled");
+	cull_location = cull_shader.getUniformLocation("cull");
+	compact_location = cull_shader.getUniformLocation("compact");
+	ranges.clear();
+	textures.clear();
+
+	std::vector<MeshGeometry const*> geometries;
+	for (Mesh* m : meshes) {
+		MeshGeometry const* geometry = m->geometry.get();
+		if (!geometry || geometry->meshlets.empty())
+			throw std::runtime_error("MeshletRenderer: mesh without meshlets");
+		if (m->primitive_type != GL_TRIANGLES)
+			throw std::runtime_error("MeshletRenderer: only GL_TRIANGLES meshes can be clustered");
+		if (ranges.count(geometry))
+			continue;
+		if (!geometries.empty() && geometry->quantized != geometries.front()->quantized)
+			throw std::runtime_error("MeshletRenderer: all meshes must use the same vertex format");
+		ranges[geometry] = Range{};
+		geometries.push_back(geometry);
+	}
+	if (geometries.empty())
+		return;
+
+	bool quantized = geometries.front()->quantized;
+	size_t stride = geometries.front()->vertex_stride();
+
+	// per geometry: its EBO (all LODs), then its meshlet indices
+	size_t vertex_total = 0, index_total = 0, meshlet_total = 0;
+	for (MeshGeometry const* geometry : geometries) {
+		Range& range = ranges[geometry];
+		range.first_index = static_cast<GLuint>(index_total);
+		range.first_meshlet_index = static_cast<GLuint>(index_total + geometry->index_count);
+		range.base_vertex = static_cast<GLint>(vertex_total);
+		range.first_meshlet = static_cast<GLuint>(meshlet_total);
+		vertex_total += geometry->vertex_count;
+		index_total += geometry->index_count + geometry->meshlet_indices.size();
+		meshlet_total += geometry->meshlets.size();
+	}
+
+	glCreateBuffers(1, &VBO);
+	glCreateBuffers(1, &EBO);
+	glCreateBuffers(1, &meshlet_buffer);
+	glNamedBufferStorage(VBO, vertex_total * stride, nullptr, 0);
+	glNamedBufferStorage(EBO, index_total * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glNamedBufferStorage(meshlet_buffer, meshlet_total * sizeof(Meshlet), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	for (MeshGeometry const* geometry : geometries) {
+		Range const& range = ranges[geometry];
+		glCopyNamedBufferSubData(geometry->vbo(), VBO, 0, range.base_vertex * stride, geometry->vertex_count * stride);
+		glCopyNamedBufferSubData(geometry->ebo(), EBO, 0, range.first_index * sizeof(GLuint), geometry->index_count * sizeof(GLuint));
+		glNamedBufferSubData(EBO, range.first_meshlet_index * sizeof(GLuint), geometry->meshlet_indices.size() * sizeof(GLuint), geometry->meshlet_indices.data());
+		glNamedBufferSubData(meshlet_buffer, range.first_meshlet * sizeof(Meshlet), geometry->meshlets.size() * sizeof(Meshlet), geometry->meshlets.data());
+	}
+
+	glCreateVertexArrays(1, &VAO);
+	MeshGeometry::setup_vertex_format(VAO, shader.getID(), quantized);
+	glVertexArrayVertexBuffer(VAO, 0, VBO, 0, static_cast<GLsizei>(stride));
+	glVertexArrayElementBuffer(VAO, EBO);
+
+	glCreateBuffers(1, &object_buffer);
+	glCreateBuffers(1, &record_buffer);
+	glCreateBuffers(1, &command_buffer);
+	glCreateBuffers(1, &counter_buffer);
+	glNamedBufferStorage(counter_buffer, COUNTERS * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	size_t readback_bytes = READBACK_FRAMES * COUNTERS * sizeof(GLuint);
+	glCreateBuffers(1, &readback_buffer);
+	glNamedBufferStorage(readback_buffer, readback_bytes, nullptr, flags);
+	readback = static_cast<const GLuint*>(glMapNamedBufferRange(readback_buffer, 0, readback_bytes, flags));
+	if (!readback)
+		throw std::runtime_error("MeshletRenderer: can not map readback buffer");
+
+	indirect_count = GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters;
+
+	TextureSlots::setup_samplers(shader);
+
+	size_t triangles = 0;
+	for (MeshGeometry const* geometry : geometries)
+		triangles += geometry->meshlet_indices.size() / 3;
+	std::cout << "MeshletRenderer: " << meshes.size() << " meshes, " << meshlet_total << " meshlets, "
+		<< static_cast<float>(triangles) / meshlet_total << " triangles per meshlet"
+		<< (indirect_count ? "" : ", no indirect count, culled meshlets are submitted empty") << '\n';
+}
+
+void MeshletRenderer::draw(glm::vec3 const& camera_pos, glm::mat4 const& projection, glm::mat4 const& view_projection, float viewport_height, bool cull)
+{
+	if (VAO == 0)
+		return;
+
+	records.clear();
+	commands.clear();
+	objects.clear();
+	Stats totals;
+
+	for (Mesh* mesh : meshes) {
+		if (!mesh->visible)
+			continue;
+		mesh->select_lod(camera_pos, projection, viewport_height);
+		mesh->model_matrix = Mesh::compute_model_matrix(mesh->origin, mesh->orientation, mesh->size);
+
+		MeshGeometry const& geometry = *mesh->geometry;
+		Range const& range = ranges.at(&geometry);
+		GLuint record = static_cast<GLuint>(records.size());
+		records.push_back(DrawRecord{ mesh->model_matrix, mesh->diffuse_color, geometry.quantization.scale, textures.slot(mesh->texture_id),
+			geometry.quantization.offset, geometry.quantized ? 1 : 0 });
+
+		if (mesh->lod_level > 0) {
+			MeshLod const& lod = geometry.lod(mesh->lod_level);
+			commands.push_back(DrawElementsIndirectCommand{ lod.index_count, 1, range.first_index + lod.index_offset, range.base_vertex, record });
+			continue;
+		}
+
+		// planes of view_projection * model are the frustum in object space
+		MeshletObject object{};
+		Frustum frustum = Frustum::from_matrix(view_projection * mesh->model_matrix);
+		std::copy(frustum.planes.begin(), frustum.planes.end(), object.planes);
+		object.camera = glm::vec3(glm::inverse(mesh->model_matrix) * glm::vec4(camera_pos, 1.0f));
+		object.first_meshlet = range.first_meshlet;
+		object.meshlet_count = static_cast<GLuint>(geometry.meshlets.size());
+		object.first_index = range.first_meshlet_index;
+		object.base_vertex = range.base_vertex;
+		object.record = record;
+		objects.push_back(object);
+
+		totals.triangles += geometry.meshlet_indices.size() / 3;
+		totals.meshlets += geometry.meshlets.size();
+	}
+
+	// clusters follow the whole-LOD commands; fixed slots are used only without indirect count
+	GLuint cpu_commands = static_cast<GLuint>(commands.size());
+	GLuint command_total = cpu_commands;
+	GLuint most_meshlets = 0;
+	for (MeshletObject& object : objects) {
+		object.first_slot = command_total;
+		command_total += object.meshlet_count;
+		most_meshlets = std::max(most_meshlets, object.meshlet_count);
+	}
+	if (command_total == 0)
+		return;
+
+	uploadGrowing(record_buffer, record_capacity, records);
+	uploadGrowing(object_buffer, object_capacity, objects);
+	reserveGrowing(command_buffer, command_capacity, command_total, sizeof(DrawElementsIndirectCommand));
+	if (!commands.empty())
+		glNamedBufferSubData(command_buffer, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+	GLuint counters[COUNTERS] = { cpu_commands, 0, 0 };
+	glNamedBufferSubData(counter_buffer, 0, sizeof(counters), counters);
+
+	if (!objects.empty()) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, meshlet_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, object_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, counter_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, command_buffer);
+		cull_shader->activate();
+		cull_shader->setUniform(cull_location, cull ? 1 : 0);
+		cull_shader->setUniform(compact_location, indirect_count ? 1 : 0);
+		glDispatchCompute(static_cast<GLuint>((most_meshlets + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), static_cast<GLuint>(objects.size()), 1);
+		// commands and draw count read by the draw, counters copied to the readback buffer below
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	}
+
+	shader->activate();
+	shader->setUniform(gpu_culled_location, 0);
+	textures.bind();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, record_buffer);
+	GLState::get().bind_vertex_array(VAO);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+	if (indirect_count) {
+		glBindBuffer(GL_PARAMETER_BUFFER, counter_buffer);
+		if (GLEW_VERSION_4_6)
+			glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, static_cast<GLsizei>(command_total), 0);
+		else
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, static_cast<GLsizei>(command_total), 0);
+		glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	}
+	else
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(command_total), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	// counters of this frame to the readback slot, what was there before is read if the GPU is done with it
+	size_t slot = frame++ % READBACK_FRAMES;
+	read_stats(slot);
+	glCopyNamedBufferSubData(counter_buffer, readback_buffer, 0, slot * COUNTERS * sizeof(GLuint), COUNTERS * sizeof(GLuint));
+	pending[slot] = totals;
+	fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void MeshletRenderer::read_stats(size_t slot)
+{
+	if (!fences[slot])
+		return;
+	GLenum result = glClientWaitSync(fences[slot], 0, 0);
+	if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+		const GLuint* counters = readback + slot * COUNTERS;
+		last_stats = pending[slot];
+		last_stats.visible_triangles = counters[1];
+		last_stats.visible_meshlets = counters[2];
+	}
+	glDeleteSync(fences[slot]);
+	fences[slot] = nullptr;
+}
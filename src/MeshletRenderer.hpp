@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "GLBuffers.hpp"
+#include "IndirectRenderer.hpp"
+#include "ShaderProgram.hpp"
+
+// Draws big meshes cluster by cluster (Meshlets.hpp), culled on the GPU, with one multi-draw.
+// build() merges the geometry and the meshlet index lists into one VBO + EBO, like IndirectRenderer.
+// Every frame draw() uploads one record and one MeshletObject per mesh, cull_meshlets.comp writes a command
+// per cluster that is on screen and not facing away, and the number of them, for glMultiDrawElementsIndirectCount
+// (tex_indirect.vert/.frag draw them). Without indirect count every cluster has a command, culled ones draw nothing.
+// Clusters exist for LOD 0 only, meshes at a coarser LOD get one command for the whole level.
+// Meshes are referenced, not owned; meshes with visible == false are skipped.
+class MeshletRenderer {
+public:
+	using DrawRecord = IndirectRenderer::DrawRecord;
+	using DrawElementsIndirectCommand = IndirectRenderer::DrawElementsIndirectCommand;
+
+	// std430 layout of MeshletObject in cull_meshlets.comp
+	struct MeshletObject {
+		glm::vec4 planes[6];  // view frustum in object space
+		glm::vec3 camera;
+		GLuint first_meshlet;
+		GLuint meshlet_count;
+		GLuint first_index;
+		GLint base_vertex;
+		GLuint record;
+		GLuint first_slot;
+		GLuint pad[3];
+	};
+	static_assert(sizeof(MeshletObject) == 144, "MeshletObject must match std430 layout in cull_meshlets.comp");
+
+	// triangles and clusters of meshes drawn by clusters in one frame, and how many of them were drawn
+	struct Stats {
+		size_t triangles{ 0 };
+		size_t visible_triangles{ 0 };
+		size_t meshlets{ 0 };
+		size_t visible_meshlets{ 0 };
+
+		float culled_percent(void) const { return triangles ? 100.0f * (triangles - visible_triangles) / triangles : 0.0f; }
+	};
+
+	MeshletRenderer(void) = default;
+	MeshletRenderer(MeshletRenderer const&) = delete;
+	MeshletRenderer& operator=(MeshletRenderer const&) = delete;
+	~MeshletRenderer();
+
+	// meshes must have meshlets (MeshGeometry::build_meshlets), GL_TRIANGLES and one vertex format; throws std::runtime_error otherwise
+	void build(ShaderProgram& shader, ShaderProgram& cull_shader, std::vector<Mesh*> const& meshes);
+
+	// cull == false draws all clusters (for comparison)
+	void draw(glm::vec3 const& camera_pos, glm::mat4 const& projection, glm::mat4 const& view_projection, float viewport_height, bool cull);
+
+	// of a frame a few frames back, read without waiting for the GPU
+	Stats const& stats(void) const { return last_stats; }
+	size_t mesh_count(void) const { return meshes.size(); }
+
+	// delete GL buffers and forget the meshes, GL context must be current
+	void clear(void);
+
+private:
+	static constexpr size_t READBACK_FRAMES = 3;
+	static constexpr size_t COUNTERS = 3;  // draw_count, visible_triangles, visible_meshlets
+
+	struct Range {
+		GLuint first_index;    // of LOD 0 in the merged EBO
+		GLuint first_meshlet_index;
+		GLint base_vertex;
+		GLuint first_meshlet;  // in the meshlet buffer
+	};
+
+	ShaderProgram* shader{ nullptr };
+	ShaderProgram* cull_shader{ nullptr };
+	// uniform locations, resolved in build()
+	GLint gpu_culled_location{ -1 }, cull_location{ -1 }, compact_location{ -1 };
+	std::vector<Mesh*> meshes;
+	bool indirect_count{ false };
+
+	std::unordered_map<MeshGeometry const*, Range> ranges;
+	TextureSlots textures{ "MeshletRenderer" };
+
+	std::vector<DrawRecord> records;
+	std::vector<DrawElementsIndirectCommand> commands;  // written by the CPU, clusters follow
+	std::vector<MeshletObject> objects;
+
+	GLuint VAO{ 0 }, VBO{ 0 }, EBO{ 0 };
+	GLuint meshlet_buffer{ 0 }, object_buffer{ 0 }, record_buffer{ 0 }, command_buffer{ 0 }, counter_buffer{ 0 };
+	size_t object_capacity{ 0 }, record_capacity{ 0 }, command_capacity{ 0 };
+
+	// counters copied here every frame, read when the fence of the frame has passed
+	GLuint readback_buffer{ 0 };
+	const GLuint* readback{ nullptr };
+	std::array<GLsync, READBACK_FRAMES> fences{};
+	std::array<Stats, READBACK_FRAMES> pending{};
+	size_t frame{ 0 };
+	Stats last_stats;
+
+	void read_stats(size_t slot);
+};
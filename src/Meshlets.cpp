@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "Meshlets.hpp"
+
+namespace {
+	constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+}
+
+void buildMeshlets(const Vertex* vertices, size_t vertex_count, const GLuint* indices, size_t index_count,
+	std::vector<Meshlet>& meshlets, std::vector<GLuint>& meshlet_indices)
+{
+	meshlets.clear();
+	meshlet_indices.clear();
+	size_t triangle_count = index_count / 3;
+	if (triangle_count == 0)
+		return;
+	meshlet_indices.reserve(triangle_count * 3);
+
+	// triangles around each vertex
+	std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+		adjacency_offsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertex_count; v++)
+		adjacency_offsets[v + 1] += adjacency_offsets[v];
+	std::vector<uint32_t> adjacency(triangle_count * 3);
+	{
+		std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+		for (size_t i = 0; i < triangle_count * 3; i++)
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<glm::vec3> centroids(triangle_count);
+	for (size_t t = 0; t < triangle_count; t++)
+		centroids[t] = (vertices[indices[t * 3]].Position + vertices[indices[t * 3 + 1]].Position + vertices[indices[t * 3 + 2]].Position) / 3.0f;
+
+	// centroids bucketed in a uniform grid of about one cell per triangle over the bounds, for the nearby unused
+	// triangles of a meshlet that has no connected one left
+	glm::vec3 grid_min(std::numeric_limits<float>::max()), grid_max(-std::numeric_limits<float>::max());
+	for (glm::vec3 const& c : centroids) {
+		grid_min = glm::min(grid_min, c);
+		grid_max = glm::max(grid_max, c);
+	}
+	glm::vec3 extent = grid_max - grid_min;
+	int cells_per_axis = std::max(1, static_cast<int>(std::cbrt(static_cast<double>(triangle_count))));
+	float cell_size = std::max(std::max(extent.x, extent.y), std::max(extent.z, std::numeric_limits<float>::min())) / cells_per_axis;
+	glm::ivec3 grid_cells = glm::min(glm::ivec3(extent / cell_size) + 1, glm::ivec3(cells_per_axis));
+	auto cell_of = [&](glm::vec3 const& p) {
+		return glm::clamp(glm::ivec3((p - grid_min) / cell_size), glm::ivec3(0), grid_cells - 1);
+	};
+	auto cell_index = [&](glm::ivec3 const& c) { return (size_t(c.z) * grid_cells.y + c.y) * grid_cells.x + c.x; };
+	std::vector<uint32_t> cell_offsets(size_t(grid_cells.x) * grid_cells.y * grid_cells.z + 1, 0);
+	for (size_t t = 0; t < triangle_count; t++)
+		cell_offsets[cell_index(cell_of(centroids[t])) + 1]++;
+	for (size_t c = 1; c < cell_offsets.size(); c++)
+		cell_offsets[c] += cell_offsets[c - 1];
+	std::vector<uint32_t> cell_triangles(triangle_count);
+	{
+		std::vector<uint32_t> fill(cell_offsets.begin(), cell_offsets.end() - 1);
+		for (size_t t = 0; t < triangle_count; t++)
+			cell_triangles[fill[cell_index(cell_of(centroids[t]))]++] = static_cast<uint32_t>(t);
+	}
+
+	std::vector<bool> used(triangle_count, false);
+	std::vector<uint32_t> vertex_meshlet(vertex_count, NONE);  // meshlet a vertex was last added to
+	std::vector<uint32_t> meshlet_vertices;
+	meshlet_vertices.reserve(MESHLET_MAX_VERTICES);
+
+	size_t seed = 0;
+	while (true) {
+		while (seed < triangle_count && used[seed])
+			seed++;
+		if (seed == triangle_count)
+			break;
+
+		uint32_t id = static_cast<uint32_t>(meshlets.size());
+		Meshlet meshlet{};
+		meshlet.first_index = static_cast<GLuint>(meshlet_indices.size());
+		meshlet_vertices.clear();
+		glm::vec3 centroid_sum(0.0f);
+		glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+
+		auto new_vertices = [&](size_t t) {
+			unsigned n = 0;
+			for (int k = 0; k < 3; k++)
+				n += vertex_meshlet[indices[t * 3 + k]] != id;
+			return n;
+		};
+		auto add = [&](size_t t) {
+			used[t] = true;
+			for (int k = 0; k < 3; k++) {
+				GLuint v = indices[t * 3 + k];
+				if (vertex_meshlet[v] != id) {
+					vertex_meshlet[v] = id;
+					meshlet_vertices.push_back(v);
+					lo = glm::min(lo, vertices[v].Position);
+					hi = glm::max(hi, vertices[v].Position);
+				}
+				meshlet_indices.push_back(v);
+			}
+			centroid_sum += centroids[t];
+			meshlet.triangle_count++;
+		};
+
+		add(seed);
+		while (meshlet.triangle_count < MESHLET_MAX_TRIANGLES) {
+			// best unused neighbour: fewest new vertices, then nearest to the cluster center
+			glm::vec3 center = centroid_sum / static_cast<float>(meshlet.triangle_count);
+			uint32_t best = NONE;
+			unsigned best_new = 4;
+			float best_distance = std::numeric_limits<float>::max();
+			for (uint32_t v : meshlet_vertices)
+				for (uint32_t a = adjacency_offsets[v]; a < adjacency_offsets[v + 1]; a++) {
+					uint32_t t = adjacency[a];
+					if (used[t])
+						continue;
+					unsigned n = new_vertices(t);
+					if (meshlet_vertices.size() + n > MESHLET_MAX_VERTICES || n > best_new)
+						continue;
+					glm::vec3 d = centroids[t] - center;
+					float distance = glm::dot(d, d);
+					if (n < best_new || distance < best_distance) {
+						best = t;
+						best_new = n;
+						best_distance = distance;
+					}
+				}
+			if (best == NONE && meshlet_vertices.size() + 3 <= MESHLET_MAX_VERTICES) {
+				// no connected triangle left (surrounded by earlier meshlets, or an unwelded mesh): the nearest unused one
+				// with its centroid within 1.5 radii of the meshlet's bounds, so the sphere grows little and the cone stays narrow
+				glm::vec3 box_center = (lo + hi) * 0.5f;
+				float radius = glm::length(hi - lo) * 0.75f;
+				best_distance = radius * radius;
+				glm::ivec3 first = cell_of(box_center - radius), last = cell_of(box_center + radius);
+				for (int z = first.z; z <= last.z; z++)
+					for (int y = first.y; y <= last.y; y++)
+						for (int x = first.x; x <= last.x; x++) {
+							size_t c = cell_index(glm::ivec3(x, y, z));
+							for (uint32_t i = cell_offsets[c]; i < cell_offsets[c + 1]; i++) {
+								uint32_t t = cell_triangles[i];
+								if (used[t])
+									continue;
+								glm::vec3 d = centroids[t] - box_center;
+								float distance = glm::dot(d, d);
+								if (distance <= best_distance) {
+									best = t;
+									best_distance = distance;
+								}
+							}
+						}
+			}
+			if (best == NONE)
+				break;  // full, or nothing close enough left
+			add(best);
+		}
+
+		meshlet.vertex_count = static_cast<GLuint>(meshlet_vertices.size());
+		computeMeshletBounds(vertices, meshlet_indices, meshlet);
+		meshlets.push_back(meshlet);
+	}
+}
+
+void computeMeshletBounds(const Vertex* vertices, std::vector<GLuint> const& meshlet_indices, Meshlet& meshlet)
+{
+	GLuint first = meshlet.first_index, end = meshlet.first_index + meshlet.triangle_count * 3;
+
+	glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+	for (GLuint i = first; i < end; i++) {
+		lo = glm::min(lo, vertices[meshlet_indices[i]].Position);
+		hi = glm::max(hi, vertices[meshlet_indices[i]].Position);
+	}
+	meshlet.center = (lo + hi) * 0.5f;
+	float radius2 = 0.0f;
+	for (GLuint i = first; i < end; i++) {
+		glm::vec3 d = vertices[meshlet_indices[i]].Position - meshlet.center;
+		radius2 = std::max(radius2, glm::dot(d, d));
+	}
+	meshlet.radius = std::sqrt(radius2);
+
+	// cone: axis = mean face normal, half angle from the normal farthest from it
+	meshlet.cone_apex = meshlet.center;
+	meshlet.cone_axis = glm::vec3(0.0f);
+	meshlet.cone_cutoff = 1.0f;
+
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.triangle_count);
+	glm::vec3 normal_sum(0.0f);
+	for (GLuint i = first; i < end; i += 3) {
+		glm::vec3 const& a = vertices[meshlet_indices[i]].Position;
+		glm::vec3 n = glm::cross(vertices[meshlet_indices[i + 1]].Position - a, vertices[meshlet_indices[i + 2]].Position - a);
+		float length = glm::length(n);
+		normals.push_back(length > 0.0f ? n / length : glm::vec3(0.0f));  // degenerate: faces nowhere, ignored
+		normal_sum += normals.back();
+	}
+	float sum_length = glm::length(normal_sum);
+	if (sum_length == 0.0f)
+		return;
+	glm::vec3 axis = normal_sum / sum_length;
+
+	float min_dot = 1.0f;
+	for (glm::vec3 const& n : normals)
+		if (n != glm::vec3(0.0f))
+			min_dot = std::min(min_dot, glm::dot(n, axis));
+	if (min_dot <= 0.0f)
+		return;  // wider than a half space, some triangle always faces the camera
+
+	// apex behind all triangle planes along the axis, so the test holds for cameras anywhere, not only far away
+	float max_t = 0.0f;
+	for (size_t t = 0; t < normals.size(); t++) {
+		if (normals[t] == glm::vec3(0.0f))
+			continue;
+		glm::vec3 const& p = vertices[meshlet_indices[first + t * 3]].Position;
+		max_t = std::max(max_t, glm::dot(meshlet.center - p, normals[t]) / glm::dot(axis, normals[t]));
+	}
+	meshlet.cone_apex = meshlet.center - axis * max_t;
+	meshlet.cone_axis = axis;
+	meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
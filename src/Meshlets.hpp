@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+
+// Meshlets: small clusters of triangles that can be culled on their own (MeshletRenderer, cull_meshlets.comp).
+// Each has a bounding sphere for frustum tests and a normal cone for back-face tests of the whole cluster.
+
+constexpr size_t MESHLET_MAX_VERTICES = 64;
+constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+// smaller meshes are drawn whole, their clusters would be too few to pay for the culling
+constexpr size_t MESHLET_MIN_TRIANGLES = 4096;
+
+// std430 layout of Meshlet in cull_meshlets.comp; all in mesh (object) space
+struct Meshlet {
+	glm::vec3 center;     // bounding sphere
+	float radius;
+	glm::vec3 cone_apex;  // every triangle faces away from camera c if dot(normalize(cone_apex - c), cone_axis) >= cone_cutoff
+	float cone_cutoff;    // 1 = cone too wide, never back-facing as a whole
+	glm::vec3 cone_axis;
+	GLuint first_index;   // into the meshlet index list, 3 per triangle
+	GLuint triangle_count;
+	GLuint vertex_count;  // distinct vertices
+	GLuint pad[2];
+};
+static_assert(sizeof(Meshlet) == 64, "Meshlet must match std430 layout in cull_meshlets.comp");
+
+// Split an indexed triangle list into meshlets of at most MESHLET_MAX_VERTICES / MESHLET_MAX_TRIANGLES.
+// Clusters grow over shared vertices (fewest new vertices, then nearest to the cluster), then over unused
+// triangles close to their bounds, so they stay compact and their normal cones narrow. meshlet_indices gets the triangles reordered cluster by cluster,
+// still indexing the original vertices.
+void buildMeshlets(const Vertex* vertices, size_t vertex_count, const GLuint* indices, size_t index_count,
+	std::vector<Meshlet>& meshlets, std::vector<GLuint>& meshlet_indices);
+
+// bounding sphere and normal cone of triangles [first_index, first_index + 3 * triangle_count) of meshlet_indices
+void computeMeshletBounds(const Vertex* vertices, std::vector<GLuint> const& meshlet_indices, Meshlet& meshlet);
@@ -1,129 +1,400 @@
 #include <string>
 #include <algorithm>
+#include <cstdint>
+#include <charconv>
+#include <chrono>
+#include <thread>
 #include <GL/glew.h> 
 #include <glm/glm.hpp>
 #include <iostream>
 
 #include "OBJloader.hpp"
+#include "MappedFile.hpp"
+#include "MeshCache.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
 #include "Vertex.h"
 
-#define MAX_LINE_SIZE 255
+// chunks smaller than this are not worth a thread
+#define MIN_CHUNK_SIZE (256 * 1024)
 
-//bool loadOBJ(const char * path, std::vector < glm::vec3 > & out_vertices, std::vector < glm::vec2 > & out_uvs, std::vector < glm::vec3 > & out_normals)
-bool loadOBJ(const char* path, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
-{
-	std::cout << "Loading model: " << path << std::endl;
-	//std::vector< unsigned int > vertexIndices, uvIndices, normalIndices;
-	std::vector< glm::vec3 > temp_vertices;
-	std::vector< glm::vec2 > temp_uvs;
-	std::vector< glm::vec3 > temp_normals;
+namespace {
+	// Open-addressing (linear probing) index used to weld face corners into unique vertices.
+	// Capacity is always a power of two and kept at most half full.
+	// Corners are first looked up by their (position, normal, uv) index triple, which is cheap
+	// to hash; a new triple is then looked up by vertex value, so that identical vertices
+	// referenced through different indices are still merged exactly like before.
+	class VertexWelder {
+	public:
+		VertexWelder(std::vector<Vertex>& vertices) : vertices(vertices) {
+			resize(triples, 1024);
+			values.assign(1024, EMPTY);
+		}
 
-	//std::vector<Vertex> vertices;
-	//std::vector<GLuint> indices;
+		GLuint weld(unsigned int v, unsigned int vt, unsigned int vn, Vertex const& vertex) {
+			if ((triple_count + 1) * 2 > triples.size())
+				grow_triples();
 
-	vertices.clear();
-	indices.clear();
+			size_t mask = triples.size() - 1;
+			size_t slot = hash_triple(v, vt, vn) & mask;
+			while (triples[slot].index != EMPTY) {
+				Triple& t = triples[slot];
+				if (t.v == v && t.vt == vt && t.vn == vn)
+					return t.index;
+				slot = (slot + 1) & mask;
+			}
 
-	//out_vertices.clear();
-	//out_uvs.clear();
-	//out_normals.clear();
+			GLuint index = weld_value(vertex);
+			triples[slot] = { v, vt, vn, index };
+			triple_count++;
+			return index;
+		}
 
-	FILE * file;
-	fopen_s(&file, path, "r");
-	if (file == NULL) {
-		printf("Impossible to open the file !\n");
-		return false;
-	}
+	private:
+		static constexpr GLuint EMPTY = ~GLuint(0);
+
+		struct Triple {
+			unsigned int v, vt, vn;
+			GLuint index;
+		};
 
-	while (1) {
+		std::vector<Vertex>& vertices;
+		std::vector<Triple> triples;
+		std::vector<GLuint> values; // indices into vertices
+		size_t triple_count = 0;
 
-		char lineHeader[MAX_LINE_SIZE];
-		int res = fscanf_s(file, "%s", lineHeader, MAX_LINE_SIZE);
-		if (res == EOF) {
-			break;
+		static size_t hash_triple(unsigned int v, unsigned int vt, unsigned int vn) {
+			std::uint64_t h = v * 0x9E3779B97F4A7C15ull;
+			h ^= vt * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+			h ^= vn * 0x165667B19E3779F9ull + (h >> 32);
+			return static_cast<size_t>(h ^ (h >> 31));
 		}
 
-		if (strcmp(lineHeader, "v") == 0) {
-			glm::vec3 vertex;
-			fscanf_s(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-			temp_vertices.push_back(vertex);
+		static void resize(std::vector<Triple>& table, size_t capacity) {
+			table.assign(capacity, Triple{ 0, 0, 0, EMPTY });
 		}
-		else if (strcmp(lineHeader, "vt") == 0) {
-			glm::vec2 uv;
-			fscanf_s(file, "%f %f\n", &uv.x, &uv.y);
-			temp_uvs.push_back(uv);
+
+		GLuint weld_value(Vertex const& corner) {
+			Vertex vertex = canonicalZeros(corner);
+			if ((vertices.size() + 1) * 2 > values.size())
+				grow_values();
+
+			size_t mask = values.size() - 1;
+			size_t slot = VertexHash()(vertex) & mask;
+			while (values[slot] != EMPTY) {
+				if (VertexBitwiseEqual()(vertices[values[slot]], vertex))
+					return values[slot];
+				slot = (slot + 1) & mask;
+			}
+
+			GLuint index = static_cast<GLuint>(vertices.size());
+			vertices.push_back(vertex);
+			values[slot] = index;
+			return index;
+		}
+
+		void grow_triples() {
+			std::vector<Triple> old;
+			old.swap(triples);
+			resize(triples, old.size() * 2);
+			size_t mask = triples.size() - 1;
+			for (Triple const& t : old) {
+				if (t.index == EMPTY)
+					continue;
+				size_t slot = hash_triple(t.v, t.vt, t.vn) & mask;
+				while (triples[slot].index != EMPTY)
+					slot = (slot + 1) & mask;
+				triples[slot] = t;
+			}
+		}
+
+		void grow_values() {
+			values.assign(values.size() * 2, EMPTY);
+			size_t mask = values.size() - 1;
+			for (GLuint i = 0; i < vertices.size(); i++) {
+				size_t slot = VertexHash()(vertices[i]) & mask;
+				while (values[slot] != EMPTY)
+					slot = (slot + 1) & mask;
+				values[slot] = i;
+			}
 		}
-		else if (strcmp(lineHeader, "vn") == 0) {
-			glm::vec3 normal;
-			fscanf_s(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-			temp_normals.push_back(normal);
+	};
+
+	// one face corner; indices are 0-based, or relative to the end of the chunk's own arrays
+	// when the file used negative (relative) indices, see RELATIVE
+	struct Corner {
+		std::int64_t v, vt, vn;
+	};
+
+	constexpr std::int64_t RELATIVE = std::int64_t(1) << 62;
+
+	// everything parsed from one line-aligned part of the file
+	struct Chunk {
+		const char* begin;
+		const char* end;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> uvs;
+		std::vector<glm::vec3> normals;
+		std::vector<Corner> corners; // 3 per triangle
+		std::string error;
+	};
+
+	inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+	inline const char* skip_blank(const char* p, const char* end) {
+		while (p < end && is_blank(*p))
+			p++;
+		return p;
+	}
+
+	inline const char* skip_line(const char* p, const char* end) {
+		while (p < end && *p != '\n')
+			p++;
+		return p < end ? p + 1 : end;
+	}
+
+	template <int N>
+	bool parse_floats(const char*& p, const char* end, float* out) {
+		for (int i = 0; i < N; i++) {
+			p = skip_blank(p, end);
+			auto res = std::from_chars(p, end, out[i]);
+			if (res.ec != std::errc())
+				return false;
+			p = res.ptr;
 		}
-		else if (strcmp(lineHeader, "f") == 0) {
-			std::string vertex1, vertex2, vertex3;
-			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-			int matches = fscanf_s(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
-			if (matches != 9) {
-				printf("File can't be read by simple parser :( Try exporting with other options\n");
+		return true;
+	}
+
+	// OBJ index to 0-based absolute index, or to RELATIVE-tagged offset from the current array end
+	inline std::int64_t resolve(std::int64_t idx, size_t count) {
+		if (idx > 0)
+			return idx - 1;
+		return RELATIVE + static_cast<std::int64_t>(count) + idx;
+	}
+
+	bool parse_corner(const char*& p, const char* end, Chunk& c, Corner& out) {
+		std::int64_t idx[3];
+		for (int i = 0; i < 3; i++) {
+			if (i > 0) {
+				if (p >= end || *p != '/')
+					return false;
+				p++;
+			}
+			auto res = std::from_chars(p, end, idx[i]);
+			if (res.ec != std::errc() || idx[i] == 0)
 				return false;
+			p = res.ptr;
+		}
+		out.v = resolve(idx[0], c.positions.size());
+		out.vt = resolve(idx[1], c.uvs.size());
+		out.vn = resolve(idx[2], c.normals.size());
+		return true;
+	}
+
+	void parse_chunk(Chunk& c) {
+		const char* p = c.begin;
+		const char* end = c.end;
+		std::vector<Corner> polygon;
+
+		while (p < end) {
+			p = skip_blank(p, end);
+			const char* line = p;
+
+			if (p + 1 < end && p[0] == 'v' && is_blank(p[1])) {
+				glm::vec3 vertex;
+				p += 1;
+				if (!parse_floats<3>(p, end, &vertex.x)) {
+					c.error = "bad vertex: " + std::string(line, skip_line(line, end));
+					return;
+				}
+				c.positions.push_back(vertex);
 			}
-			//vertexIndices.push_back(vertexIndex[0]);
-			//vertexIndices.push_back(vertexIndex[1]);
-			//vertexIndices.push_back(vertexIndex[2]);
-			//uvIndices.push_back(uvIndex[0]);
-			//uvIndices.push_back(uvIndex[1]);
-			//uvIndices.push_back(uvIndex[2]);
-			//normalIndices.push_back(normalIndex[0]);
-			//normalIndices.push_back(normalIndex[1]);
-			//normalIndices.push_back(normalIndex[2]);
-
-			for (int i = 0; i < 3; i++) {
-				GLuint currentIndex;
-				Vertex currentVertex;
-				currentVertex.Position = temp_vertices[vertexIndex[i]-1];
-				currentVertex.Normal = temp_normals[normalIndex[i]-1];
-				currentVertex.TexCoords = temp_uvs[uvIndex[i]-1];
-
-				auto t = std::find_if(vertices.begin(),
-					vertices.end(),
-					[&currentVertex]
-					(const Vertex& v2) -> bool {
-						return (currentVertex == v2);
-					});
-				if (t == vertices.end()) {
-					vertices.push_back(currentVertex);
-					currentIndex = vertices.size() - 1;
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && is_blank(p[2])) {
+				glm::vec2 uv;
+				p += 2;
+				if (!parse_floats<2>(p, end, &uv.x)) {
+					c.error = "bad texture coordinate: " + std::string(line, skip_line(line, end));
+					return;
 				}
-				else {
-					currentIndex = t - vertices.begin();
+				c.uvs.push_back(uv);
+			}
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && is_blank(p[2])) {
+				glm::vec3 normal;
+				p += 2;
+				if (!parse_floats<3>(p, end, &normal.x)) {
+					c.error = "bad normal: " + std::string(line, skip_line(line, end));
+					return;
+				}
+				c.normals.push_back(normal);
+			}
+			else if (p + 1 < end && p[0] == 'f' && is_blank(p[1])) {
+				p += 1;
+				polygon.clear();
+				while (true) {
+					p = skip_blank(p, end);
+					if (p >= end || *p == '\n' || *p == '#')
+						break;
+					Corner corner;
+					if (!parse_corner(p, end, c, corner)) {
+						c.error = "File can't be read by simple parser :( Try exporting with other options (v/vt/vn faces needed): "
+							+ std::string(line, skip_line(line, end));
+						return;
+					}
+					polygon.push_back(corner);
 				}
-				indices.push_back(currentIndex);
+				if (polygon.size() < 3) {
+					c.error = "face with less than 3 vertices: " + std::string(line, skip_line(line, end));
+					return;
+				}
+				// triangle fan for polygons
+				for (size_t i = 1; i + 1 < polygon.size(); i++)
+					c.corners.insert(c.corners.end(), { polygon[0], polygon[i], polygon[i + 1] });
+			}
+			// anything else (comments, o, g, s, usemtl, mtllib...) is ignored
+			p = skip_line(p, end);
+		}
+	}
+
+	// split [begin, end) into at most `count` parts, each ending just after a newline
+	std::vector<Chunk> split_chunks(const char* begin, const char* end, size_t count) {
+		std::vector<Chunk> chunks;
+		const size_t size = end - begin;
+		const char* p = begin;
+		for (size_t i = 1; i <= count && p < end; i++) {
+			const char* e = (i == count) ? end : skip_line(begin + size * i / count, end);
+			if (e <= p)
+				continue;
+			Chunk c;
+			c.begin = p;
+			c.end = e;
+			chunks.push_back(std::move(c));
+			p = e;
+		}
+		return chunks;
+	}
+
+	// chunk-relative corner index to index into the merged array
+	inline bool to_global(std::int64_t idx, size_t chunk_offset, size_t total, size_t& out) {
+		if (idx >= RELATIVE / 2)
+			idx = idx - RELATIVE + static_cast<std::int64_t>(chunk_offset);
+		if (idx < 0 || static_cast<size_t>(idx) >= total)
+			return false;
+		out = static_cast<size_t>(idx);
+		return true;
+	}
+}
+
+bool loadOBJ(const char* path, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	std::cout << "Loading model: " << path << std::endl;
+	auto start = std::chrono::steady_clock::now();
+
+	vertices.clear();
+	indices.clear();
+
+	{
+		MeshData cached;
+		if (openMeshCache(path, cached)) {
+			MeshLod const& lod0 = cached.lods()[0];
+			vertices.assign(cached.vertices(), cached.vertices() + cached.vertex_count());
+			indices.assign(cached.indices() + lod0.index_offset, cached.indices() + lod0.index_offset + lod0.index_count);
+			std::cout << "Model loaded from cache: " << meshCachePath(path).string() << std::endl;
+			return true;
+		}
+	}
+
+	MappedFile file(path);
+	if (!file.is_open()) {
+		std::cerr << "Impossible to open the file: " << path << '\n';
+		return false;
+	}
+
+	// parse line-aligned chunks in parallel
+	size_t hw_threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t chunk_count = std::max<size_t>(1, std::min(hw_threads, file.size() / MIN_CHUNK_SIZE));
+	std::vector<Chunk> chunks = split_chunks(file.data(), file.data() + file.size(), chunk_count);
+
+	if (chunks.size() == 1) {
+		parse_chunk(chunks[0]);
+	}
+	else {
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < chunks.size(); i++)
+			workers.emplace_back(parse_chunk, std::ref(chunks[i]));
+		parse_chunk(chunks[0]);
+		for (auto& w : workers)
+			w.join();
+	}
+
+	for (auto const& c : chunks) {
+		if (!c.error.empty()) {
+			std::cerr << "Error loading " << path << ": " << c.error << '\n';
+			return false;
+		}
+	}
+
+	// merge v/vt/vn arrays in file order
+	std::vector<glm::vec3> temp_vertices;
+	std::vector<glm::vec2> temp_uvs;
+	std::vector<glm::vec3> temp_normals;
+	size_t corner_count = 0;
+	for (auto const& c : chunks) {
+		temp_vertices.insert(temp_vertices.end(), c.positions.begin(), c.positions.end());
+		temp_uvs.insert(temp_uvs.end(), c.uvs.begin(), c.uvs.end());
+		temp_normals.insert(temp_normals.end(), c.normals.begin(), c.normals.end());
+		corner_count += c.corners.size();
+	}
+
+	// weld face corners into unique vertices
+	indices.reserve(corner_count);
+	VertexWelder welder(vertices);
+	size_t v_offset = 0, vt_offset = 0, vn_offset = 0;
+	for (auto const& c : chunks) {
+		for (Corner const& corner : c.corners) {
+			size_t v, vt, vn;
+			if (!to_global(corner.v, v_offset, temp_vertices.size(), v)
+				|| !to_global(corner.vt, vt_offset, temp_uvs.size(), vt)
+				|| !to_global(corner.vn, vn_offset, temp_normals.size(), vn)) {
+				std::cerr << "Error loading " << path << ": face index out of range\n";
+				vertices.clear();
+				indices.clear();
+				return false;
 			}
 
+			Vertex currentVertex;
+			currentVertex.Position = temp_vertices[v];
+			currentVertex.Normal = temp_normals[vn];
+			currentVertex.TexCoords = temp_uvs[vt];
+
+			GLuint currentIndex = welder.weld(static_cast<unsigned int>(v), static_cast<unsigned int>(vt), static_cast<unsigned int>(vn), currentVertex);
+			indices.push_back(currentIndex);
 		}
+		v_offset += c.positions.size();
+		vt_offset += c.uvs.size();
+		vn_offset += c.normals.size();
 	}
 
-	// unroll from indirect to direct vertex specification
-	// sometimes not necessary, definitely not optimal
-
-	//for (unsigned int u = 0; u < vertexIndices.size(); u++) {
-	//	unsigned int vertexIndex = vertexIndices[u];
-	//	glm::vec3 vertex = temp_vertices[vertexIndex - 1];
-	//	out_vertices.push_back(vertex);
-	//}
-	//for (unsigned int u = 0; u < uvIndices.size(); u++) {
-	//	unsigned int uvIndex = uvIndices[u];
-	//	glm::vec2 uv = temp_uvs[uvIndex - 1];
-	//	out_uvs.push_back(uv);
-	//}
-	//for (unsigned int u = 0; u < normalIndices.size(); u++) {
-	//	unsigned int normalIndex = normalIndices[u];
-	//	glm::vec3 normal = temp_normals[normalIndex - 1];
-	//	out_normals.push_back(normal);
-	//}
-
-	
-	std::cout << "Model loaded: " << path << std::endl;
-
-	fclose(file);
+	// throughput counter
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double megabytes = file.size() / (1024.0 * 1024.0);
+	size_t faces = indices.size() / 3;
+	std::cout << "Model loaded: " << path << " (" << megabytes << " MB, " << faces << " faces, "
+		<< vertices.size() << " vertices, " << chunks.size() << " threads) in " << seconds * 1000.0 << " ms: "
+		<< megabytes / std::max(seconds, 1e-9) << " MB/s, " << faces / std::max(seconds, 1e-9) << " faces/s" << std::endl;
+
+	// GPU friendly triangle and vertex order, the cache stores the optimized mesh
+	optimizeMesh(path, vertices, indices);
+
+	// LOD chain is baked into the cache only, the caller gets level 0
+	std::vector<GLuint> lod_indices;
+	std::vector<MeshLod> lods = buildLodChain(vertices, indices, lod_indices);
+	std::cout << "LODs: " << path;
+	for (MeshLod const& lod : lods)
+		std::cout << " [" << lod.index_count / 3 << " faces, error " << lod.error << "]";
+	std::cout << std::endl;
+
+	if (!writeMeshCache(path, hashBytes(file.data(), file.size()), vertices, lod_indices, lods))
+		std::cerr << "WARN: can not write mesh cache: " << meshCachePath(path).string() << '\n';
+
 	return true;
 }
@@ -7,6 +7,8 @@
 
 #include "Vertex.h"
 
+// parse OBJ (v/vt/vn triangles or polygons) into welded vertices and indices;
+// uses and refreshes the binary cache next to the file, see MeshCache.hpp
 bool loadOBJ(
 	const char * path,
 	std::vector <Vertex> & vertices,
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include <emmintrin.h>
+
+#include "OcclusionCuller.hpp"
+
+void OcclusionCuller::set_occluder(std::vector<glm::vec3> vertices, std::vector<uint32_t> indices)
+{
+	this->vertices = std::move(vertices);
+	this->indices = std::move(indices);
+}
+
+void OcclusionCuller::render(glm::mat4 const& view_projection)
+{
+	this->view_projection = view_projection;
+	std::fill(depth_buffer.begin(), depth_buffer.end(), 1.0f);
+	rasterized = 0;
+
+	clip.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+		clip[i] = view_projection * glm::vec4(vertices[i], 1.0f);
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		glm::vec4 const& a = clip[indices[i]];
+		glm::vec4 const& b = clip[indices[i + 1]];
+		glm::vec4 const& c = clip[indices[i + 2]];
+
+		// trivial reject: all three outside the same side plane or behind the near plane
+		if ((a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+			(a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+			(a.z > a.w && b.z > b.w && c.z > c.w))
+			continue;
+
+		// near plane z = -w: clip the triangle, giving up to 4 vertices
+		float da = a.z + a.w, db = b.z + b.w, dc = c.z + c.w;
+		if (da >= 0.0f && db >= 0.0f && dc >= 0.0f) {
+			rasterize(a, b, c);
+			continue;
+		}
+		if (da < 0.0f && db < 0.0f && dc < 0.0f)
+			continue;
+
+		glm::vec4 in[3] = { a, b, c };
+		float d[3] = { da, db, dc };
+		glm::vec4 out[4];
+		int n = 0;
+		for (int k = 0; k < 3; k++) {
+			int next = (k + 1) % 3;
+			if (d[k] >= 0.0f)
+				out[n++] = in[k];
+			if ((d[k] >= 0.0f) != (d[next] >= 0.0f))
+				out[n++] = glm::mix(in[k], in[next], d[k] / (d[k] - d[next]));
+		}
+		for (int k = 1; k + 1 < n; k++)
+			rasterize(out[0], out[k], out[k + 1]);
+	}
+
+	// farthest depth per tile, lets visible() skip whole tiles
+	for (int ty = 0; ty < TILES_Y; ty++)
+		for (int tx = 0; tx < TILES_X; tx++) {
+			__m128 m = _mm_setzero_ps();
+			for (int y = ty * TILE; y < (ty + 1) * TILE; y++)
+				for (int x = tx * TILE; x < (tx + 1) * TILE; x += 4)
+					m = _mm_max_ps(m, _mm_loadu_ps(&depth_buffer[y * WIDTH + x]));
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, m);
+			tile_max[ty * TILES_X + tx] = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+		}
+}
+
+void OcclusionCuller::rasterize(glm::vec4 const& a, glm::vec4 const& b, glm::vec4 const& c)
+{
+	auto to_screen = [](glm::vec4 const& v) {
+		glm::vec3 ndc = glm::vec3(v) / v.w;
+		return glm::vec3((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT, ndc.z * 0.5f + 0.5f);
+	};
+	rasterize_screen(to_screen(a), to_screen(b), to_screen(c));
+}
+
+void OcclusionCuller::rasterize_screen(glm::vec3 const& a, glm::vec3 const& b_in, glm::vec3 const& c_in)
+{
+	glm::vec3 b = b_in, c = c_in;
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (std::abs(area) < 1e-6f)
+		return;
+	if (area < 0.0f) {  // both windings are occluders
+		std::swap(b, c);
+		area = -area;
+	}
+
+	int x_min = std::max(0, static_cast<int>(std::floor(std::min(a.x, std::min(b.x, c.x)))));
+	int x_max = std::min(WIDTH - 1, static_cast<int>(std::ceil(std::max(a.x, std::max(b.x, c.x)))));
+	int y_min = std::max(0, static_cast<int>(std::floor(std::min(a.y, std::min(b.y, c.y)))));
+	int y_max = std::min(HEIGHT - 1, static_cast<int>(std::ceil(std::max(a.y, std::max(b.y, c.y)))));
+	if (x_min > x_max || y_min > y_max)
+		return;
+	rasterized++;
+
+	// edge functions E(x, y) = A x + B y + C, >= 0 inside
+	glm::vec3 const* v[3] = { &a, &b, &c };
+	float A[3], B[3], C[3];
+	for (int k = 0; k < 3; k++) {
+		glm::vec3 const& p = *v[k];
+		glm::vec3 const& q = *v[(k + 1) % 3];
+		A[k] = -(q.y - p.y);
+		B[k] = q.x - p.x;
+		C[k] = -(A[k] * p.x + B[k] * p.y);
+	}
+	// depth plane from barycentrics: weight of b is E(c, a) / area, weight of c is E(a, b) / area
+	float zx = (A[2] * (b.z - a.z) + A[0] * (c.z - a.z)) / area;
+	float zy = (B[2] * (b.z - a.z) + B[0] * (c.z - a.z)) / area;
+	float z0 = a.z - zx * a.x - zy * a.y;
+
+	const __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	for (int y = y_min; y <= y_max; y++) {
+		float py = y + 0.5f;
+		__m128 row0 = _mm_set1_ps(B[0] * py + C[0]);
+		__m128 row1 = _mm_set1_ps(B[1] * py + C[1]);
+		__m128 row2 = _mm_set1_ps(B[2] * py + C[2]);
+		__m128 zrow = _mm_set1_ps(zy * py + z0);
+		float* line = &depth_buffer[y * WIDTH];
+
+		for (int x = x_min & ~3; x <= x_max; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane_offsets);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[0]), px), row0);
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[1]), px), row1);
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[2]), px), row2);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zx), px), zrow);
+			z = _mm_max_ps(z, zero);
+			__m128 old = _mm_loadu_ps(line + x);
+			__m128 nearer = _mm_min_ps(old, z);
+			_mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+		}
+	}
+}
+
+bool OcclusionCuller::visible(BoundingBox const& box) const
+{
+	glm::vec2 screen_min(std::numeric_limits<float>::max()), screen_max(-std::numeric_limits<float>::max());
+	float nearest = 1.0f;
+	for (int i = 0; i < 8; i++) {
+		glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+		glm::vec4 p = view_projection * glm::vec4(corner, 1.0f);
+		if (p.z < -p.w || p.w <= 0.0f)
+			return true;  // crosses the near plane, too close to be hidden
+		glm::vec3 ndc = glm::vec3(p) / p.w;
+		glm::vec2 s((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT);
+		screen_min = glm::min(screen_min, s);
+		screen_max = glm::max(screen_max, s);
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+
+	int x_min = std::max(0, static_cast<int>(std::floor(screen_min.x)));
+	int x_max = std::min(WIDTH - 1, static_cast<int>(std::floor(screen_max.x)));
+	int y_min = std::max(0, static_cast<int>(std::floor(screen_min.y)));
+	int y_max = std::min(HEIGHT - 1, static_cast<int>(std::floor(screen_max.y)));
+	if (x_min > x_max || y_min > y_max)
+		return true;  // off screen, frustum culling decides
+
+	for (int ty = y_min / TILE; ty <= y_max / TILE; ty++)
+		for (int tx = x_min / TILE; tx <= x_max / TILE; tx++) {
+			if (tile_max[ty * TILES_X + tx] <= nearest)
+				continue;  // whole tile is in front of the box
+			int y_end = std::min(y_max, (ty + 1) * TILE - 1);
+			int x_end = std::min(x_max, (tx + 1) * TILE - 1);
+			for (int y = std::max(y_min, ty * TILE); y <= y_end; y++)
+				for (int x = std::max(x_min, tx * TILE); x <= x_end; x++)
+					if (depth_buffer[y * WIDTH + x] > nearest)
+						return true;
+		}
+	return false;
+}
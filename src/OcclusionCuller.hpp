@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.hpp"
+
+// Software occlusion culling on a small CPU depth buffer, no GL involved.
+// render() rasterizes the occluder triangles (4 pixels at a time with SSE) keeping the nearest depth,
+// then reduces the buffer to the farthest depth per 8x8 tile. visible() rejects a box whose nearest
+// projected point is behind the occluder depth in every pixel of its screen rectangle.
+//
+// Occluders must lie inside what they stand for (e.g. terrain below the real surface), otherwise
+// objects can be culled wrongly. Only pixels whose center is covered are written, which shrinks occluders further.
+// render() and visible() may run on a worker thread; nothing else may use the culler meanwhile.
+class OcclusionCuller {
+public:
+	static constexpr int WIDTH = 256;   // multiple of TILE
+	static constexpr int HEIGHT = 128;
+	static constexpr int TILE = 8;
+
+	// world space triangles, kept until the next call
+	void set_occluder(std::vector<glm::vec3> vertices, std::vector<uint32_t> indices);
+
+	void render(glm::mat4 const& view_projection);
+
+	// box in world space; anything crossing the near plane is visible
+	bool visible(BoundingBox const& box) const;
+
+	size_t triangles_rasterized(void) const { return rasterized; }
+	// [0,1] depth, 1 = far plane / nothing; for debugging
+	float depth(int x, int y) const { return depth_buffer[y * WIDTH + x]; }
+
+private:
+	static constexpr int TILES_X = WIDTH / TILE;
+	static constexpr int TILES_Y = HEIGHT / TILE;
+
+	std::vector<glm::vec3> vertices;
+	std::vector<uint32_t> indices;
+
+	glm::mat4 view_projection{ 1.0f };
+	std::vector<float> depth_buffer = std::vector<float>(WIDTH * HEIGHT, 1.0f);
+	std::vector<float> tile_max = std::vector<float>(TILES_X * TILES_Y, 1.0f);
+	std::vector<glm::vec4> clip;  // transformed vertices
+	size_t rasterized{ 0 };
+
+	void rasterize(glm::vec4 const& a, glm::vec4 const& b, glm::vec4 const& c);
+	void rasterize_screen(glm::vec3 const& a, glm::vec3 const& b, glm::vec3 const& c);
+};
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <array>
+
+#include "RenderQueue.hpp"
+#include "GLState.hpp"
+
+void RenderQueue::begin(glm::vec3 const& camera_pos, float max_distance)
+{
+	this->camera_pos = camera_pos;
+	depth_scale = max_distance > 0.0f ? DEPTH_MAX / max_distance : 0.0f;
+	items.clear();
+	commands.clear();
+}
+
+uint64_t RenderQueue::quantize_depth(glm::vec3 const& position) const
+{
+	float depth = glm::distance(camera_pos, position) * depth_scale;  // one sqrt per draw, not per comparison
+	return depth >= float(DEPTH_MAX) ? DEPTH_MAX : uint64_t(depth);
+}
+
+uint64_t RenderQueue::make_key(Pass pass, GLuint shader, GLuint texture, GLuint vao, uint64_t depth)
+{
+	uint64_t state = (uint64_t(shader & 0xFFu) << 24) | (uint64_t(texture & 0xFFFu) << 12) | uint64_t(vao & 0xFFFu);
+
+	if (pass == Pass::OPAQUE_PASS)
+		return (uint64_t(pass) << 62) | (state << 30) | depth;
+	return (uint64_t(pass) << 62) | ((DEPTH_MAX - depth) << 38) | (state << 6);
+}
+
+void RenderQueue::push(uint64_t key, Command command)
+{
+	items.push_back(Item{ key, static_cast<uint32_t>(commands.size()) });
+	commands.push_back(command);
+}
+
+void RenderQueue::add(Mesh& mesh)
+{
+	if (!mesh.geometry || !mesh.visible)
+		return;
+	Pass pass = mesh.transparent ? Pass::TRANSPARENT_PASS : Pass::OPAQUE_PASS;
+	push(make_key(pass, mesh.shader.getID(), mesh.texture_id, mesh.geometry->vao(), quantize_depth(mesh.world_sphere.center)), Command{ &mesh, nullptr });
+}
+
+void RenderQueue::add(InstancedMesh& group)
+{
+	if (!group.geometry || group.count() == 0 || !group.visible)
+		return;
+	Pass pass = group.transparent ? Pass::TRANSPARENT_PASS : Pass::OPAQUE_PASS;
+	GLuint texture = group.texture ? group.texture->id : 0;
+	push(make_key(pass, group.shader.getID(), texture, group.geometry->vao(), 0), Command{ nullptr, &group });
+}
+
+void RenderQueue::sort(void)
+{
+	size_t n = items.size();
+	if (n < 2)
+		return;
+	scratch.resize(n);
+
+	// all 8 histograms in one read
+	std::array<std::array<uint32_t, 256>, 8> histograms{};
+	for (Item const& item : items)
+		for (unsigned b = 0; b < 8; b++)
+			histograms[b][(item.key >> (8 * b)) & 0xFF]++;
+
+	for (unsigned b = 0; b < 8; b++) {
+		auto& histogram = histograms[b];
+		// every key has the same byte here, pass would not move anything
+		if (std::any_of(histogram.begin(), histogram.end(), [n](uint32_t count) { return count == n; }))
+			continue;
+
+		uint32_t offset = 0;
+		for (uint32_t& count : histogram) {
+			uint32_t c = count;
+			count = offset;
+			offset += c;
+		}
+		for (Item const& item : items)
+			scratch[histogram[(item.key >> (8 * b)) & 0xFF]++] = item;
+		items.swap(scratch);
+	}
+}
+
+void RenderQueue::draw(UniformRing& object_data, glm::mat4 const& projection, float viewport_height)
+{
+	GLState& gl_state = GLState::get();
+	bool transparent_pass = false;
+
+	for (Item const& item : items) {
+		if (!transparent_pass && (item.key >> 62) == uint64_t(Pass::TRANSPARENT_PASS)) {
+			transparent_pass = true;
+			gl_state.set_enabled(GL_BLEND, true);
+			gl_state.depth_mask(false);
+			gl_state.set_enabled(GL_CULL_FACE, false);
+		}
+
+		Command const& command = commands[item.index];
+		if (command.mesh)
+			command.mesh->draw(object_data, camera_pos, projection, viewport_height);
+		else {
+			if (transparent_pass)
+				command.group->sort_back_to_front(camera_pos);
+			command.group->draw(object_data);
+		}
+	}
+
+	if (transparent_pass) {
+		// restore GL properties
+		gl_state.set_enabled(GL_BLEND, false);
+		gl_state.depth_mask(true);
+		gl_state.set_enabled(GL_CULL_FACE, true);
+	}
+}
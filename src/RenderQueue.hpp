@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "InstancedMesh.h"
+#include "UniformRing.hpp"
+
+// Per-frame list of draws, ordered by one 64-bit key each:
+//
+//   opaque:      | pass:2 | shader:8 | texture:12 | VAO:12 | unused:6 | depth:24 |   state sorted, front to back
+//   transparent: | pass:2 | far-to-near depth:24 | shader:8 | texture:12 | VAO:12 | unused:6 |
+//
+// GL names are masked to their field width, a collision only costs a state change, never correctness.
+// Keys are sorted by LSD radix sort (8 bits per pass), bytes equal in all keys are skipped.
+// Buffers are kept between frames, so a steady scene does not allocate.
+class RenderQueue {
+public:
+	enum class Pass : uint64_t { OPAQUE_PASS = 0, TRANSPARENT_PASS = 1 };  // not OPAQUE/TRANSPARENT, wingdi.h defines those
+
+	// depth is quantized over [0, max_distance], farther draws share the last value
+	void begin(glm::vec3 const& camera_pos, float max_distance);
+
+	// culled meshes and groups (visible == false) are left out
+	void add(Mesh& mesh);
+	// group has no single position: drawn first among opaque draws with the same state,
+	// after all transparent meshes (its instances are sorted by InstancedMesh::sort_back_to_front)
+	void add(InstancedMesh& group);
+
+	void sort(void);
+
+	// draws in key order, switches blend/depth write/culling when the transparent pass starts
+	void draw(UniformRing& object_data, glm::mat4 const& projection, float viewport_height);
+
+	size_t size(void) const { return items.size(); }
+
+private:
+	static constexpr unsigned DEPTH_BITS = 24;
+	static constexpr uint64_t DEPTH_MAX = (uint64_t(1) << DEPTH_BITS) - 1;
+
+	struct Item {
+		uint64_t key;
+		uint32_t index;  // to commands
+	};
+
+	struct Command {
+		Mesh* mesh;
+		InstancedMesh* group;
+	};
+
+	glm::vec3 camera_pos{};
+	float depth_scale{ 0.0f };
+
+	std::vector<Item> items;
+	std::vector<Item> scratch;
+	std::vector<Command> commands;
+
+	uint64_t quantize_depth(glm::vec3 const& position) const;
+	static uint64_t make_key(Pass pass, GLuint shader, GLuint texture, GLuint vao, uint64_t depth);
+	void push(uint64_t key, Command command);
+};
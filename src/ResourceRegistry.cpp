@@ -0,0 +1,79 @@
+#include <iomanip>
+#include <sstream>
+
+#include "ResourceRegistry.hpp"
+#include "MeshCache.hpp"
+
+template <typename T>
+std::shared_ptr<T> ResourceRegistry::acquire(std::unordered_map<std::string, std::weak_ptr<T>>& cache, const std::string& key,
+	const std::function<std::shared_ptr<T>(void)>& create, size_t& uploads)
+{
+	auto it = cache.find(key);
+	if (it != cache.end()) {
+		if (std::shared_ptr<T> resource = it->second.lock()) {
+			counters.bytes_saved += resource->gpu_bytes;
+			return resource;
+		}
+	}
+
+	std::shared_ptr<T> resource = create();
+	if (!resource)
+		return resource;
+
+	uploads++;
+	counters.bytes_uploaded += resource->gpu_bytes;
+	cache[key] = resource;
+	return resource;
+}
+
+ResourceRegistry::TextureHandle ResourceRegistry::texture(const std::string& key, const std::function<TextureHandle(void)>& create)
+{
+	counters.texture_requests++;
+	return acquire(textures, key, create, counters.texture_uploads);
+}
+
+ResourceRegistry::GeometryHandle ResourceRegistry::geometry(const std::string& key, const std::function<GeometryHandle(void)>& create)
+{
+	counters.geometry_requests++;
+	return acquire(geometries, key, create, counters.geometry_uploads);
+}
+
+std::string ResourceRegistry::geometry_key(const std::string& source, GLuint shader_program, bool quantized)
+{
+	return source + "|prog" + std::to_string(shader_program) + (quantized ? "|packed" : "|float");
+}
+
+std::string ResourceRegistry::content_key(const Vertex* vertices, size_t vertex_count, const GLuint* indices, size_t index_count)
+{
+	std::uint64_t h = hashBytes(reinterpret_cast<const char*>(vertices), vertex_count * sizeof(Vertex));
+	h ^= hashBytes(reinterpret_cast<const char*>(indices), index_count * sizeof(GLuint)) * 0x9E3779B97F4A7C15ull;
+
+	std::ostringstream key;
+	key << "content:" << std::hex << std::setw(16) << std::setfill('0') << h << ':' << std::dec << vertex_count << ':' << index_count;
+	return key.str();
+}
+
+size_t ResourceRegistry::live_bytes(void) const
+{
+	size_t bytes = 0;
+	for (auto const& t : textures)
+		if (auto resource = t.second.lock())
+			bytes += resource->gpu_bytes;
+	for (auto const& g : geometries)
+		if (auto resource = g.second.lock())
+			bytes += resource->gpu_bytes;
+	return bytes;
+}
+
+void ResourceRegistry::report(std::ostream& out) const
+{
+	auto mb = [](size_t bytes) { return bytes / (1024.0 * 1024.0); };
+
+	out << std::fixed << std::setprecision(2)
+		<< "GPU resources: " << counters.texture_uploads << " textures for " << counters.texture_requests << " requests, "
+		<< counters.geometry_uploads << " geometries for " << counters.geometry_requests << " requests\n"
+		<< "  uploaded " << mb(counters.bytes_uploaded) << " MB, saved " << mb(counters.bytes_saved) << " MB by sharing, live "
+		<< mb(live_bytes()) << " MB" << std::endl;
+	out.unsetf(std::ios::floatfield);
+	out << std::setprecision(6);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include <GL/glew.h>
+
+#include "Vertex.h"
+#include "Texture.h"
+#include "MeshGeometry.h"
+
+// Hands out shared, reference-counted GPU textures and mesh geometries.
+// Resources are keyed by path (or by content hash for generated meshes) and held weakly:
+// while anyone holds a handle, asking for the same key returns the same GL objects,
+// after the last handle is dropped the GL objects are deleted and the next request uploads again.
+// Not thread safe, use from the GL context thread.
+class ResourceRegistry {
+public:
+	using TextureHandle = std::shared_ptr<Texture>;
+	using GeometryHandle = std::shared_ptr<MeshGeometry>;
+
+	struct Stats {
+		size_t texture_requests{0};
+		size_t texture_uploads{0};
+		size_t geometry_requests{0};
+		size_t geometry_uploads{0};
+		size_t bytes_uploaded{0};  // total size of everything created
+		size_t bytes_saved{0};     // what the requests served from the registry would have uploaded again
+	};
+
+	// live resource stored under key, or create() it and remember the result
+	TextureHandle texture(const std::string& key, const std::function<TextureHandle(void)>& create);
+	GeometryHandle geometry(const std::string& key, const std::function<GeometryHandle(void)>& create);
+
+	// VAO layout depends on shader attribute locations and vertex format, so these are part of the key
+	static std::string geometry_key(const std::string& source, GLuint shader_program, bool quantized);
+	// source key for generated meshes
+	static std::string content_key(const Vertex* vertices, size_t vertex_count, const GLuint* indices, size_t index_count);
+
+	Stats const& stats(void) const { return counters; }
+	size_t live_bytes(void) const;
+
+	void report(std::ostream& out) const;
+
+private:
+	std::unordered_map<std::string, std::weak_ptr<Texture>> textures;
+	std::unordered_map<std::string, std::weak_ptr<MeshGeometry>> geometries;
+
+	Stats counters;
+
+	template <typename T>
+	std::shared_ptr<T> acquire(std::unordered_map<std::string, std::weak_ptr<T>>& cache, const std::string& key,
+		const std::function<std::shared_ptr<T>(void)>& create, size_t& uploads);
+};
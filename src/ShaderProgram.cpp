@@ -1,6 +1,8 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
@@ -18,62 +20,129 @@ ShaderProgram::ShaderProgram(const std::filesystem::path& VS_file, const std::fi
 	shader_ids.push_back(compile_shader(FS_file, GL_FRAGMENT_SHADER));
 
 	ID = link_shader(shader_ids);
+	load_uniform_locations();
 }
 
-void ShaderProgram::setUniform(const std::string& name, const float val) {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		std::cerr << "no uniform with name:" << name << '\n';
-		return;
+ShaderProgram::ShaderProgram(const std::filesystem::path& VS_file, const std::filesystem::path& TCS_file, const std::filesystem::path& TES_file, const std::filesystem::path& FS_file)
+{
+	std::vector<GLuint> shader_ids;
+
+	shader_ids.push_back(compile_shader(VS_file, GL_VERTEX_SHADER));
+	shader_ids.push_back(compile_shader(TCS_file, GL_TESS_CONTROL_SHADER));
+	shader_ids.push_back(compile_shader(TES_file, GL_TESS_EVALUATION_SHADER));
+	shader_ids.push_back(compile_shader(FS_file, GL_FRAGMENT_SHADER));
+
+	ID = link_shader(shader_ids);
+	load_uniform_locations();
+}
+
+ShaderProgram::ShaderProgram(const std::filesystem::path& CS_file)
+{
+	ID = link_shader({ compile_shader(CS_file, GL_COMPUTE_SHADER) });
+	load_uniform_locations();
+}
+
+void ShaderProgram::load_uniform_locations(void)
+{
+	uniform_locations.clear();
+
+	GLint count = 0;
+	glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+
+	GLint max_name_length = 0;
+	glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_MAX_NAME_LENGTH, &max_name_length);
+	std::vector<char> name_buffer(std::max(max_name_length, 1));
+
+	const GLenum properties[] = { GL_LOCATION, GL_ARRAY_SIZE };
+	for (GLint i = 0; i < count; i++) {
+		GLint values[2];
+		glGetProgramResourceiv(ID, GL_UNIFORM, i, 2, properties, 2, nullptr, values);
+		if (values[0] == -1)
+			continue; // member of a uniform block
+
+		GLsizei length = 0;
+		glGetProgramResourceName(ID, GL_UNIFORM, i, static_cast<GLsizei>(name_buffer.size()), &length, name_buffer.data());
+		std::string name(name_buffer.data(), length);
+
+		// arrays are reported as "name[0]": register "name", and every element
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+			std::string base = name.substr(0, name.size() - 3);
+			uniform_locations.emplace_back(base, values[0]);
+			for (GLint e = 0; e < values[1]; e++)
+				uniform_locations.emplace_back(base + '[' + std::to_string(e) + ']', values[0] + e);
+		}
+		else
+			uniform_locations.emplace_back(name, values[0]);
 	}
-	glUniform1f(loc, val);
+	std::sort(uniform_locations.begin(), uniform_locations.end());
+
+	GLint max_location = -1;
+	for (auto const& entry : uniform_locations)
+		max_location = std::max(max_location, entry.second);
+	uniform_values.assign(size_t(max_location + 1), UniformValue{});
 }
 
-void ShaderProgram::setUniform(const std::string& name, const int val) {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
+GLint ShaderProgram::getUniformLocation(const std::string& name) const
+{
+	auto it = std::lower_bound(uniform_locations.begin(), uniform_locations.end(), name,
+		[](std::pair<std::string, GLint> const& entry, std::string const& key) { return entry.first < key; });
+	if (it == uniform_locations.end() || it->first != name)
+		return -1;
+	return it->second;
+}
+
+GLint ShaderProgram::checked_location(const std::string& name) const
+{
+	GLint loc = getUniformLocation(name);
+	if (loc == -1)
 		std::cerr << "no uniform with name:" << name << '\n';
-		return;
+	return loc;
+}
+
+bool ShaderProgram::same_as_last(const GLint location, const void* data, const size_t size)
+{
+	if (location == -1)
+		return true; // nothing to set
+
+	if (location < 0 || size_t(location) >= uniform_values.size() || size > sizeof(UniformValue::bytes)) {
+		GLState::get().count_issued();
+		return false; // not in the table, always upload
 	}
-	glUniform1i(loc, val);
+	UniformValue& last = uniform_values[location];
+	if (last.size == size && std::memcmp(last.bytes, data, size) == 0) {
+		GLState::get().count_skipped();
+		return true;
+	}
+	std::memcpy(last.bytes, data, size);
+	last.size = size;
+	GLState::get().count_issued();
+	return false;
+}
+
+void ShaderProgram::setUniform(const std::string& name, const float val) {
+	setUniform(checked_location(name), val);
+}
+
+void ShaderProgram::setUniform(const std::string& name, const int val) {
+	setUniform(checked_location(name), val);
 }
 
 void ShaderProgram::setUniform(const std::string& name, const glm::vec3 val)
 {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		std::cerr << "no uniform with name:" << name << '\n';
-		return;
-	}
-	glUniform3fv(loc, 1, glm::value_ptr(val));
+	setUniform(checked_location(name), val);
 }
 
 void ShaderProgram::setUniform(const std::string& name, const glm::vec4 val) {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		std::cerr << "no uniform with name:" << name << '\n';
-		return;
-	}
-	glUniform4fv(loc, 1, glm::value_ptr(val));
+	setUniform(checked_location(name), val);
 }
 
-inline void ShaderProgram::setUniform(const std::string& name, const glm::mat3 val)
+void ShaderProgram::setUniform(const std::string& name, const glm::mat3 val)
 {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		std::cerr << "no uniform with name:" << name << '\n';
-		return;
-	}
-	glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(val));
+	setUniform(checked_location(name), val);
 }
 
 void ShaderProgram::setUniform(const std::string& name, const glm::mat4 val) {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		std::cerr << "no uniform with name:" << name << '\n';
-		return;
-	}
-	glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(val));
+	setUniform(checked_location(name), val);
 }
 
 GLuint ShaderProgram::getID() {
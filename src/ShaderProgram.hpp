@@ -2,8 +2,14 @@
 
 #include <string>
 #include <filesystem>
+#include <utility>
+#include <vector>
 
 #include <GL/glew.h> 
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GLState.hpp"
 
 class ShaderProgram {
 public:
@@ -12,14 +18,19 @@ public:
 	// you can add more constructors for pipeline with GS, TS etc.
 	ShaderProgram(void) = default; //does nothing
 	ShaderProgram(const std::filesystem::path & VS_file, const std::filesystem::path & FS_file); // TODO: load, compile, and link shader
+	explicit ShaderProgram(const std::filesystem::path & CS_file); // compute shader, run with glDispatchCompute after activate()
+	ShaderProgram(const std::filesystem::path & VS_file, const std::filesystem::path & TCS_file, const std::filesystem::path & TES_file, const std::filesystem::path & FS_file); // tessellation, draw GL_PATCHES
 
-	void activate(void) { glUseProgram(ID); };    // activate shader
-	void deactivate(void) { glUseProgram(0); };   // deactivate current shader program (i.e. activate shader no. 0)
+	void activate(void) { GLState::get().use_program(ID); };    // activate shader (if not active already)
+	void deactivate(void) { GLState::get().use_program(0); };   // deactivate current shader program (i.e. activate shader no. 0)
 
 	void clear(void) { 	//deallocate shader program
 		deactivate();
+		GLState::get().forget_program(ID);
 		glDeleteProgram(ID);
 		ID = 0;
+		uniform_locations.clear();
+		uniform_values.clear();
 	}
     
     // set uniform according to name 
@@ -30,11 +41,37 @@ public:
     void setUniform(const std::string & name, const glm::vec4 val);
     void setUniform(const std::string & name, const glm::mat3 val);   
     void setUniform(const std::string & name, const glm::mat4 val);
+
+    // location of an active uniform (from the table built after linking), -1 if there is none
+    // keep it in hot paths and set by location - no string lookup, no driver query
+    GLint getUniformLocation(const std::string & name) const;
+
+    // set uniform by location, -1 is silently ignored (as in GL), same value as last time is not uploaded again
+    // program must be active (as for glUniform)
+    void setUniform(const GLint location, const float val) { if (!same_as_last(location, &val, sizeof(val))) glUniform1f(location, val); }
+    void setUniform(const GLint location, const int val) { if (!same_as_last(location, &val, sizeof(val))) glUniform1i(location, val); }
+    void setUniform(const GLint location, const glm::vec3 val) { if (!same_as_last(location, &val, sizeof(val))) glUniform3fv(location, 1, glm::value_ptr(val)); }
+    void setUniform(const GLint location, const glm::vec4 val) { if (!same_as_last(location, &val, sizeof(val))) glUniform4fv(location, 1, glm::value_ptr(val)); }
+    void setUniform(const GLint location, const glm::mat3 val) { if (!same_as_last(location, &val, sizeof(val))) glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(val)); }
+    void setUniform(const GLint location, const glm::mat4 val) { if (!same_as_last(location, &val, sizeof(val))) glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(val)); }
     
 	GLuint getID();
 
 private:
 	GLuint ID{ 0 }; // default = 0, empty shader
+
+	// all active uniforms (array elements as "name[i]"), sorted by name
+	std::vector<std::pair<std::string, GLint>> uniform_locations;
+	void load_uniform_locations(void);
+	GLint checked_location(const std::string & name) const; // reports missing uniform
+
+	// last value uploaded to each location, indexed by location (sized after linking); size 0 = none yet
+	struct UniformValue {
+		size_t size{ 0 };
+		unsigned char bytes[sizeof(glm::mat4)];
+	};
+	std::vector<UniformValue> uniform_values;
+	bool same_as_last(const GLint location, const void* data, const size_t size);
 	std::string getShaderInfoLog(const GLuint obj); 
 	std::string getProgramInfoLog(const GLuint obj);
 
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <utility>
+
+#include "Terrain.hpp"
+#include "GLState.hpp"
+#include "GLBuffers.hpp"
+
+Terrain::~Terrain()
+{
+	clear();
+}
+
+void Terrain::clear(void)
+{
+	GLState::get().forget_vertex_array(VAO);
+	GLState::get().forget_texture(height_texture);
+	GLState::get().forget_vertex_array(tess_VAO);
+	GLuint vertex_arrays[] = { VAO, tess_VAO };
+	glDeleteVertexArrays(2, vertex_arrays);
+	glDeleteTextures(1, &height_texture);
+	GLuint buffers[] = { VBO, EBO, patch_buffer, command_buffer, tess_VBO };
+	glDeleteBuffers(5, buffers);
+	VAO = VBO = EBO = height_texture = patch_buffer = command_buffer = 0;
+	tess_VAO = tess_VBO = 0;
+	tess_shader = nullptr;
+	tess_patches = 0;
+	patch_capacity = command_capacity = 0;
+	atlas.reset();
+	nodes.clear();
+	ranges.clear();
+	patches.clear();
+	commands.clear();
+	selected_triangles = 0;
+}
+
+void Terrain::init(ShaderProgram& shader, cv::Mat const& heights, std::shared_ptr<Texture> atlas, Settings const& settings)
+{
+	clear();
+	if (heights.empty() || heights.type() != CV_8UC1)
+		throw std::runtime_error("Terrain: height map must be 8-bit, 1 channel");
+
+	this->shader = &shader;
+	this->atlas = std::move(atlas);
+	this->settings = settings;
+	extent = glm::vec2(heights.cols - 1, heights.rows - 1);
+
+	// levels until one node covers the whole map
+	float leaf_size = PATCH_QUADS * settings.finest_step;
+	float root_size = leaf_size;
+	int level_count = 1;
+	while (root_size < std::max(extent.x, extent.y)) {
+		root_size *= 2.0f;
+		level_count++;
+	}
+	for (int level = 0; level < level_count - 1; level++)
+		ranges.push_back(settings.lod_range * leaf_size * static_cast<float>(1 << level));
+	ranges.push_back(std::numeric_limits<float>::max());
+
+	build_node(heights, glm::vec2(0.0f), root_size, level_count - 1);
+
+	// patch grid: shared vertices, triangles quadrant by quadrant so each quadrant is one index range
+	std::vector<glm::vec2> grid;
+	for (int z = 0; z <= PATCH_QUADS; z++)
+		for (int x = 0; x <= PATCH_QUADS; x++)
+			grid.emplace_back(x, z);
+	static_assert((PATCH_QUADS + 1) * (PATCH_QUADS + 1) <= 65536, "patch grid must fit 16-bit indices");
+	std::vector<GLushort> indices;
+	const int HALF = PATCH_QUADS / 2;
+	for (int quadrant = 0; quadrant < 4; quadrant++)
+		for (int z = (quadrant >> 1) * HALF; z < ((quadrant >> 1) + 1) * HALF; z++)
+			for (int x = (quadrant & 1) * HALF; x < ((quadrant & 1) + 1) * HALF; x++) {
+				// 3-----2
+				// |   / |   012 as 0,2,1 and 0,3,2 - same winding as the old height map mesh
+				// | /   |
+				// 0-----1
+				GLushort i0 = static_cast<GLushort>(z * (PATCH_QUADS + 1) + x);
+				GLushort i1 = i0 + 1, i3 = i0 + PATCH_QUADS + 1, i2 = i3 + 1;
+				indices.insert(indices.end(), { i0, i2, i1, i0, i3, i2 });
+			}
+
+	glCreateBuffers(1, &VBO);
+	glCreateBuffers(1, &EBO);
+	glNamedBufferStorage(VBO, grid.size() * sizeof(glm::vec2), grid.data(), 0);
+	glNamedBufferStorage(EBO, indices.size() * sizeof(GLushort), indices.data(), 0);
+
+	glCreateVertexArrays(1, &VAO);
+	GLint grid_location = glGetAttribLocation(shader.getID(), "aGrid");
+	if (grid_location == -1)
+		std::cerr << "Position of 'aGrid' not found" << std::endl;
+	else {
+		glVertexArrayAttribFormat(VAO, grid_location, 2, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(VAO, grid_location, 0);
+		glEnableVertexArrayAttrib(VAO, grid_location);
+	}
+	glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(glm::vec2));
+	glVertexArrayElementBuffer(VAO, EBO);
+
+	// heights in the vertex shader: bilinear between texels, clamped at the border
+	glCreateTextures(GL_TEXTURE_2D, 1, &height_texture);
+	glTextureStorage2D(height_texture, 1, GL_R8, heights.cols, heights.rows);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	cv::Mat continuous = heights.isContinuous() ? heights : heights.clone();
+	glTextureSubImage2D(height_texture, 0, 0, 0, heights.cols, heights.rows, GL_RED, GL_UNSIGNED_BYTE, continuous.data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTextureParameteri(height_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(height_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(height_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(height_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glCreateBuffers(1, &patch_buffer);
+	glCreateBuffers(1, &command_buffer);
+
+	shader.activate();
+	shader.setUniform("tex0", 0);
+	shader.setUniform("heights", 1);
+	shader.setUniform("height_scale", settings.height_scale);
+	shader.setUniform("texture_tile", settings.texture_tile);
+
+	std::cout << "Terrain: " << heights.cols << "x" << heights.rows << ", " << level_count << " LOD levels, "
+		<< nodes.size() << " quadtree nodes, finest step " << settings.finest_step << ", " << gpu_bytes() / 1024 << " KiB\n";
+}
+
+size_t Terrain::gpu_bytes(void) const
+{
+	if (VAO == 0)
+		return 0;
+	size_t grid_bytes = (PATCH_QUADS + 1) * (PATCH_QUADS + 1) * sizeof(glm::vec2) + 4 * QUADRANT_INDICES * sizeof(GLushort);
+	grid_bytes += tess_patches * 4 * sizeof(glm::vec4);
+	return grid_bytes + static_cast<size_t>(extent.x + 1) * static_cast<size_t>(extent.y + 1);
+}
+
+uint32_t Terrain::build_node(cv::Mat const& heights, glm::vec2 origin, float size, int level)
+{
+	uint32_t index = static_cast<uint32_t>(nodes.size());
+	nodes.push_back(Node{ BoundingBox::empty(), origin, size });
+	BoundingBox bounds = BoundingBox::empty();
+
+	if (level == 0) {
+		// texels under the node, its border included (vertices lie on texels at every level)
+		int x0 = static_cast<int>(origin.x), z0 = static_cast<int>(origin.y);
+		int x1 = std::min(static_cast<int>(origin.x + size), heights.cols - 1);
+		int z1 = std::min(static_cast<int>(origin.y + size), heights.rows - 1);
+		double lowest, highest;
+		cv::minMaxLoc(heights(cv::Rect(x0, z0, x1 - x0 + 1, z1 - z0 + 1)), &lowest, &highest);
+		float scale = settings.height_scale / 255.0f;
+		bounds.min = glm::vec3(x0, static_cast<float>(lowest) * scale, z0);
+		bounds.max = glm::vec3(x1, static_cast<float>(highest) * scale, z1);
+	}
+	else {
+		float half = size * 0.5f;
+		for (int quadrant = 0; quadrant < 4; quadrant++) {
+			glm::vec2 child_origin = origin + glm::vec2(quadrant & 1, quadrant >> 1) * half;
+			if (child_origin.x >= extent.x || child_origin.y >= extent.y)
+				continue;  // beyond the map
+			uint32_t child = build_node(heights, child_origin, half, level - 1);
+			nodes[index].children[quadrant] = child;
+			bounds.merge(nodes[child].bounds);
+		}
+	}
+	nodes[index].bounds = bounds;
+	return index;
+}
+
+void Terrain::select(glm::vec3 const& camera_pos, Frustum const& frustum)
+{
+	patches.clear();
+	commands.clear();
+	selected_triangles = 0;
+	if (!nodes.empty())
+		select_node(0, static_cast<int>(ranges.size()) - 1, camera_pos, frustum);
+}
+
+bool Terrain::select_node(uint32_t node_index, int level, glm::vec3 const& camera_pos, Frustum const& frustum)
+{
+	Node const& node = nodes[node_index];
+	if (frustum.test(node.bounds) == Frustum::Test::OUTSIDE)
+		return true;  // nothing to draw, nor for the parent
+	if (!overlapsSphere(node.bounds, camera_pos, ranges[level]))
+		return false;
+	if (level == 0 || !overlapsSphere(node.bounds, camera_pos, ranges[level - 1])) {
+		add_patch(node, level, -1);
+		return true;
+	}
+	// some children need finer detail, the rest is drawn at this level quadrant by quadrant
+	for (int quadrant = 0; quadrant < 4; quadrant++) {
+		uint32_t child = node.children[quadrant];
+		if (child != NONE && !select_node(child, level - 1, camera_pos, frustum))
+			add_patch(node, level, quadrant);
+	}
+	return true;
+}
+
+void Terrain::add_patch(Node const& node, int level, int quadrant)
+{
+	// morph over the far part of the level's band, the top level never morphs
+	float morph_start = 1e30f, morph_end = 2e30f;
+	if (level + 1 < static_cast<int>(ranges.size())) {
+		float band_start = level > 0 ? ranges[level - 1] : 0.0f;
+		morph_end = ranges[level];
+		morph_start = band_start + (morph_end - band_start) * MORPH_START;
+	}
+
+	GLuint base_instance = static_cast<GLuint>(patches.size());
+	patches.push_back(Patch{ node.origin, node.size / PATCH_QUADS, morph_start, morph_end, {} });
+	GLuint count = quadrant < 0 ? 4 * QUADRANT_INDICES : QUADRANT_INDICES;
+	GLuint first = quadrant < 0 ? 0 : quadrant * QUADRANT_INDICES;
+	commands.push_back(IndirectRenderer::DrawElementsIndirectCommand{ count, 1, first, 0, base_instance });
+	selected_triangles += count / 3;
+}
+
+void Terrain::draw(void)
+{
+	if (patches.empty())
+		return;
+
+	uploadGrowing(patch_buffer, patch_capacity, patches);
+	uploadGrowing(command_buffer, command_capacity, commands);
+
+	shader->activate();
+	GLState::get().bind_texture_unit(0, atlas ? atlas->id : 0);
+	GLState::get().bind_texture_unit(1, height_texture);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, patch_buffer);
+	GLState::get().bind_vertex_array(VAO);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, nullptr, static_cast<GLsizei>(commands.size()), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void Terrain::init_tessellation(ShaderProgram& tess_shader)
+{
+	if (nodes.empty())
+		throw std::runtime_error("Terrain: init() before init_tessellation()");
+	GLint max_level = 0;
+	glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &max_level);
+	if (max_level < 64)
+		std::cerr << "WARN: GL_MAX_TESS_GEN_LEVEL " << max_level << ", terrain gets coarser than 1 texel per quad\n";
+
+	this->tess_shader = &tess_shader;
+	GLState::get().forget_vertex_array(tess_VAO);
+	glDeleteVertexArrays(1, &tess_VAO);
+	glDeleteBuffers(1, &tess_VBO);
+
+	// patches are the quadtree nodes of the level nearest to TESS_PATCH_SIZE, their bounds give the height ranges
+	int patch_level = 0;
+	while (patch_level + 1 < static_cast<int>(ranges.size()) && settings.finest_step * PATCH_QUADS * static_cast<float>(2 << patch_level) <= TESS_PATCH_SIZE)
+		patch_level++;
+
+	std::vector<glm::vec4> corners;
+	std::vector<std::pair<uint32_t, int>> stack{ { 0, static_cast<int>(ranges.size()) - 1 } };
+	while (!stack.empty()) {
+		auto [node_index, level] = stack.back();
+		stack.pop_back();
+		Node const& node = nodes[node_index];
+		if (level > patch_level) {
+			for (uint32_t child : node.children)
+				if (child != NONE)
+					stack.push_back({ child, level - 1 });
+			continue;
+		}
+		glm::vec2 low = node.origin, high = glm::min(node.origin + node.size, extent);
+		float lowest = node.bounds.min.y, highest = node.bounds.max.y;
+		corners.emplace_back(low.x, low.y, lowest, highest);
+		corners.emplace_back(high.x, low.y, lowest, highest);
+		corners.emplace_back(high.x, high.y, lowest, highest);
+		corners.emplace_back(low.x, high.y, lowest, highest);
+	}
+	tess_patches = corners.size() / 4;
+
+	glCreateBuffers(1, &tess_VBO);
+	glNamedBufferStorage(tess_VBO, corners.size() * sizeof(glm::vec4), corners.data(), 0);
+	glCreateVertexArrays(1, &tess_VAO);
+	GLint patch_location = glGetAttribLocation(tess_shader.getID(), "aPatch");
+	if (patch_location == -1)
+		std::cerr << "Position of 'aPatch' not found" << std::endl;
+	else {
+		glVertexArrayAttribFormat(tess_VAO, patch_location, 4, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(tess_VAO, patch_location, 0);
+		glEnableVertexArrayAttrib(tess_VAO, patch_location);
+	}
+	glVertexArrayVertexBuffer(tess_VAO, 0, tess_VBO, 0, sizeof(glm::vec4));
+
+	tess_shader.activate();
+	tess_shader.setUniform("tex0", 0);
+	tess_shader.setUniform("heights", 1);
+	tess_shader.setUniform("height_scale", settings.height_scale);
+	tess_shader.setUniform("texture_tile", settings.texture_tile);
+	tess_shader.setUniform("edge_pixels", settings.edge_pixels);
+	for (int i = 0; i < 6; i++)
+		plane_locations[i] = tess_shader.getUniformLocation("planes[" + std::to_string(i) + "]");
+	viewport_height_location = tess_shader.getUniformLocation("viewport_height");
+
+	std::cout << "Terrain: " << tess_patches << " tessellation patches\n";
+}
+
+void Terrain::draw_tessellated(glm::mat4 const& view_projection, float viewport_height)
+{
+	if (tess_VAO == 0)
+		return;
+
+	tess_shader->activate();
+	Frustum frustum = Frustum::from_matrix(view_projection);
+	for (int i = 0; i < 6; i++)
+		tess_shader->setUniform(plane_locations[i], frustum.planes[i]);
+	tess_shader->setUniform(viewport_height_location, viewport_height);
+
+	GLState::get().bind_texture_unit(0, atlas ? atlas->id : 0);
+	GLState::get().bind_texture_unit(1, height_texture);
+	GLState::get().bind_vertex_array(tess_VAO);
+	glPatchParameteri(GL_PATCH_VERTICES, 4);
+	glDrawArrays(GL_PATCHES, 0, static_cast<GLsizei>(tess_patches * 4));
+}
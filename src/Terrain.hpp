@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <opencv2\opencv.hpp>
+
+#include "Bounds.hpp"
+#include "IndirectRenderer.hpp"
+#include "ShaderProgram.hpp"
+#include "Texture.h"
+
+// Terrain with continuous distance-dependent LOD (CDLOD, Strugar 2009).
+// The only geometry is one grid patch of PATCH_QUADS x PATCH_QUADS quads with shared vertices and 16-bit indices;
+// terrain.vert places it over a quadtree node and reads the heights from the height map texture.
+// select() walks the quadtree every frame: a node that reaches into the range of the finer level is split,
+// otherwise it is drawn whole with the patch scaled to its size - or only one quadrant of it, where the
+// other children were split. Near the end of a level's range the patch morphs onto the coarser grid.
+// All selected patches are drawn by one glMultiDrawElementsIndirect.
+//
+// draw_tessellated() is the alternative on tessellation hardware: a fixed grid of coarse patches (one per
+// quadtree node of about TESS_PATCH_SIZE texels), subdivided on the GPU by the projected size of each edge
+// (terrain_tess.tesc) and displaced from the same height texture (terrain_tess.tese). No CPU work per frame.
+class Terrain {
+public:
+	static constexpr int PATCH_QUADS = 32;     // per side, even (quadrants)
+	static constexpr float MORPH_START = 0.7f; // part of a level's distance band where morphing begins
+	static constexpr float TESS_PATCH_SIZE = 64.0f; // texels per side of a tessellated patch, 1 texel per quad at level 64
+
+	struct Settings {
+		float finest_step = 2.0f;     // height map texels per quad at the finest level (the old mesh had 10)
+		float height_scale = 127.5f;  // world height of height map value 255
+		float lod_range = 4.0f;       // distance the finest level reaches, in its node sizes; doubles per level
+		float texture_tile = 10.0f;   // world units per repeat of an atlas tile
+		float edge_pixels = 8.0f;     // wanted triangle edge length on screen, tessellated path
+	};
+
+	// std430 layout of Patch in terrain.vert
+	struct Patch {
+		glm::vec2 origin;
+		float grid_step;
+		float morph_start;
+		float morph_end;
+		float pad[3];
+	};
+	static_assert(sizeof(Patch) == 32, "Patch must match std430 layout in terrain.vert");
+
+	Terrain(void) = default;
+	Terrain(Terrain const&) = delete;
+	Terrain& operator=(Terrain const&) = delete;
+	~Terrain();
+
+	// heights: 8-bit, one texel per world unit in x and z; atlas: 16 x 16 tiles picked by height in terrain.frag
+	void init(ShaderProgram& shader, cv::Mat const& heights, std::shared_ptr<Texture> atlas, Settings const& settings);
+	void init(ShaderProgram& shader, cv::Mat const& heights, std::shared_ptr<Texture> atlas) { init(shader, heights, std::move(atlas), Settings{}); }
+
+	// patches to draw from this camera
+	void select(glm::vec3 const& camera_pos, Frustum const& frustum);
+	void draw(void);
+
+	// after init(); shader: terrain_tess.vert/.tesc/.tese + terrain.frag
+	void init_tessellation(ShaderProgram& tess_shader);
+	bool tessellation_ready(void) const { return tess_VAO != 0; }
+	void draw_tessellated(glm::mat4 const& view_projection, float viewport_height);
+	size_t tessellation_patch_count(void) const { return tess_patches; }
+
+	size_t patch_count(void) const { return patches.size(); }
+	size_t triangle_count(void) const { return selected_triangles; }
+	size_t levels(void) const { return ranges.size(); }
+	size_t gpu_bytes(void) const;
+
+	// delete GL objects, GL context must be current
+	void clear(void);
+
+private:
+	static constexpr uint32_t NONE = ~uint32_t(0);
+	static constexpr GLuint QUADRANT_INDICES = (PATCH_QUADS / 2) * (PATCH_QUADS / 2) * 6;
+
+	struct Node {
+		BoundingBox bounds;  // world space, heights from min/max of the texels under it
+		glm::vec2 origin;
+		float size;
+		uint32_t children[4]{ NONE, NONE, NONE, NONE };  // quadrant order: +x, then +z
+	};
+
+	ShaderProgram* shader{ nullptr };
+	std::shared_ptr<Texture> atlas;
+	Settings settings;
+	glm::vec2 extent{ 0.0f };  // world size, texels - 1
+
+	std::vector<Node> nodes;   // root first
+	std::vector<float> ranges; // per level, finest first; the top level reaches everything
+
+	std::vector<Patch> patches;
+	std::vector<IndirectRenderer::DrawElementsIndirectCommand> commands;  // one per patch
+	size_t selected_triangles{ 0 };
+
+	GLuint VAO{ 0 }, VBO{ 0 }, EBO{ 0 }, height_texture{ 0 };
+	GLuint patch_buffer{ 0 }, command_buffer{ 0 };
+	size_t patch_capacity{ 0 }, command_capacity{ 0 };
+
+	ShaderProgram* tess_shader{ nullptr };
+	GLint plane_locations[6]{ -1, -1, -1, -1, -1, -1 };
+	GLint viewport_height_location{ -1 };
+	GLuint tess_VAO{ 0 }, tess_VBO{ 0 };  // 4 corners per patch: x, z, lowest, highest height
+	size_t tess_patches{ 0 };
+
+	uint32_t build_node(cv::Mat const& heights, glm::vec2 origin, float size, int level);
+	// false: node is beyond its level's range, the parent draws its area
+	bool select_node(uint32_t node_index, int level, glm::vec3 const& camera_pos, Frustum const& frustum);
+	void add_patch(Node const& node, int level, int quadrant);  // quadrant -1 = whole node
+};
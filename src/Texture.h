@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+#include "GLState.hpp"
+
+// Owns one GL texture object, shared through std::shared_ptr (see ResourceRegistry).
+// Deleted with the last owner - GL context must still be current at that time.
+class Texture {
+public:
+    GLuint id{0};
+    size_t gpu_bytes{0};  // all mip levels
+
+    Texture(GLuint id, size_t gpu_bytes) : id(id), gpu_bytes(gpu_bytes) {}
+
+    Texture(Texture const&) = delete;
+    Texture& operator=(Texture const&) = delete;
+
+    ~Texture() {
+        GLState::get().forget_texture(id);
+        glDeleteTextures(1, &id);
+    }
+};
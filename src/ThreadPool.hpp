@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads executing submitted jobs in FIFO order.
+class ThreadPool {
+public:
+	explicit ThreadPool(unsigned thread_count = std::max(1u, std::thread::hardware_concurrency())) {
+		for (unsigned i = 0; i < thread_count; i++)
+			workers.emplace_back([this] { worker_loop(); });
+	}
+
+	~ThreadPool() {
+		{
+			std::scoped_lock lk(mutex);
+			stopping = true;
+		}
+		cv.notify_all();
+		for (auto& w : workers)
+			w.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// run f on a worker; exceptions thrown by f are rethrown by future::get()
+	template <typename F>
+	auto submit(F&& f) -> std::future<std::invoke_result_t<F>> {
+		using R = std::invoke_result_t<F>;
+		auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+		std::future<R> result = task->get_future();
+		{
+			std::scoped_lock lk(mutex);
+			jobs.emplace([task] { (*task)(); });
+		}
+		cv.notify_one();
+		return result;
+	}
+
+	size_t size(void) const { return workers.size(); }
+
+private:
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopping = false;
+
+	void worker_loop(void) {
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock lk(mutex);
+				cv.wait(lk, [this] { return stopping || !jobs.empty(); });
+				if (stopping && jobs.empty())
+					return;
+				job = std::move(jobs.front());
+				jobs.pop();
+			}
+			job();
+		}
+	}
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// C++ mirrors of the std140 uniform blocks in resources/Shaders/*.vert, *.frag
+// (vec3 is padded to 16 B unless followed by a scalar, which fills the gap)
+
+// camera and lights, updated once per frame
+constexpr GLuint FRAME_DATA_BINDING = 0;
+
+struct FrameData {
+    glm::mat4 view;                     // uV_m
+    glm::mat4 projection;               // uP_m
+    glm::vec3 camera_position;          // camPos
+    GLint spotlight_on;                 // bool in GLSL
+    glm::vec3 spotlight_direction;
+    float cut_off;                      // cos of spotlight half-angle
+    glm::vec3 light_position;
+    float specular_shinines;
+    glm::vec3 ambient_intensity;
+    float pad0;
+    glm::vec3 diffuse_intensity;
+    float pad1;
+    glm::vec3 specular_intensity;
+    float pad2;
+};
+static_assert(sizeof(FrameData) == 224, "FrameData must match std140 layout of FrameData block");
+
+// one mesh draw, written to UniformRing
+constexpr GLuint OBJECT_DATA_BINDING = 1;
+
+struct ObjectData {
+    glm::mat4 model;                    // uM_m
+    glm::vec4 diffuse_color;
+    glm::vec3 pos_scale;                // dequantization of PackedVertex
+    GLint quantized;                    // bool in GLSL
+    glm::vec3 pos_offset;
+    float pad0;
+};
+static_assert(sizeof(ObjectData) == 112, "ObjectData must match std140 layout of ObjectData block");
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "UniformRing.hpp"
+
+UniformRing::~UniformRing()
+{
+	clear();
+}
+
+void UniformRing::init(size_t slot_size, size_t slots_per_frame)
+{
+	clear();
+
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	this->slot_size = (slot_size + alignment - 1) / alignment * alignment;
+	allocate(std::max(slots_per_frame, MIN_SLOTS));
+}
+
+void UniformRing::allocate(size_t slots_per_frame)
+{
+	this->slots_per_frame = slots_per_frame;
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	size_t bytes = slot_size * slots_per_frame * FRAMES;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, bytes, nullptr, flags);
+	mapped = static_cast<unsigned char*>(glMapNamedBufferRange(buffer, 0, bytes, flags));
+	if (!mapped)
+		throw std::runtime_error("UniformRing: can not map uniform buffer");
+}
+
+void UniformRing::grow(void)
+{
+	// blocks bound earlier in this frame and in frames still in flight stay in the old buffer
+	glUnmapNamedBuffer(buffer);
+	retired.push_back(Retired{ buffer, FRAMES });
+	allocate(slots_per_frame * 2);
+	slot = 0;
+	std::cout << "UniformRing: more than " << slots_per_frame / 2 << " blocks in a frame, grown to " << slots_per_frame << '\n';
+}
+
+void UniformRing::clear(void)
+{
+	for (GLsync& fence : fences) {
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (buffer) {
+		glUnmapNamedBuffer(buffer);
+		glDeleteBuffers(1, &buffer);
+	}
+	for (Retired const& r : retired)
+		glDeleteBuffers(1, &r.buffer);
+	retired.clear();
+	buffer = 0;
+	mapped = nullptr;
+	frame = slot = 0;
+}
+
+void UniformRing::begin_frame(void)
+{
+	frame = (frame + 1) % FRAMES;
+	slot = 0;
+
+	// wait until GPU is done with what was written to this region FRAMES frames ago
+	if (fences[frame]) {
+		while (glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000) == GL_TIMEOUT_EXPIRED)
+			;
+		glDeleteSync(fences[frame]);
+		fences[frame] = nullptr;
+	}
+
+	// FRAMES waits after retiring a buffer, the last frame that used it is done too
+	for (size_t i = 0; i < retired.size();) {
+		if (--retired[i].frames_left == 0) {
+			glDeleteBuffers(1, &retired[i].buffer);
+			retired[i] = retired.back();
+			retired.pop_back();
+		}
+		else
+			i++;
+	}
+}
+
+void UniformRing::end_frame(void)
+{
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void UniformRing::bind(GLuint binding, const void* data, size_t size)
+{
+	if (!mapped || size > slot_size)
+		throw std::runtime_error("UniformRing: not initialized or block bigger than slot");
+
+	if (slot == slots_per_frame)
+		grow();
+
+	size_t offset = (frame * slots_per_frame + slot++) * slot_size;
+	std::memcpy(mapped + offset, data, size);
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+// Persistently mapped uniform buffer, split into FRAMES regions used round-robin.
+// Every bind() copies a block into the next free slot of this frame's region and binds that range
+// to a uniform binding point. A fence per region makes sure the CPU never overwrites
+// data of a frame the GPU is still drawing.
+// A frame that needs more slots than a region has moves to a new buffer twice the size; the old one
+// is deleted once the frames that wrote it are done.
+class UniformRing {
+public:
+	static constexpr size_t FRAMES = 3;
+
+	UniformRing(void) = default;
+	UniformRing(UniformRing const&) = delete;
+	UniformRing& operator=(UniformRing const&) = delete;
+	~UniformRing();
+
+	// slot_size is rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	void init(size_t slot_size, size_t slots_per_frame);
+	void clear(void);
+
+	void begin_frame(void);
+	void end_frame(void);
+
+	void bind(GLuint binding, const void* data, size_t size);
+
+	template <typename T>
+	void bind(GLuint binding, T const& block) { bind(binding, &block, sizeof(T)); }
+
+	size_t capacity(void) const { return slots_per_frame; }
+
+private:
+	static constexpr size_t MIN_SLOTS = 64;
+
+	struct Retired {
+		GLuint buffer;
+		size_t frames_left;  // begin_frame() calls until every fence of its frames has been waited for
+	};
+
+	GLuint buffer{ 0 };
+	unsigned char* mapped{ nullptr };
+
+	size_t slot_size{ 0 };
+	size_t slots_per_frame{ 0 };
+
+	size_t frame{ 0 };  // current region
+	size_t slot{ 0 };   // next free slot in region
+
+	std::array<GLsync, FRAMES> fences{};
+	std::vector<Retired> retired;
+
+	void allocate(size_t slots_per_frame);
+	void grow(void);
+};
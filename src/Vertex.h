@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+
 #include <glm/glm.hpp> 
 
 struct Vertex {
@@ -14,4 +17,50 @@ struct Vertex {
     }
 };
 
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must be tightly packed (hashed and compared as raw bytes)");
+
+// -0.0f as 0.0f, so that raw-byte comparison welds what operator== does (NaN aside)
+inline Vertex canonicalZeros(Vertex v) {
+    float f[sizeof(Vertex) / sizeof(float)];
+    std::memcpy(f, &v, sizeof(Vertex));
+    for (float& x : f)
+        if (x == 0.0f)
+            x = 0.0f;
+    std::memcpy(&v, f, sizeof(Vertex));
+    return v;
+}
+
+// exact-bitwise equality: vertices are equal only if all of their bytes match
+// (unlike operator==, 0.0f and -0.0f differ and NaN equals itself; see canonicalZeros)
+struct VertexBitwiseEqual {
+    bool operator()(const Vertex& a, const Vertex& b) const {
+        return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+    }
+};
+
+// hash over the raw bytes, consistent with VertexBitwiseEqual
+struct VertexHash {
+    size_t operator()(const Vertex& v) const {
+        std::uint32_t words[sizeof(Vertex) / sizeof(std::uint32_t)];
+        std::memcpy(words, &v, sizeof(Vertex));
+
+        std::uint64_t h = 0x9E3779B97F4A7C15ull;
+        for (std::uint32_t w : words) {
+            h ^= w;
+            h *= 0xFF51AFD7ED558CCDull;
+            h ^= h >> 32;
+        }
+        return static_cast<size_t>(h);
+    }
+};
+
+// Compact vertex for static meshes, 16 bytes instead of 32:
+// position is unorm16 inside the mesh AABB, normal is octahedral snorm16, UV is half float.
+// Dequantize with the scale/offset from packVertices(), see VertexQuantization.hpp
+struct PackedVertex {
+    std::uint16_t Position[4]; // xyz, w is padding
+    std::int16_t Normal[2];
+    std::uint16_t TexCoords[2];
+};
 
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must be 16 bytes");
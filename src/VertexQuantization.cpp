@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/packing.hpp>
+
+#include "VertexQuantization.hpp"
+
+namespace {
+	inline float signNotZero(float v) { return v >= 0.0f ? 1.0f : -1.0f; }
+}
+
+glm::vec2 octEncode(glm::vec3 n)
+{
+	float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (l1 == 0.0f)
+		return glm::vec2(0.0f);
+	n /= l1;
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0.0f)
+		e = glm::vec2((1.0f - std::abs(n.y)) * signNotZero(n.x), (1.0f - std::abs(n.x)) * signNotZero(n.y));
+	return e;
+}
+
+glm::vec3 octDecode(glm::vec2 e)
+{
+	glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+	if (n.z < 0.0f) {
+		n.x = (1.0f - std::abs(e.y)) * signNotZero(e.x);
+		n.y = (1.0f - std::abs(e.x)) * signNotZero(e.y);
+	}
+	return glm::normalize(n);
+}
+
+VertexQuantization packVertices(const Vertex* vertices, size_t count, std::vector<PackedVertex>& packed)
+{
+	VertexQuantization q;
+	packed.resize(count);
+	if (count == 0)
+		return q;
+
+	glm::vec3 lo = vertices[0].Position, hi = vertices[0].Position;
+	for (size_t i = 1; i < count; i++) {
+		lo = glm::min(lo, vertices[i].Position);
+		hi = glm::max(hi, vertices[i].Position);
+	}
+	q.offset = lo;
+	q.scale = hi - lo;
+	for (int c = 0; c < 3; c++)
+		if (q.scale[c] <= 0.0f)
+			q.scale[c] = 1.0f; // flat along this axis
+
+	for (size_t i = 0; i < count; i++) {
+		Vertex const& v = vertices[i];
+		PackedVertex& p = packed[i];
+
+		glm::vec3 unit = glm::clamp((v.Position - q.offset) / q.scale, 0.0f, 1.0f);
+		for (int c = 0; c < 3; c++)
+			p.Position[c] = glm::packUnorm1x16(unit[c]);
+		p.Position[3] = 0;
+
+		glm::vec2 oct = octEncode(v.Normal);
+		p.Normal[0] = static_cast<std::int16_t>(glm::packSnorm1x16(oct.x));
+		p.Normal[1] = static_cast<std::int16_t>(glm::packSnorm1x16(oct.y));
+
+		p.TexCoords[0] = glm::packHalf1x16(v.TexCoords.x);
+		p.TexCoords[1] = glm::packHalf1x16(v.TexCoords.y);
+	}
+	return q;
+}
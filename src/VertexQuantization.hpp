@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+
+// position = quantized * scale + offset
+struct VertexQuantization {
+	glm::vec3 scale{ 1.0f };
+	glm::vec3 offset{ 0.0f };
+};
+
+// pack vertices into PackedVertex relative to their AABB
+VertexQuantization packVertices(const Vertex* vertices, size_t count, std::vector<PackedVertex>& packed);
+
+// unit vector to octahedral [-1,1]^2 and back
+glm::vec2 octEncode(glm::vec3 n);
+glm::vec3 octDecode(glm::vec2 e);
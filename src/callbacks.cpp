@@ -84,6 +84,21 @@ void App::key_callback(GLFWwindow* window, int key, int scancode, int action, in
             this_inst->fullscreen_switch();
             break;
         }
+        case GLFW_KEY_O: // TOGGLE OCCLUSION CULLING
+            this_inst->occlusion_culling = !this_inst->occlusion_culling;
+            break;
+        case GLFW_KEY_G: // TOGGLE GPU CULLING OF THE MULTI-DRAW
+            this_inst->gpu_culling = !this_inst->gpu_culling;
+            break;
+        case GLFW_KEY_K: // TOGGLE MESHLET CULLING (ALL CLUSTERS ARE DRAWN WHEN OFF)
+            this_inst->meshlet_culling = !this_inst->meshlet_culling;
+            break;
+        case GLFW_KEY_T: // TOGGLE TESSELLATED TERRAIN / CDLOD PATCHES
+            this_inst->terrain_tessellation = !this_inst->terrain_tessellation && this_inst->terrain_renderer.tessellation_ready();
+            break;
+        case GLFW_KEY_I: // TOGGLE MULTI-DRAW-INDIRECT / PER-MESH DRAWS
+            this_inst->indirect_draw = !this_inst->indirect_draw;
+            break;
         default:
             break;
         }
@@ -1,13 +1,20 @@
+#include <algorithm>
+
 #include "App.h"
 
 void App::init_hm(void)
 {
+    // tiled height field of any size: only tiles around the camera are ever in memory
+    if (!streamed_terrain_file.empty()) {
+        height_streamer = std::make_shared<HeightStreamer>(streamed_terrain_file);
+        clipmap.init(shaders[10], height_streamer, textureInit("resources/textures/tex_256.png"));
+        return;  // no occluder, it would need the whole map
+    }
+
     // height map
     {
-        unsigned int STEP_SIZE = 10;
-
         std::filesystem::path hm_file("resources/textures/heights.png");
-        cv::Mat hmap = cv::imread(hm_file.string(), cv::IMREAD_GRAYSCALE);
+        cv::Mat hmap = assets.image(hm_file, cv::IMREAD_GRAYSCALE);
         cv::Mat flipedHmap;
         cv::flip(hmap, flipedHmap, 0);
 
@@ -15,158 +22,63 @@ void App::init_hm(void)
             throw std::runtime_error("ERR: Height map empty? File: " + hm_file.string());
 
         terrain = flipedHmap;
+        heightfield.build(terrain.ptr<uchar>(), terrain.cols, terrain.rows, terrain.step, terrain_settings.height_scale);
+        terrain_rays.build(heightfield);
 
-        Mesh height_map = GenHeightMap(flipedHmap, STEP_SIZE); //image, step size
-        scene.insert({"height_map", height_map });
-        //std::cout << "Note: height map vertices: " << height_map.vertices.size() << std::endl;
+        std::cout << "Note: heightmap size:" << hmap.size << ", channels: " << hmap.channels() << std::endl;
+        terrain_renderer.init(shaders[8], flipedHmap, textureInit("resources/textures/tex_256.png"), terrain_settings);
+        terrain_renderer.init_tessellation(shaders[9]);
     }
+    init_occluder();
 }
 
-glm::vec3 App::getPositionOnTerrain(glm::vec3 position) {
-    unsigned int SCALE = 2;
-    unsigned int STEP_SIZE = 10;
-
-    float position_x = position.x;
-
-    if (position_x < 0)
-        position_x = 0;
-    else if (position_x > terrain.cols- 2 * STEP_SIZE)
-        position_x = terrain.cols- 2 * STEP_SIZE;
-
-    float position_z = position.z;
-    if (position_z < 0)
-        position_z = 0;
-    else if (position_z > terrain.rows- 2 * STEP_SIZE)
-        position_z = terrain.rows- 2 * STEP_SIZE;
-
-    int coord_x = floor(position_x / STEP_SIZE) * STEP_SIZE;
-    int coord_z = floor(position_z / STEP_SIZE) * STEP_SIZE;
-
-    float h00 = terrain.at<uchar>(cv::Point(coord_x, coord_z)) / SCALE;
-    float h01 = terrain.at<uchar>(cv::Point(coord_x, coord_z+STEP_SIZE)) / SCALE;
-    float h10 = terrain.at<uchar>(cv::Point(coord_x+STEP_SIZE, coord_z)) / SCALE;
-    float h11 = terrain.at<uchar>(cv::Point(coord_x+ STEP_SIZE, coord_z+STEP_SIZE)) / SCALE;
-
-    float factorX = (position_x - coord_x)/STEP_SIZE;
-    float factorZ = (position_z - coord_z)/ STEP_SIZE;
-
-    float h_bottom = (h01 - h00) * factorZ + h00;
-    float h_top = (h11 - h10) * factorZ + h10;
-
-    float h_final = (h_top - h_bottom) * factorX + h_bottom;
-
-    return glm::vec3(position_x, h_final, position_z);
-
-}
-
-//return bottom left ST coordinate of subtexture
-glm::vec2 get_subtex_st(const int x, const int y)
-{
-    return glm::vec2(x * 1.0f / 16, y * 1.0f / 16);
-}
-
-// choose subtexture based on height
-glm::vec2 get_subtex_by_height(float height)
-{
-    if (height > 0.9)
-        return get_subtex_st(0, 4); //snow
-    else if (height > 0.8)
-        return get_subtex_st(3, 4); //ice
-    else if (height > 0.5)
-        return get_subtex_st(5, 3); //rock
-    else if (height > 0.3)
-        return get_subtex_st(7, 0); //soil
-    else
-        return get_subtex_st(0, 0); //grass
-}
-
-Mesh App::GenHeightMap(const cv::Mat& hmap, const unsigned int mesh_step_size)
+// coarse terrain for software occlusion culling, never above the real surface:
+// each vertex takes the lowest height around it, so a coarse triangle stays below the terrain it covers
+void App::init_occluder(void)
 {
-    std::vector<Vertex> vertices;
-    std::vector<GLuint> indices;
-
-
-    std::cout << "Note: heightmap size:" << hmap.size << ", channels: " << hmap.channels() << std::endl;
-
-    if (hmap.channels() != 1) {
-        std::cerr << "WARN: requested 1 channel, got: " << hmap.channels() << std::endl;
+    const int OCCLUDER_STEP = 32;  // height map pixels per occluder cell
+
+    int cells_x = (terrain.cols - 1) / OCCLUDER_STEP;
+    int cells_z = (terrain.rows - 1) / OCCLUDER_STEP;
+    if (cells_x < 1 || cells_z < 1)
+        return;
+
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+    for (int j = 0; j <= cells_z; j++) {
+        for (int i = 0; i <= cells_x; i++) {
+            int x = i * OCCLUDER_STEP, z = j * OCCLUDER_STEP;
+            cv::Rect around(std::max(0, x - OCCLUDER_STEP), std::max(0, z - OCCLUDER_STEP), 2 * OCCLUDER_STEP + 1, 2 * OCCLUDER_STEP + 1);
+            around &= cv::Rect(0, 0, terrain.cols, terrain.rows);
+            double lowest;
+            cv::minMaxLoc(terrain(around), &lowest);
+            vertices.emplace_back(x, static_cast<float>(lowest) * terrain_settings.height_scale / 255.0f, z);
+        }
     }
-
-    // Create heightmap mesh from TRIANGLES in XZ plane, Y is UP (right hand rule)
-    //
-    //   3-----2
-    //   |    /|
-    //   |  /  |
-    //   |/    |
-    //   0-----1
-    //
-    //   012,023
-    //
-
-    float heightScale = 2;
-
-    for (unsigned int x_coord = 0; x_coord < (hmap.cols - mesh_step_size); x_coord += mesh_step_size)
-    {
-        for (unsigned int z_coord = 0; z_coord < (hmap.rows - mesh_step_size); z_coord += mesh_step_size)
-        {
-            // Get The (X, Y, Z) Value For The Bottom Left Vertex = 0
-            glm::vec3 p0(x_coord, hmap.at<uchar>(cv::Point(x_coord, z_coord))/ heightScale, z_coord);
-            // Get The (X, Y, Z) Value For The Bottom Right Vertex = 1
-            glm::vec3 p1(x_coord + mesh_step_size, hmap.at<uchar>(cv::Point(x_coord + mesh_step_size, z_coord))/ heightScale, z_coord);
-            // Get The (X, Y, Z) Value For The Top Right Vertex = 2
-            glm::vec3 p2(x_coord + mesh_step_size, hmap.at<uchar>(cv::Point(x_coord + mesh_step_size, z_coord + mesh_step_size))/ heightScale, z_coord + mesh_step_size);
-            // Get The (X, Y, Z) Value For The Top Left Vertex = 3
-            glm::vec3 p3(x_coord, hmap.at<uchar>(cv::Point(x_coord, z_coord + mesh_step_size))/ heightScale, z_coord + mesh_step_size);
-
-            // Get max normalized height for tile, set texture accordingly
-            // Grayscale image returns 0..256, normalize to 0.0f..1.0f by dividing by 256
-            float max_h = std::max(hmap.at<uchar>(cv::Point(x_coord, z_coord)) / 256.0f,
-                std::max(hmap.at<uchar>(cv::Point(x_coord, z_coord + mesh_step_size)) / 256.0f,
-                    std::max(hmap.at<uchar>(cv::Point(x_coord + mesh_step_size, z_coord + mesh_step_size)) / 256.0f,
-                        hmap.at<uchar>(cv::Point(x_coord + mesh_step_size, z_coord)) / 256.0f
-                    )));
-
-            // Get texture coords in vertices, bottom left of geometry == bottom left of texture
-            glm::vec2 tc0 = get_subtex_by_height(max_h);
-            glm::vec2 tc1 = tc0 + glm::vec2(1.0f / 16, 0.0f);       //add offset for bottom right corner
-            glm::vec2 tc2 = tc0 + glm::vec2(1.0f / 16, 1.0f / 16);  //add offset for top right corner
-            glm::vec2 tc3 = tc0 + glm::vec2(0.0f, 1.0f / 16);       //add offset for bottom leftcorner
-
-            // normals for both triangles, CCW
-            glm::vec3 n1 = glm::normalize(glm::cross(p2 - p0, p1 - p0)); // for p1
-            glm::vec3 n2 = glm::normalize(glm::cross(p3 - p0, p2 - p0)); // for p3
-            //glm::vec3 n1 = glm::normalize(glm::cross(p0 - p1, p0 - p2));// for p1
-            //glm::vec3 n2 = glm::normalize(glm::cross(p0 - p2, p0 - p3)); // for p3
-            glm::vec3 navg = glm::normalize(n1 + n2);                 // average for p0, p2 - common
-
-            // place indices
-            GLuint index0 = vertices.size();
-            indices.insert(indices.end(), { index0, index0 + 2, index0 + 1, index0, index0 + 3, index0 + 2 });
-
-            //place vertices and ST to mesh
-            Vertex v = Vertex();
-            v.Position = p0;
-            v.Normal = navg;
-            v.TexCoords = tc0;
-            vertices.push_back(v);
-            v.Position = p1;
-            v.Normal = n1;
-            v.TexCoords = tc1;
-            vertices.push_back(v);
-            v.Position = p2;
-            v.Normal = navg;
-            v.TexCoords = tc2;
-            vertices.push_back(v);
-            v.Position = p3;
-            v.Normal = n2;
-            v.TexCoords = tc3;
-            vertices.push_back(v);
+    for (int j = 0; j < cells_z; j++) {
+        for (int i = 0; i < cells_x; i++) {
+            uint32_t i0 = j * (cells_x + 1) + i;
+            uint32_t i1 = i0 + 1, i2 = i0 + cells_x + 2, i3 = i0 + cells_x + 1;
+            indices.insert(indices.end(), { i0, i2, i1, i0, i3, i2 });
         }
     }
+    std::cout << "Note: occluder " << indices.size() / 3 << " triangles\n";
+    occlusion.set_occluder(std::move(vertices), std::move(indices));
+}
 
+// same surface as the terrain at its finest level (or the streamed level 0 samples)
+glm::vec3 App::getPositionOnTerrain(glm::vec3 position) {
+    if (height_streamer)
+        return glm::vec3(position.x, height_streamer->height(glm::vec2(position.x, position.z)), position.z);
+    return heightfield.snap(position);
+}
 
-    Mesh m = Mesh(GL_TRIANGLES, shaders[0], vertices, indices, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f));
-
-    m.texture_id = textureInit("resources/textures/tex_256.png");
-    return m;
-}
\ No newline at end of file
+// many positions at once: SIMD batch on the height field
+void App::placeOnTerrain(std::vector<glm::vec3>& positions) {
+    if (height_streamer) {
+        for (glm::vec3& p : positions)
+            p = getPositionOnTerrain(p);
+        return;
+    }
+    heightfield.snap(positions.data(), positions.size());
+}
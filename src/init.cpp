@@ -24,36 +24,51 @@
 #include "ShaderProgram.hpp"
 #include "Model.h"
 #include "OBJLoader.hpp"
+#include "MeshCache.hpp"
+
+// everything init_hm() and init_assets() will need, decoded/parsed in parallel
+void App::request_assets(void)
+{
+    if (streamed_terrain_file.empty())
+        assets.request_image("resources/textures/heights.png", cv::IMREAD_GRAYSCALE);
+    assets.request_image("resources/textures/tex_256.png");
+
+    // biggest first
+    assets.request_mesh("resources/Objects/dog_vn_added2_reduced.obj");
+    assets.request_mesh("resources/Objects/teapot_tri_vnt.obj");
+    assets.request_mesh("resources/Objects/zombie_dog.obj");
+    assets.request_mesh("resources/Objects/cube_tri_vnt.obj");
+
+    assets.request_image("resources/textures/box_rgb888.png");
+    assets.request_image("resources/textures/glass.png");
+    assets.request_image("resources/textures/pot_texture.jpg");
+    assets.request_image("resources/textures/dog_texture_2.png");
+    assets.request_image("resources/textures/zombie_dog_texture.png");
+}
 
 void App::init_assets(void)
 {
-    // load models, load textures, load shaders, initialize level, etc...   -most can be parallel
+    // load models, load textures, load shaders, initialize level, etc...   -CPU work runs in parallel, see request_assets()
     //shader = ShaderProgram("resources/Shaders/basic_core.vert", "resources/Shaders/basic_core.frag");
     //shaders.push_back(shader);
 
-    std::vector<Vertex> vertices;
-    std::vector<GLuint> indices;
-
+    // geometry is mapped from the mesh cache and uploaded without copies, once per asset (see meshInit, textureInit)
     // CREATE CUBES
     float CUBE_SIZE = 10.0f;
 
     glm::vec3 orientation = glm::vec3(0.0f);
     glm::vec3 size = glm::vec3(CUBE_SIZE);
     glm::vec3 origin = glm::vec3(0.0f, 0.0f, 0.0f);
-    loadOBJ("resources/Objects/cube_tri_vnt.obj", vertices, indices);
-    GLuint cubetexture = textureInit("resources/textures/box_rgb888.png");
-    int index = 0;
+    // all cubes are instances, shaders[1] is the instanced variant of shaders[0]
+    auto cube_geometry = meshInit("resources/Objects/cube_tri_vnt.obj", shaders[1]);
+    InstancedMesh wall = InstancedMesh(GL_TRIANGLES, shaders[1], cube_geometry, textureInit("resources/textures/box_rgb888.png"));
 
     int floorCount = 2;
 
+    // the path around the map first, then all of it put on the terrain at once
+    std::vector<glm::vec3> ground;
     auto createCube = [&]() {
-        for (int j = 0; j < floorCount; j++) {
-            origin = getPositionOnTerrain(origin);
-            origin.y += 5 + j*CUBE_SIZE;
-            Mesh cube = Mesh(GL_TRIANGLES, shaders[0], vertices, indices, origin, orientation, size);
-            cube.texture_id = cubetexture;
-            scene.insert({ "cube" + std::to_string(index++), cube });
-        }
+        ground.push_back(origin);
     };
 
     for (int i = 0; i < 1024 / CUBE_SIZE; i++) {
@@ -72,12 +87,16 @@ void App::init_assets(void)
         origin.z -= CUBE_SIZE;
         createCube();
     }
+    placeOnTerrain(ground);
+    for (glm::vec3 const& g : ground)
+        for (int j = 0; j < floorCount; j++)
+            wall.add({ g + glm::vec3(0.0f, 5 + j * CUBE_SIZE, 0.0f), orientation, size });
+    instanced.emplace("wall", std::move(wall));
 
     
     // FOUNTAIN OF TRANSPARENT CUBES
     orientation = glm::vec3(0.0f);
     size = glm::vec3(5.0f);
-    index = 0;
 
     glm::vec3 basePosition = glm::vec3(530.0f, 0.0f, 470.0f);
     basePosition = getPositionOnTerrain(basePosition);
@@ -115,50 +134,100 @@ void App::init_assets(void)
         glm::vec3(-1.0f,4.0f,0.0f),
     };
 
+    InstancedMesh fountain = InstancedMesh(GL_TRIANGLES, shaders[1], cube_geometry, textureInit("resources/textures/glass.png"));
+    fountain.transparent = true;
     for (glm::vec3 position : positions) {
         origin = basePosition + (position*size);
-        Mesh transparentCube = Mesh(GL_TRIANGLES, shaders[0], vertices, indices, origin, orientation, size);
-        transparentCube.texture_id = textureInit("resources/textures/glass.png");
-        transparentCube.transparent = true;
-        scene.insert({ "transparentCube" + std::to_string(index++), transparentCube });
+        fountain.add({ origin, orientation, size });
     }
+    instanced.emplace("fountain", std::move(fountain));
 
     // TEAPOT WITH SOUND
-    loadOBJ("resources/Objects/teapot_tri_vnt.obj", vertices, indices);
     orientation = glm::vec3(0.0f, 0.0f, -30.0f);
     origin = glm::vec3(530.0f, 158.0f, 470.0f);
     size = glm::vec3(1.0f);
-    Mesh teapot = Mesh(GL_TRIANGLES, shaders[0], vertices, indices, origin, orientation, size);
-    teapot.texture_id = textureInit("resources/textures/pot_texture.jpg");
-    scene.insert({ "teapot", teapot });
+    Mesh teapot = Mesh(GL_TRIANGLES, shaders[0], meshInit("resources/Objects/teapot_tri_vnt.obj", shaders[0]), origin, orientation, size, textureInit("resources/textures/pot_texture.jpg"));
+    teapot.dynamic = true;
+    scene.emplace("teapot", std::move(teapot));
 
     // DOG
-    loadOBJ("resources/Objects/dog_vn_added2_reduced.obj", vertices, indices);
     orientation = glm::vec3(0.0f, 90.0f, 0.0f);
     size = glm::vec3(4.0f);
     origin = glm::vec3(550.0f, 100.0f, 625.0f);
     origin = getPositionOnTerrain(origin);
     origin.y += 8;
-    Mesh dog = Mesh(GL_TRIANGLES, shaders[0], vertices, indices, origin, orientation, size);
-    dog.texture_id = textureInit("resources/textures/dog_texture_2.png");
-    scene.insert({ "dog", dog });
+    Mesh dog = Mesh(GL_TRIANGLES, shaders[0], meshInit("resources/Objects/dog_vn_added2_reduced.obj", shaders[0]), origin, orientation, size, textureInit("resources/textures/dog_texture_2.png"));
+    dog.dynamic = true;
+    scene.emplace("dog", std::move(dog));
 
-    loadOBJ("resources/Objects/zombie_dog.obj", vertices, indices);
     orientation = glm::vec3(0.0f);
     size = glm::vec3(0.15f);
     origin = glm::vec3(20.0f, 100.0f, 20.0f);
     origin = getPositionOnTerrain(origin);
     origin.y += 3;
-    Mesh zombie_dog = Mesh(GL_TRIANGLES, shaders[0], vertices, indices, origin, orientation, size);
-    zombie_dog.texture_id = textureInit("resources/textures/zombie_dog_texture.png");
-    scene.insert({ "zombie_dog", zombie_dog });
+    Mesh zombie_dog = Mesh(GL_TRIANGLES, shaders[0], meshInit("resources/Objects/zombie_dog.obj", shaders[0]), origin, orientation, size, textureInit("resources/textures/zombie_dog_texture.png"));
+    zombie_dog.dynamic = true;
+    scene.emplace("zombie_dog", std::move(zombie_dog));
 
 
     //loadOBJ("resources/Objects/sphere_tri_vnt.obj", vertices, indices);
     //size = glm::vec3(100.0f);
     //origin = glm::vec3(-5.0f, 0.0f, 0.0f);
     //Mesh sphere = Mesh(GL_TRIANGLES, shader, vertices, indices, origin, orientation, size);
-    //scene.insert({ "sphere", sphere });
+    //scene.emplace("sphere", std::move(sphere));
+}
+
+// opaque meshes and instanced groups, merged for IndirectRenderer (clustered ones for MeshletRenderer); transparent ones are sorted and drawn one by one
+void App::init_indirect(void)
+{
+    std::vector<Mesh*> meshes, clustered;
+    for (auto& m : scene)
+        if (!m.second.transparent)
+            (m.second.geometry && !m.second.geometry->meshlets.empty() ? clustered : meshes).push_back(&m.second);
+
+    std::vector<InstancedMesh*> groups;
+    for (auto& g : instanced)
+        if (!g.second.transparent)
+            groups.push_back(&g.second);
+
+    indirect.build(shaders[2], meshes, groups);
+    indirect.init_gpu_culling(shaders[5], shaders[6]);
+    meshlet_renderer.build(shaders[2], shaders[7], clustered);
+    hiz.init(shaders[3], shaders[4]);
+}
+
+// spatial index for picking and proximity queries; the terrain is not in the scene, it has its own height queries
+void App::init_bvh(void)
+{
+    std::vector<BoundingBox> static_bounds;
+    for (auto& m : scene) {
+        if (m.second.dynamic) {
+            dynamic_names.push_back(m.first);
+            dynamic_meshes.push_back(&m.second);
+            dynamic_bounds.push_back(m.second.world_bounds);
+        }
+        else {
+            static_names.push_back(m.first);
+            static_bounds.push_back(m.second.world_bounds);
+        }
+    }
+    for (auto& g : instanced) {
+        static_names.push_back(g.first);
+        static_bounds.push_back(g.second.world_bounds());
+    }
+
+    static_bvh.build(static_bounds);
+    dynamic_bvh.build(dynamic_bounds);
+}
+
+void App::init_uniform_blocks(void)
+{
+    glCreateBuffers(1, &frame_ubo);
+    glNamedBufferStorage(frame_ubo, sizeof(FrameData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frame_ubo);
+
+    // one block per mesh/group draw in a frame, headroom for objects added later (the ring grows past it)
+    object_ring.init(sizeof(ObjectData), 2 * (scene.size() + instanced.size()));
 }
 
 void App::init_capture() {
@@ -202,6 +271,12 @@ void App::init_glfw() {
     // https://www.glfw.org/docs/latest/quick.html#quick_create_window
     window = glfwCreateWindow(width, height, "OpenGL context", NULL, NULL);
     if (!window)
+    {
+        // 4.5 is enough, shaders are GLSL 4.50 (Mesa llvmpipe has no 4.6)
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        window = glfwCreateWindow(width, height, "OpenGL context", NULL, NULL);
+    }
+    if (!window)
     {
         glfwTerminate();
         throw std::runtime_error(std::string("Error in creating window with glfw"));
@@ -277,19 +352,41 @@ void App::init_glew() {
         throw std::runtime_error("No DSA :-(");
 }
 
-GLuint App::textureInit(const std::filesystem::path & file_name)
+std::shared_ptr<Texture> App::textureInit(const std::filesystem::path & file_name)
 {
-    cv::Mat image = cv::imread(file_name.string(), cv::IMREAD_UNCHANGED);  // Read with (potential) Alpha
-    if (image.empty()) {
-        throw std::runtime_error("No texture in file: " + file_name.string());
-    }
-
-    // or print warning, and generate synthetic image with checkerboard pattern 
-    // using OpenCV and use as a texture replacement 
-
-    GLuint texture = gen_tex(image);
+    // uploaded once, every later request gets the same texture while it is alive
+    return resources.texture(file_name.string(), [&] {
+        // decoded on a worker thread (if requested in advance), throws if there is no image
+        cv::Mat image = assets.image(file_name, cv::IMREAD_UNCHANGED);  // Read with (potential) Alpha
+
+        // or print warning, and generate synthetic image with checkerboard pattern 
+        // using OpenCV and use as a texture replacement 
+
+        auto start = std::chrono::steady_clock::now();
+        GLuint texture = gen_tex(image);
+        assets.record_upload(file_name.string(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+        // full mip chain adds one third
+        size_t bytes = image.total() * image.elemSize();
+        return std::make_shared<Texture>(texture, bytes + bytes / 3);
+    });
+}
 
-    return texture;
+std::shared_ptr<MeshGeometry> App::meshInit(const std::filesystem::path& file_name, ShaderProgram& shader)
+{
+    // uploaded once per shader and vertex format, every later request gets the same buffers
+    std::string key = ResourceRegistry::geometry_key(file_name.string(), shader.getID(), compact_vertices);
+    return resources.geometry(key, [&] {
+        MeshData const& data = assets.mesh(file_name);
+
+        auto start = std::chrono::steady_clock::now();
+        auto geometry = std::make_shared<MeshGeometry>(shader, data, compact_vertices);
+        // big meshes are drawn by clusters, so that parts facing away or off screen can be skipped
+        if (geometry->lods.front().index_count / 3 >= MESHLET_MIN_TRIANGLES)
+            geometry->build_meshlets(data.vertices(), data.indices());
+        assets.record_upload(file_name.string(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        return geometry;
+    });
 }
 
 GLuint App::gen_tex(cv::Mat& image)
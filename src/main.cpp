@@ -1,10 +1,27 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
 #include "App.h"
+#include "Benchmarks.hpp"
+#include "HeightTiles.hpp"
 
+int main(int argc, char* argv[])
+{
+    // headless: no window, camera or GL context needed
+    if (argc > 1 && std::strcmp(argv[1], "--bench") == 0)
+        return runBenchmarks(std::cout);
 
-App app;
+    // terrain tools: ICP.exe --make-terrain out.htiles [size], ICP.exe --convert-terrain dem.png out.htiles [height]
+    if (argc > 2 && std::strcmp(argv[1], "--make-terrain") == 0)
+        return generateHeightTiles(argv[2], argc > 3 ? std::atoi(argv[3]) : 16384) ? 0 : 1;
+    if (argc > 3 && std::strcmp(argv[1], "--convert-terrain") == 0)
+        return convertHeightImage(argv[2], argv[3], argc > 4 ? static_cast<float>(std::atof(argv[4])) : 127.5f) ? 0 : 1;
 
-int main()
-{
+    App app;
+    // streamed terrain instead of resources/textures/heights.png: ICP.exe --terrain map.htiles
+    if (argc > 2 && std::strcmp(argv[1], "--terrain") == 0)
+        app.use_streamed_terrain(argv[2]);
     if (app.init())
         return app.run();
-}
\ No newline at end of file
+}